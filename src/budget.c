@@ -0,0 +1,63 @@
+#include "budget.h"
+
+#include <stdlib.h>
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static unsigned long long priority(const budgetEntry * entry) {
+  // Pressure, raised while waiting so busy GPUs take turns, and for the GPUs holding a slot
+  return entry->pressure + entry->waiting / BUDGET_AGING + (entry->granted ? BUDGET_HYSTERESIS : 0);
+}
+
+static int compare_entries(const void * a, const void * b) {
+  // Get the entries
+  const budgetEntry * x = a;
+  const budgetEntry * y = b;
+
+  // GPUs wanting high performance state come first
+  if (x->wantsHigh != y->wantsHigh) {
+    return x->wantsHigh ? -1 : 1;
+  }
+
+  // Then the GPUs with a higher priority
+  unsigned long long px = priority(x);
+  unsigned long long py = priority(y);
+
+  if (px != py) {
+    return px > py ? -1 : 1;
+  }
+
+  // Then in the order given by the caller
+  return x->order < y->order ? -1 : x->order > y->order;
+}
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+unsigned long long budget_allocate(budgetEntry * entries, size_t count, unsigned long long limit) {
+  // Power drawn by all GPUs without a slot (in milliwatts)
+  unsigned long long used = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    used += entries[i].lowPower;
+  }
+
+  // Order the GPUs by priority
+  qsort(entries, count, sizeof(budgetEntry), compare_entries);
+
+  // Hand out slots while the budget allows, idle GPUs get the remaining headroom so they switch without waiting
+  for (size_t i = 0; i < count; i++) {
+    // Extra power the GPU draws with a slot
+    unsigned long long extra = entries[i].highPower > entries[i].lowPower ? entries[i].highPower - entries[i].lowPower : 0;
+
+    // Decide whether the slot fits in the budget
+    entries[i].granted = used + extra <= limit;
+
+    // Reserve the extra power
+    if (entries[i].granted) {
+      used += extra;
+    }
+  }
+
+  // Return the power drawn with the decided slots
+  return used;
+}
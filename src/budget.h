@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Pressure advantage of GPUs already holding a slot, so close priorities don't trade slots back and forth
+#define BUDGET_HYSTERESIS 10
+
+// Time a GPU waits for a slot to gain one point of pressure (in milliseconds)
+#define BUDGET_AGING 1000
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold a GPU competing for a high performance state slot
+typedef struct {
+  // Power drawn without a slot, and with one (in milliwatts)
+  unsigned long long lowPower;
+  unsigned long long highPower;
+
+  // Priority of the GPU, higher first
+  unsigned long pressure;
+
+  // Time the GPU has wanted a slot without getting one (in milliseconds)
+  unsigned long long waiting;
+
+  // Order breaking priority ties, lower first
+  unsigned long long order;
+
+  // Index of the GPU for the caller, entries are reordered
+  size_t index;
+
+  // Flag indicating whether the GPU wants high performance state
+  bool wantsHigh;
+
+  // Flag indicating whether the GPU holds a slot, updated with the decision
+  bool granted;
+} budgetEntry;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+unsigned long long budget_allocate(budgetEntry * entries, size_t count, unsigned long long limit);
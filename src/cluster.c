@@ -0,0 +1,464 @@
+#include "cluster.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+  #include <pthread.h>
+  #include <sys/eventfd.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+#endif
+
+#include "net.h"
+#include "scheduler.h"
+#include "utils.h"
+
+#ifdef __linux__
+  /***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+  // Address of the coordinator
+  static char * coordinatorAddress = NULL;
+
+  // Name of this node
+  static char nodeName[CLUSTER_NODE_MAX];
+
+  // Number of GPUs of this node
+  static unsigned int gpuCount = 0;
+
+  // Socket connected to the coordinator, -1 if not connected
+  static int coordinatorFd = -1;
+
+  // Flag indicating whether the coordinator is connected, read by the workers
+  static bool connected = false;
+
+  // Time of the next connection attempt (CLOCK_MONOTONIC, in nanoseconds)
+  static unsigned long long nextAttempt = 0;
+
+  // Thread reconnecting to the coordinator, so the control loop never waits for the name lookup or the connection
+  static pthread_t attemptThread;
+
+  // Flag indicating whether the thread is running
+  static bool attemptRunning = false;
+
+  // Flag indicating whether the thread has finished, and the socket it connected, -1 if none
+  static bool attemptDone = false;
+  static int attemptFd = -1;
+
+  // Event signalled by the thread when done, -1 if not created yet
+  static int attemptEvent = -1;
+
+  // Flag indicating whether each GPU may enter high performance state
+  static bool granted[CLUSTER_GPUS_MAX];
+
+  // Last state reported for each GPU, and when it was sent (CLOCK_MONOTONIC, in nanoseconds), zero if never
+  static clusterState reported[CLUSTER_GPUS_MAX];
+  static unsigned long long reportedAt[CLUSTER_GPUS_MAX];
+
+  // Buffer holding the incomplete line from the coordinator
+  static char buffer[CLUSTER_LINE_MAX];
+
+  // Number of bytes in the buffer
+  static size_t length = 0;
+
+  /***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+  static void disconnect(void) {
+    // Stop waking up the control loop
+    scheduler_unwatch(coordinatorFd);
+
+    // Close the connection
+    close(coordinatorFd);
+    coordinatorFd = -1;
+
+    // The GPUs are decided locally until the coordinator is back
+    ATOMIC_STORE(&connected, false);
+
+    // Retry later
+    nextAttempt = get_time_ns() + CLUSTER_RECONNECT_INTERVAL * 1000000ULL;
+
+    // Print message indicating the GPUs are decided locally
+    printf("Lost the connection to the coordinator, deciding alone\n");
+  }
+
+  static bool send_line(const char * line) {
+    // Get the length of the line
+    size_t size = strlen(line);
+
+    // Lines are small, a coordinator that doesn't read them is dropped
+    if (send(coordinatorFd, line, size, MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t) size) {
+      disconnect();
+      return false;
+    }
+
+    // Return true to indicate success
+    return true;
+  }
+
+  static void attach(int fd) {
+    // Use the connected socket
+    coordinatorFd = fd;
+
+    // GPUs keep deciding alone until the coordinator answers for them
+    for (unsigned int i = 0; i < CLUSTER_GPUS_MAX; i++) {
+      ATOMIC_STORE(&granted[i], true);
+      reportedAt[i] = 0;
+    }
+
+    // Discard what was left from the previous connection
+    length = 0;
+
+    // Wake up the control loop when the coordinator answers, otherwise the answers are read on the next poll
+    scheduler_watch(coordinatorFd);
+
+    // Introduce the node
+    char line[CLUSTER_LINE_MAX];
+    snprintf(line, sizeof(line), "HELLO %s %u\n", nodeName, gpuCount);
+
+    if (!send_line(line)) {
+      return;
+    }
+
+    // Mark the coordinator as connected
+    ATOMIC_STORE(&connected, true);
+
+    // Print message indicating the coordinator is reached
+    printf("Connected to the coordinator at %s\n", coordinatorAddress);
+  }
+
+  static void * attempt_main(void * argument) {
+    // Connect to the coordinator, the name lookup has no timeout
+    attemptFd = net_connect(coordinatorAddress, CLUSTER_CONNECT_TIMEOUT);
+
+    // Publish the socket
+    ATOMIC_STORE(&attemptDone, true);
+
+    // Wake up the control loop
+    unsigned long long value = 1;
+    write(attemptEvent, &value, sizeof(value));
+
+    // Return nothing
+    return NULL;
+  }
+
+  static bool start_attempt(void) {
+    // Create the completion event once
+    if (attemptEvent == -1) {
+      attemptEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+      if (attemptEvent == -1) {
+        fprintf(stderr, "eventfd(): %s\n", strerror(errno));
+        return false;
+      }
+    }
+
+    // Reset the result of the previous attempt
+    attemptDone = false;
+    attemptFd = -1;
+
+    // Start the attempt
+    int ret = pthread_create(&attemptThread, NULL, attempt_main, NULL);
+
+    // Check if the thread was created
+    if (ret != 0) {
+      fprintf(stderr, "pthread_create(): %s\n", strerror(ret));
+      return false;
+    }
+
+    // Mark the attempt as running
+    attemptRunning = true;
+
+    // Wake up the control loop when the attempt is done, otherwise it is collected on the next poll
+    scheduler_watch(attemptEvent);
+
+    // Return true to indicate success
+    return true;
+  }
+
+  static int reap_attempt(void) {
+    // Collect the thread
+    pthread_join(attemptThread, NULL);
+    attemptRunning = false;
+
+    // Acknowledge the event
+    unsigned long long value;
+    read(attemptEvent, &value, sizeof(value));
+    scheduler_unwatch(attemptEvent);
+
+    // Return the socket connected by the thread
+    return attemptFd;
+  }
+
+  static void try_connect(void) {
+    // If an attempt is running
+    if (attemptRunning) {
+      // Wait for it to finish
+      if (!ATOMIC_LOAD(&attemptDone)) {
+        return;
+      }
+
+      // Get the socket connected by the attempt
+      int fd = reap_attempt();
+
+      // If the coordinator is unreachable
+      if (fd == -1) {
+        // Retry later
+        nextAttempt = get_time_ns() + CLUSTER_RECONNECT_INTERVAL * 1000000ULL;
+        return;
+      }
+
+      // Introduce the node on the new connection
+      attach(fd);
+      return;
+    }
+
+    // Wait for the next attempt
+    if (get_time_ns() < nextAttempt) {
+      return;
+    }
+
+    // Connect in the background, retry later if the thread can't be started
+    if (!start_attempt()) {
+      nextAttempt = get_time_ns() + CLUSTER_RECONNECT_INTERVAL * 1000000ULL;
+    }
+  }
+
+  static void handle_line(char * line) {
+    // Split the line into words
+    char * saveptr;
+    char * command = strtok_r(line, " \t\r", &saveptr);
+    char * gpu = strtok_r(NULL, " \t\r", &saveptr);
+
+    // Variable to hold the GPU index
+    unsigned long index;
+
+    // Ignore malformed lines
+    if (command == NULL || gpu == NULL || !parse_ulong(gpu, &index) || index >= gpuCount) {
+      return;
+    }
+
+    // "GRANT <gpu>" allows high performance state, "DENY <gpu>" forbids it
+    if (strcmp(command, "GRANT") == 0) {
+      ATOMIC_STORE(&granted[index], true);
+    } else if (strcmp(command, "DENY") == 0) {
+      ATOMIC_STORE(&granted[index], false);
+    }
+  }
+
+  static bool read_lines(void) {
+    // Read everything available
+    while (true) {
+      // Read into the free part of the buffer
+      ssize_t received = recv(coordinatorFd, buffer + length, sizeof(buffer) - length, MSG_DONTWAIT);
+
+      // If the coordinator disconnected
+      if (received == 0) {
+        return false;
+      }
+
+      // If the read failed
+      if (received == -1) {
+        // No more data for now
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return true;
+        }
+
+        // Retry if interrupted by a signal
+        if (errno == EINTR) {
+          continue;
+        }
+
+        // Drop the connection on any other error
+        return false;
+      }
+
+      // Account for the received bytes
+      length += received;
+
+      // Start of the current line
+      char * start = buffer;
+
+      // Process all complete lines
+      char * end;
+
+      while ((end = memchr(start, '\n', length - (start - buffer))) != NULL) {
+        // Terminate the line
+        *end = '\0';
+
+        // Handle the line
+        handle_line(start);
+
+        // Move to the next line
+        start = end + 1;
+      }
+
+      // Move the incomplete line to the beginning of the buffer
+      length -= start - buffer;
+      memmove(buffer, start, length);
+
+      // Drop a coordinator sending overlong lines
+      if (length == sizeof(buffer)) {
+        return false;
+      }
+    }
+  }
+
+  /***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+  bool cluster_init(const char * address, const char * node, unsigned int gpus) {
+    // Name the node after the host unless given
+    char hostName[CLUSTER_NODE_MAX] = "";
+
+    if (node == NULL) {
+      gethostname(hostName, sizeof(hostName) - 1);
+      node = hostName;
+    }
+
+    // Validate the node name, it is sent as a single word
+    if (strlen(node) == 0 || strlen(node) >= sizeof(nodeName) || strpbrk(node, " \t\r\n") != NULL) {
+      fprintf(stderr, "Invalid node name: %s\n", node);
+      return false;
+    }
+
+    // Copy the address
+    coordinatorAddress = strdup(address);
+
+    if (coordinatorAddress == NULL) {
+      fprintf(stderr, "Unable to allocate memory for the coordinator address\n");
+      return false;
+    }
+
+    // Copy the node name
+    strcpy(nodeName, node);
+
+    // Store the number of GPUs
+    gpuCount = gpus < CLUSTER_GPUS_MAX ? gpus : CLUSTER_GPUS_MAX;
+
+    // Connect right away, before the control loop starts; an unreachable coordinator is retried in the background
+    int fd = net_connect(coordinatorAddress, CLUSTER_CONNECT_TIMEOUT);
+
+    if (fd != -1) {
+      attach(fd);
+    } else {
+      // Retry later
+      nextAttempt = get_time_ns() + CLUSTER_RECONNECT_INTERVAL * 1000000ULL;
+
+      // Print message indicating the GPUs are decided locally for now
+      printf("Unable to reach the coordinator at %s, deciding alone until it is reachable\n", address);
+    }
+
+    // Return true to indicate success
+    return true;
+  }
+
+  void cluster_deinit(void) {
+    // Let the running attempt finish, it holds the address
+    if (attemptRunning) {
+      int fd = reap_attempt();
+
+      if (fd != -1) {
+        close(fd);
+      }
+    }
+
+    // Release the completion event
+    if (attemptEvent != -1) {
+      close(attemptEvent);
+      attemptEvent = -1;
+    }
+
+    // Close the connection, the coordinator releases the slots of the node
+    if (coordinatorFd != -1) {
+      scheduler_unwatch(coordinatorFd);
+      close(coordinatorFd);
+      coordinatorFd = -1;
+    }
+
+    // Forget the coordinator
+    ATOMIC_STORE(&connected, false);
+    SAFE_FREE(coordinatorAddress);
+  }
+
+  bool cluster_process(void) {
+    // If the agent is not enabled
+    if (coordinatorAddress == NULL) {
+      return true;
+    }
+
+    // If not connected, try again when due
+    if (coordinatorFd == -1) {
+      try_connect();
+      return true;
+    }
+
+    // Apply the answers of the coordinator
+    if (!read_lines()) {
+      disconnect();
+    }
+
+    // Return true to indicate success
+    return true;
+  }
+
+  void cluster_report(unsigned int gpu, const clusterState * state) {
+    // If not connected
+    if (coordinatorFd == -1 || gpu >= gpuCount) {
+      return;
+    }
+
+    // Get the current time
+    unsigned long long now = get_time_ns();
+
+    // Get the previous report
+    clusterState * previous = &reported[gpu];
+
+    // Flag indicating whether the state changed since the previous report
+    bool changed = previous->pstateId != state->pstateId || previous->utilization != state->utilization || previous->temperature != state->temperature || previous->power != state->power || previous->pressure != state->pressure || previous->wantsHigh != state->wantsHigh;
+
+    // Skip unchanged states, but refresh them now and then so the coordinator knows the node is alive
+    if (reportedAt[gpu] != 0 && !changed && now - reportedAt[gpu] < CLUSTER_REFRESH_INTERVAL * 1000000ULL) {
+      return;
+    }
+
+    // "STATE <gpu> <pstate> <utilization> <temperature> <power> <pressure> <wants high>"
+    char line[CLUSTER_LINE_MAX];
+    snprintf(line, sizeof(line), "STATE %u %u %u %u %u %u %u\n", gpu, state->pstateId, state->utilization, state->temperature, state->power, state->pressure, state->wantsHigh ? 1 : 0);
+
+    // Send the state
+    if (send_line(line)) {
+      *previous = *state;
+      reportedAt[gpu] = now;
+    }
+  }
+
+  bool cluster_granted(unsigned int gpu) {
+    // Without a coordinator, the GPUs are decided locally
+    return !ATOMIC_LOAD(&connected) || gpu >= CLUSTER_GPUS_MAX || ATOMIC_LOAD(&granted[gpu]);
+  }
+#else
+  /***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+  bool cluster_init(const char * address, const char * node, unsigned int gpus) {
+    // Print an error message
+    fprintf(stderr, "Coordinator is not supported on this platform\n");
+
+    // Return false to indicate failure
+    return false;
+  }
+
+  void cluster_deinit(void) {
+  }
+
+  bool cluster_process(void) {
+    return true;
+  }
+
+  void cluster_report(unsigned int gpu, const clusterState * state) {
+  }
+
+  bool cluster_granted(unsigned int gpu) {
+    return true;
+  }
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs of an agent (matches NVAPI_MAX_PHYSICAL_GPUS)
+#define CLUSTER_GPUS_MAX 64
+
+// Maximum length of a protocol line
+#define CLUSTER_LINE_MAX 256
+
+// Maximum length of a node name
+#define CLUSTER_NODE_MAX 64
+
+// Time allowed to connect to the coordinator (in milliseconds)
+#define CLUSTER_CONNECT_TIMEOUT 200
+
+// Delay between attempts to reach the coordinator (in milliseconds)
+#define CLUSTER_RECONNECT_INTERVAL 5000
+
+// Longest time between two reports of an unchanged GPU (in milliseconds)
+#define CLUSTER_REFRESH_INTERVAL 1000
+
+// Time after which the coordinator drops a silent agent (in milliseconds)
+#define CLUSTER_AGENT_TIMEOUT 5000
+
+// Pressure added while an application holds the GPU through the hint socket
+#define CLUSTER_LEASE_PRESSURE 100
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// State of a GPU reported to the coordinator
+typedef struct {
+  // Current performance state
+  unsigned int pstateId;
+
+  // Utilization (in percentage)
+  unsigned int utilization;
+
+  // Temperature (in degrees C)
+  unsigned int temperature;
+
+  // Power draw (in milliwatts)
+  unsigned int power;
+
+  // Priority of the GPU for a high performance state slot, higher first
+  unsigned int pressure;
+
+  // Flag indicating whether the GPU wants high performance state
+  bool wantsHigh;
+} clusterState;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool cluster_init(const char * address, const char * node, unsigned int gpus);
+void cluster_deinit(void);
+bool cluster_process(void);
+void cluster_report(unsigned int gpu, const clusterState * state);
+bool cluster_granted(unsigned int gpu);
@@ -0,0 +1,206 @@
+#include "config.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static char * trim(char * text) {
+  // Skip the leading whitespace
+  while (isspace((unsigned char) *text)) {
+    text++;
+  }
+
+  // Cut the trailing whitespace
+  size_t length = strlen(text);
+
+  while (length > 0 && isspace((unsigned char) text[length - 1])) {
+    text[--length] = '\0';
+  }
+
+  // Return the trimmed text
+  return text;
+}
+
+static bool add_entry(configFile * file, unsigned int gpu, unsigned int line, const char * key, const char * value) {
+  // Grow the entries by one
+  configEntry * entries = realloc(file->entries, (file->count + 1) * sizeof(configEntry));
+
+  // Check if the entries were grown
+  if (entries == NULL) {
+    return false;
+  }
+
+  file->entries = entries;
+
+  // Fill the entry
+  configEntry * entry = &file->entries[file->count];
+  entry->gpu = gpu;
+  entry->line = line;
+  entry->key = strdup(key);
+  entry->value = value != NULL ? strdup(value) : NULL;
+
+  // Account for the entry, so it is freed even if a copy failed
+  file->count++;
+
+  // Check if the copies were made
+  return entry->key != NULL && (value == NULL || entry->value != NULL);
+}
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+configFile * config_read(const char * path) {
+  // Open the file
+  FILE * stream = fopen(path, "r");
+
+  // Check if the file was opened
+  if (stream == NULL) {
+    fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+    return NULL;
+  }
+
+  // Allocate the parsed file
+  configFile * file = calloc(1, sizeof(configFile));
+
+  // Check if the parsed file was allocated
+  if (file == NULL || (file->path = strdup(path)) == NULL) {
+    fprintf(stderr, "Unable to allocate memory for %s\n", path);
+    goto failure;
+  }
+
+  // Settings before any section are global
+  unsigned int gpu = CONFIG_GLOBAL;
+
+  // Buffer holding the current line
+  char buffer[CONFIG_LINE_MAX];
+
+  // Number of the current line
+  unsigned int line = 0;
+
+  // Read the file line by line
+  while (fgets(buffer, sizeof(buffer), stream) != NULL) {
+    // Count the line
+    line++;
+
+    // Reject lines that don't fit into the buffer
+    if (strchr(buffer, '\n') == NULL && !feof(stream)) {
+      fprintf(stderr, "%s:%u: line is too long\n", path, line);
+      goto failure;
+    }
+
+    // Trim the line
+    char * text = trim(buffer);
+
+    // Skip empty lines and comments
+    if (*text == '\0' || *text == '#' || *text == ';') {
+      continue;
+    }
+
+    // If the line starts a section
+    if (*text == '[') {
+      // Find the end of the section name
+      char * end = strchr(text, ']');
+
+      if (end == NULL || *trim(end + 1) != '\0') {
+        fprintf(stderr, "%s:%u: malformed section\n", path, line);
+        goto failure;
+      }
+
+      // Get the section name
+      *end = '\0';
+      char * name = trim(text + 1);
+
+      // The section is either global or for a GPU
+      unsigned long id;
+
+      if (strcmp(name, "global") == 0) {
+        gpu = CONFIG_GLOBAL;
+      } else if (strncmp(name, "gpu", 3) == 0 && isspace((unsigned char) name[3]) && parse_ulong(trim(name + 3), &id) && id < CONFIG_GLOBAL) {
+        gpu = (unsigned int) id;
+      } else {
+        fprintf(stderr, "%s:%u: unknown section [%s], expected [global] or [gpu <id>]\n", path, line, name);
+        goto failure;
+      }
+
+      continue;
+    }
+
+    // The setting is either "key = value" or a flag
+    char * key = text;
+    char * value = NULL;
+    char * separator = strchr(text, '=');
+
+    // If the setting has a value
+    if (separator != NULL) {
+      // Split the key and the value
+      *separator = '\0';
+      key = trim(key);
+      value = trim(separator + 1);
+
+      // Strip the quotes around the value
+      size_t length = strlen(value);
+
+      if (length >= 2 && value[0] == '"' && value[length - 1] == '"') {
+        value[length - 1] = '\0';
+        value++;
+      }
+    }
+
+    // The key can't be empty
+    if (*key == '\0') {
+      fprintf(stderr, "%s:%u: missing option name\n", path, line);
+      goto failure;
+    }
+
+    // Store the setting
+    if (!add_entry(file, gpu, line, key, value)) {
+      fprintf(stderr, "Unable to allocate memory for %s\n", path);
+      goto failure;
+    }
+  }
+
+  // Check if the file was read completely
+  if (ferror(stream)) {
+    fprintf(stderr, "Unable to read %s: %s\n", path, strerror(errno));
+    goto failure;
+  }
+
+  // Close the file
+  fclose(stream);
+
+  // Return the parsed file
+  return file;
+
+  failure:
+  // Close the file
+  fclose(stream);
+
+  // Free the partially parsed file
+  config_free(file);
+
+  // Return NULL to indicate failure
+  return NULL;
+}
+
+void config_free(configFile * file) {
+  // If there is nothing to free
+  if (file == NULL) {
+    return;
+  }
+
+  // Free the entries
+  for (size_t i = 0; i < file->count; i++) {
+    free(file->entries[i].key);
+    free(file->entries[i].value);
+  }
+
+  // Free the arrays
+  free(file->entries);
+  free(file->path);
+  free(file);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// GPU index of the settings in the global section
+#define CONFIG_GLOBAL UINT_MAX
+
+// Maximum length of a line of the configuration file
+#define CONFIG_LINE_MAX 4096
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold a setting of the configuration file
+typedef struct {
+  // GPU the setting applies to, CONFIG_GLOBAL for the global section
+  unsigned int gpu;
+
+  // Line of the setting, for error messages
+  unsigned int line;
+
+  // Name of the setting, the long option name without the leading dashes
+  char * key;
+
+  // Value of the setting, NULL for flags
+  char * value;
+} configEntry;
+
+// Structure to hold a parsed configuration file
+typedef struct {
+  // Path of the file
+  char * path;
+
+  // Settings in file order
+  configEntry * entries;
+
+  // Number of settings
+  size_t count;
+} configFile;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+configFile * config_read(const char * path);
+void config_free(configFile * file);
@@ -0,0 +1,54 @@
+#include "control.h"
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+bool control_step(const controlConfig * config, policyState * state, const controlSource * source, const unsigned int * pstateId, controlStep * step) {
+  // Get the time of the step
+  step->time = source->now(source->context);
+  step->utilization = 0;
+
+  // Read the temperature of the GPU
+  if (!source->temperature(source->context, &step->temperature)) {
+    return false;
+  }
+
+  // Check if the GPU temperature exceeds the defined threshold
+  if (step->temperature > config->temperatureThreshold) {
+    // Step down, straight to low performance state unless the policy is a ladder
+    step->pstateId = policy_overheated(&config->policyConfiguration, state, step->time, *pstateId);
+    step->outcome = CONTROL_OVERHEATED;
+
+    // Return true to indicate success
+    return true;
+  }
+
+  // Step down right away on the next overheat
+  policy_cooled(state);
+
+  // Flag indicating whether the source has a utilization this time
+  bool available = true;
+
+  // Read the utilization of the GPU
+  if (!source->utilization(source->context, &step->utilization, &available)) {
+    return false;
+  }
+
+  // Without a utilization, the policy is not asked; the source may have switched the GPU itself, so the state is read again
+  if (!available) {
+    step->pstateId = *pstateId;
+    step->outcome = CONTROL_SKIPPED;
+
+    // Return true to indicate success
+    return true;
+  }
+
+  // Pass the sample to the policy
+  policySample sample = { step->time, step->utilization };
+
+  // Ask the policy for the desired performance state
+  step->pstateId = config->pstatePolicy->decide(&config->policyConfiguration, state, &sample, *pstateId);
+  step->outcome = CONTROL_DECIDED;
+
+  // Return true to indicate success
+  return true;
+}
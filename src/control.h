@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "policy.h"
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the settings of the control step, which can differ between GPUs
+typedef struct {
+  // Performance state policy
+  const policy * pstatePolicy;
+
+  // Configuration passed to the performance state policy
+  policyConfig policyConfiguration;
+
+  // Temperature threshold (in degrees C)
+  unsigned long temperatureThreshold;
+} controlConfig;
+
+// Structure describing where the control step takes the time and the telemetry of a GPU from
+typedef struct {
+  // Context passed to the callbacks
+  void * context;
+
+  // Get the current time (in nanoseconds)
+  unsigned long long (* now)(void * context);
+
+  // Read the temperature of the GPU (in degrees C)
+  bool (* temperature)(void * context, unsigned int * value);
+
+  // Read the utilization of the GPU (in percentage), only once it is below the temperature threshold; clears available if there is none this time
+  bool (* utilization)(void * context, unsigned int * value, bool * available);
+} controlSource;
+
+// Outcome of a control step
+typedef enum {
+  // The policy decided the performance state
+  CONTROL_DECIDED,
+
+  // The GPU is above the temperature threshold and steps down
+  CONTROL_OVERHEATED,
+
+  // The source had no utilization, the performance state is left as is
+  CONTROL_SKIPPED,
+} controlOutcome;
+
+// Structure to hold the result of a control step
+typedef struct {
+  // Outcome of the step
+  controlOutcome outcome;
+
+  // Time of the step (in nanoseconds)
+  unsigned long long time;
+
+  // Temperature (in degrees C) and utilization (in percentage) the step was based on, the utilization is zero unless decided
+  unsigned int temperature;
+  unsigned int utilization;
+
+  // Desired performance state
+  unsigned int pstateId;
+} controlStep;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool control_step(const controlConfig * config, policyState * state, const controlSource * source, const unsigned int * pstateId, controlStep * step);
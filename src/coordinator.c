@@ -0,0 +1,747 @@
+// Required for accept4()
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "budget.h"
+#include "cluster.h"
+#include "net.h"
+#include "utils.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Power assumed for a GPU in high performance state until it is observed (in watts)
+#define HIGH_POWER 300
+
+// Time between two allocations of the budget (in milliseconds)
+#define INTERVAL 100
+
+// Maximum number of connected agents
+#define AGENTS_MAX 4096
+
+// Maximum number of events handled per wait
+#define EVENTS_MAX 256
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold what the coordinator knows about a GPU
+typedef struct {
+  // Latest reported state
+  clusterState state;
+
+  // Flag indicating whether the GPU reported its state
+  bool seen;
+
+  // Flag indicating whether the GPU holds a high performance state slot
+  bool granted;
+
+  // Flag indicating whether the agent was told the current decision
+  bool sent;
+
+  // Power drawn without a slot, and the peak drawn with one (in milliwatts)
+  unsigned long long lowPower;
+  unsigned long long highPower;
+
+  // Time since which the GPU wants a slot without holding one (CLOCK_MONOTONIC, in nanoseconds), zero if not waiting
+  unsigned long long waitingSince;
+} coordinatorGpu;
+
+// Structure to hold the state of a connected agent
+typedef struct coordinatorAgent {
+  // Socket of the agent
+  int fd;
+
+  // Order of connection, to break priority ties the same way every time
+  unsigned long long id;
+
+  // Name of the node, empty until introduced
+  char node[CLUSTER_NODE_MAX];
+
+  // Number of GPUs of the node
+  unsigned int gpuCount;
+
+  // GPUs of the node
+  coordinatorGpu gpus[CLUSTER_GPUS_MAX];
+
+  // Buffer holding the incomplete line
+  char buffer[CLUSTER_LINE_MAX];
+
+  // Number of bytes in the buffer
+  size_t length;
+
+  // Time of the last received line (CLOCK_MONOTONIC, in nanoseconds)
+  unsigned long long lastSeen;
+
+  // Flag indicating whether the agent is dropped after the current events
+  bool dropped;
+
+  // Previous and next agents in the list
+  struct coordinatorAgent * prev;
+  struct coordinatorAgent * next;
+} coordinatorAgent;
+
+// Structure to hold a GPU competing for a slot
+typedef struct {
+  // Agent of the GPU
+  coordinatorAgent * agent;
+
+  // Index of the GPU on the agent
+  unsigned int index;
+} coordinatorCandidate;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Options
+static unsigned long agentTimeout = CLUSTER_AGENT_TIMEOUT;
+static unsigned long budget = 0;
+static unsigned long highPower = HIGH_POWER;
+static unsigned long interval = INTERVAL;
+static const char * listenAddress = NULL;
+
+// Flag indicating whether the program should continue running
+static volatile sig_atomic_t shouldRun = true;
+
+// Listening socket
+static int listenFd = -1;
+
+// Epoll instance watching the listening socket and the agents
+static int epollFd = -1;
+
+// List of connected agents
+static coordinatorAgent * agents = NULL;
+
+// Number of connected agents
+static unsigned int agentCount = 0;
+
+// Number of agents connected so far
+static unsigned long long agentIds = 0;
+
+// GPUs competing for slots and their budget entries, sized for all connected agents
+static coordinatorCandidate * candidates = NULL;
+static budgetEntry * entries = NULL;
+static size_t candidateCapacity = 0;
+
+// Result of the previous allocation, to only print changes
+static unsigned int previousGranted = 0;
+static unsigned int previousWanting = 0;
+static unsigned int previousGpus = 0;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static void handle_exit(int signal) {
+  // Set the global flag to false to indicate the program should stop running
+  shouldRun = false;
+}
+
+static void close_agent(coordinatorAgent * agent) {
+  // Unlink the agent from the list
+  if (agent->prev != NULL) {
+    agent->prev->next = agent->next;
+  } else {
+    agents = agent->next;
+  }
+
+  if (agent->next != NULL) {
+    agent->next->prev = agent->prev;
+  }
+
+  // Print message indicating the slots of the node are released
+  if (agent->node[0] != '\0') {
+    printf("Node %s disconnected\n", agent->node);
+  }
+
+  // Close the socket, which also removes it from the epoll instance
+  close(agent->fd);
+
+  // Free the agent
+  free(agent);
+
+  // Decrement the number of agents
+  agentCount--;
+}
+
+static void accept_agents(void) {
+  // Accept all pending connections
+  while (true) {
+    // Accept the connection
+    int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    // Stop if there are no more pending connections
+    if (fd == -1) {
+      return;
+    }
+
+    // Refuse the connection if there are too many agents
+    if (agentCount >= AGENTS_MAX) {
+      close(fd);
+      continue;
+    }
+
+    // Allocate the agent
+    coordinatorAgent * agent = calloc(1, sizeof(coordinatorAgent));
+
+    if (agent == NULL) {
+      close(fd);
+      continue;
+    }
+
+    // Store the socket
+    agent->fd = fd;
+    agent->id = agentIds++;
+    agent->lastSeen = get_time_ns();
+
+    // Watch the agent for incoming data
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = agent };
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+      close(fd);
+      free(agent);
+      continue;
+    }
+
+    // Link the agent into the list
+    agent->next = agents;
+
+    if (agents != NULL) {
+      agents->prev = agent;
+    }
+
+    agents = agent;
+
+    // Increment the number of agents
+    agentCount++;
+  }
+}
+
+static bool handle_line(coordinatorAgent * agent, char * line) {
+  // Split the line into words
+  char * saveptr;
+  char * command = strtok_r(line, " \t\r", &saveptr);
+
+  // Ignore empty lines
+  if (command == NULL) {
+    return true;
+  }
+
+  // "HELLO <node> <gpus>" introduces the node
+  if (strcmp(command, "HELLO") == 0) {
+    char * node = strtok_r(NULL, " \t\r", &saveptr);
+    char * gpus = strtok_r(NULL, " \t\r", &saveptr);
+
+    // Variable to hold the number of GPUs
+    unsigned long count;
+
+    // Validate the arguments, a node introduces itself once
+    if (agent->node[0] != '\0' || node == NULL || gpus == NULL || strlen(node) >= sizeof(agent->node) || !parse_ulong(gpus, &count) || count > CLUSTER_GPUS_MAX) {
+      return false;
+    }
+
+    // Store the node
+    strcpy(agent->node, node);
+    agent->gpuCount = count;
+
+    // Print message indicating the node joined
+    printf("Node %s connected with %u GPUs\n", agent->node, agent->gpuCount);
+
+    // Return true to indicate success
+    return true;
+  }
+
+  // "STATE <gpu> <pstate> <utilization> <temperature> <power> <pressure> <wants high>" updates a GPU
+  if (strcmp(command, "STATE") == 0 && agent->node[0] != '\0') {
+    // Parsed fields
+    unsigned long fields[7];
+
+    // Parse the fields
+    for (unsigned int i = 0; i < 7; i++) {
+      char * word = strtok_r(NULL, " \t\r", &saveptr);
+
+      if (word == NULL || !parse_ulong(word, &fields[i])) {
+        return false;
+      }
+    }
+
+    // Validate the GPU
+    if (fields[0] >= agent->gpuCount) {
+      return false;
+    }
+
+    // Get the GPU
+    coordinatorGpu * gpu = &agent->gpus[fields[0]];
+
+    // Store the state
+    gpu->state.pstateId = fields[1];
+    gpu->state.utilization = fields[2];
+    gpu->state.temperature = fields[3];
+    gpu->state.power = fields[4];
+    gpu->state.pressure = fields[5];
+    gpu->state.wantsHigh = fields[6] != 0;
+
+    // A new GPU is assumed to draw the configured power once granted a slot
+    if (!gpu->seen) {
+      gpu->seen = true;
+      gpu->highPower = (unsigned long long) highPower * 1000ULL;
+    }
+
+    // Learn the peak draw with a slot, an idle GPU holding one stays in low performance state
+    if (gpu->granted && gpu->state.wantsHigh && gpu->state.power > gpu->highPower) {
+      gpu->highPower = gpu->state.power;
+    }
+
+    // The current draw bounds the draw without a slot, which is only known once the GPU gives it up
+    gpu->lowPower = gpu->state.power;
+
+    // Return true to indicate success
+    return true;
+  }
+
+  // Drop agents speaking another protocol
+  return false;
+}
+
+static bool read_agent(coordinatorAgent * agent) {
+  // Read everything available
+  while (true) {
+    // Read into the free part of the buffer
+    ssize_t received = recv(agent->fd, agent->buffer + agent->length, sizeof(agent->buffer) - agent->length, MSG_DONTWAIT);
+
+    // If the agent disconnected
+    if (received == 0) {
+      return false;
+    }
+
+    // If the read failed
+    if (received == -1) {
+      // No more data for now
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true;
+      }
+
+      // Retry if interrupted by a signal
+      if (errno == EINTR) {
+        continue;
+      }
+
+      // Drop the agent on any other error
+      return false;
+    }
+
+    // Account for the received bytes
+    agent->length += received;
+    agent->lastSeen = get_time_ns();
+
+    // Start of the current line
+    char * start = agent->buffer;
+
+    // Process all complete lines
+    char * end;
+
+    while ((end = memchr(start, '\n', agent->length - (start - agent->buffer))) != NULL) {
+      // Terminate the line
+      *end = '\0';
+
+      // Handle the line
+      if (!handle_line(agent, start)) {
+        return false;
+      }
+
+      // Move to the next line
+      start = end + 1;
+    }
+
+    // Move the incomplete line to the beginning of the buffer
+    agent->length -= start - agent->buffer;
+    memmove(agent->buffer, start, agent->length);
+
+    // Drop agents sending overlong lines
+    if (agent->length == sizeof(agent->buffer)) {
+      return false;
+    }
+  }
+}
+
+static bool send_decisions(coordinatorAgent * agent) {
+  // Buffer holding the decisions, each line is at most "GRANT 63\n"
+  char lines[CLUSTER_GPUS_MAX * 16];
+
+  // Number of bytes in the buffer
+  size_t size = 0;
+
+  // Add the changed decisions
+  for (unsigned int i = 0; i < agent->gpuCount; i++) {
+    // Get the GPU
+    coordinatorGpu * gpu = &agent->gpus[i];
+
+    // Skip GPUs that didn't report yet or were told already
+    if (!gpu->seen || gpu->sent) {
+      continue;
+    }
+
+    // Add the decision
+    size += snprintf(lines + size, sizeof(lines) - size, "%s %u\n", gpu->granted ? "GRANT" : "DENY", i);
+    gpu->sent = true;
+  }
+
+  // Send the decisions at once, an agent that doesn't read them is dropped
+  return size == 0 || send(agent->fd, lines, size, MSG_NOSIGNAL | MSG_DONTWAIT) == (ssize_t) size;
+}
+
+static bool allocate(unsigned long long now) {
+  // Make room for every GPU of every agent
+  size_t needed = (size_t) agentCount * CLUSTER_GPUS_MAX;
+
+  if (needed > candidateCapacity) {
+    // Grow the arrays
+    coordinatorCandidate * grownCandidates = realloc(candidates, needed * sizeof(coordinatorCandidate));
+
+    if (grownCandidates != NULL) {
+      candidates = grownCandidates;
+    }
+
+    budgetEntry * grownEntries = realloc(entries, needed * sizeof(budgetEntry));
+
+    if (grownEntries != NULL) {
+      entries = grownEntries;
+    }
+
+    // Check if both arrays were grown
+    if (grownCandidates == NULL || grownEntries == NULL) {
+      fprintf(stderr, "Unable to allocate memory for %zu GPUs\n", needed);
+      return false;
+    }
+
+    candidateCapacity = needed;
+  }
+
+  // Number of GPUs
+  size_t count = 0;
+
+  // Statistics of the allocation
+  unsigned int granted = 0;
+  unsigned int wanting = 0;
+
+  // Collect the GPUs that reported their state
+  for (coordinatorAgent * agent = agents; agent != NULL; agent = agent->next) {
+    for (unsigned int i = 0; i < agent->gpuCount; i++) {
+      // Get the GPU
+      coordinatorGpu * gpu = &agent->gpus[i];
+
+      // Skip GPUs that didn't report yet
+      if (!gpu->seen) {
+        continue;
+      }
+
+      // Describe the GPU, the oldest agents and the lowest indices break ties
+      entries[count] = (budgetEntry) {
+        .lowPower = gpu->lowPower,
+        .highPower = gpu->highPower,
+        .pressure = gpu->state.pressure,
+        .waiting = gpu->waitingSince != 0 ? (now - gpu->waitingSince) / 1000000ULL : 0,
+        .order = agent->id * CLUSTER_GPUS_MAX + i,
+        .index = count,
+        .wantsHigh = gpu->state.wantsHigh,
+        .granted = gpu->granted,
+      };
+
+      candidates[count++] = (coordinatorCandidate) { agent, i };
+
+      // Count the GPUs wanting a slot
+      if (gpu->state.wantsHigh) {
+        wanting++;
+      }
+    }
+  }
+
+  // Share the budget (in milliwatts)
+  unsigned long long used = budget_allocate(entries, count, (unsigned long long) budget * 1000ULL);
+
+  // Apply the decisions
+  for (size_t i = 0; i < count; i++) {
+    // Get the GPU
+    coordinatorGpu * gpu = &candidates[entries[i].index].agent->gpus[candidates[entries[i].index].index];
+
+    // Get the decision
+    bool grant = entries[i].granted;
+
+    // Count the slots
+    if (grant) {
+      granted++;
+    }
+
+    // Track how long the GPU waits for a slot
+    if (!gpu->state.wantsHigh || grant) {
+      gpu->waitingSince = 0;
+    } else if (gpu->waitingSince == 0) {
+      gpu->waitingSince = now;
+    }
+
+    // Tell the agent about a changed decision
+    if (grant != gpu->granted) {
+      gpu->granted = grant;
+      gpu->sent = false;
+    }
+  }
+
+  // Send the decisions
+  for (coordinatorAgent * agent = agents; agent != NULL; agent = agent->next) {
+    if (!send_decisions(agent)) {
+      agent->dropped = true;
+    }
+  }
+
+  // Print the allocation when it changes
+  if (granted != previousGranted || wanting != previousWanting || count != previousGpus) {
+    printf("Granted %u slots to %zu GPUs on %u nodes, %u wanting high performance state, %.1f W of %lu W estimated\n", granted, count, agentCount, wanting, used / 1000.0, budget);
+
+    previousGranted = granted;
+    previousWanting = wanting;
+    previousGpus = count;
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+static void drop_agents(unsigned long long now) {
+  // Loop through the agents
+  coordinatorAgent * agent = agents;
+
+  while (agent != NULL) {
+    // Get the next agent first, the current one may be freed
+    coordinatorAgent * next = agent->next;
+
+    // Drop failed agents and the ones that went silent
+    if (agent->dropped || now - agent->lastSeen > agentTimeout * 1000000ULL) {
+      close_agent(agent);
+    }
+
+    // Move to the next agent
+    agent = next;
+  }
+}
+
+/***** ***** ***** ***** ***** MAIN ***** ***** ***** ***** *****/
+
+int main(int argc, char * argv[]) {
+  // Return code
+  int code = 1;
+
+  /***** OPTION PARSING *****/
+  {
+    // Iterate through command-line arguments
+    for (unsigned int i = 1; i < argc; i++) {
+      // Check if the option is "-h" or "--help"
+      if ((IS_OPTION("-h") || IS_OPTION("--help"))) {
+        // Print usage instructions
+        goto usage;
+      }
+
+      // Check if the option is "-at" or "--agent-timeout" and if there is a next argument
+      if ((IS_OPTION("-at") || IS_OPTION("--agent-timeout")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in agentTimeout
+        ASSERT_TRUE(parse_ulong(argv[++i], &agentTimeout), usage);
+        continue;
+      }
+
+      // Check if the option is "-b" or "--budget" and if there is a next argument
+      if ((IS_OPTION("-b") || IS_OPTION("--budget")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in budget
+        ASSERT_TRUE(parse_ulong(argv[++i], &budget), usage);
+        continue;
+      }
+
+      // Check if the option is "-hp" or "--high-power" and if there is a next argument
+      if ((IS_OPTION("-hp") || IS_OPTION("--high-power")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in highPower
+        ASSERT_TRUE(parse_ulong(argv[++i], &highPower), usage);
+        continue;
+      }
+
+      // Check if the option is "-i" or "--interval" and if there is a next argument
+      if ((IS_OPTION("-i") || IS_OPTION("--interval")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in interval
+        ASSERT_TRUE(parse_ulong(argv[++i], &interval), usage);
+        continue;
+      }
+
+      // Check if the option is "-l" or "--listen" and if there is a next argument
+      if ((IS_OPTION("-l") || IS_OPTION("--listen")) && HAS_NEXT_ARG) {
+        // Store the address in listenAddress
+        listenAddress = argv[++i];
+        continue;
+      }
+
+      // Reject unknown options
+      goto usage;
+    }
+
+    // The address and the budget are required
+    if (listenAddress == NULL || budget == 0 || interval == 0) {
+      goto usage;
+    }
+
+    // Display usage instructions to the user
+    if (false) {
+      // Display usage instructions to the user
+      usage:
+
+      // Print the usage instructions
+      printf("Usage: %s [options]\n", argv[0]);
+      printf("\n");
+      printf("Shares a power budget between nvidia-pstated daemons started with --coordinator.\n");
+      printf("\n");
+      printf("Options:\n");
+      printf("  -at, --agent-timeout <value>              Set the time in milliseconds after which a silent node is dropped (default: %u)\n", CLUSTER_AGENT_TIMEOUT);
+      printf("  -b, --budget <value>                      Set the power budget in watts of all nodes (required)\n");
+      printf("  -hp, --high-power <value>                 Set the power in watts assumed for a GPU in high performance state until it is observed (default: %u)\n", HIGH_POWER);
+      printf("  -i, --interval <value>                    Set the time in milliseconds between two allocations of the budget (default: %u)\n", INTERVAL);
+      printf("  -l, --listen <value>                      Listen for nodes on this address: [host:]port or unix:<path> (required)\n");
+
+      // Return an error
+      return 1;
+    }
+  }
+
+  /***** INIT *****/
+  {
+    // Register signal handlers for graceful exit
+    signal(SIGINT, handle_exit);
+    signal(SIGTERM, handle_exit);
+
+    // Start listening for nodes
+    listenFd = net_listen(listenAddress);
+
+    if (listenFd == -1) {
+      goto cleanup;
+    }
+
+    // Create the epoll instance
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (epollFd == -1) {
+      fprintf(stderr, "epoll_create1(): %s\n", strerror(errno));
+      goto cleanup;
+    }
+
+    // Watch the listening socket for connections
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == -1) {
+      fprintf(stderr, "epoll_ctl(): %s\n", strerror(errno));
+      goto cleanup;
+    }
+
+    // Print message indicating the coordinator is ready
+    printf("Listening on %s with a budget of %lu W\n", listenAddress, budget);
+  }
+
+  /***** MAIN LOOP *****/
+  {
+    // Time of the next allocation (CLOCK_MONOTONIC, in nanoseconds)
+    unsigned long long deadline = get_time_ns();
+
+    // Buffer to hold the ready events
+    struct epoll_event events[EVENTS_MAX];
+
+    // Handle the agents until asked to stop
+    while (shouldRun) {
+      // Time left until the next allocation
+      unsigned long long now = get_time_ns();
+      int timeout = now < deadline ? (int) ((deadline - now + 999999ULL) / 1000000ULL) : 0;
+
+      // Wait for events
+      int count = epoll_wait(epollFd, events, EVENTS_MAX, timeout);
+
+      // Check if the wait failed
+      if (count == -1) {
+        // Retry if interrupted by a signal
+        if (errno == EINTR) {
+          continue;
+        }
+
+        fprintf(stderr, "epoll_wait(): %s\n", strerror(errno));
+        goto cleanup;
+      }
+
+      // Loop through the events
+      for (int i = 0; i < count; i++) {
+        // Get the agent, NULL for the listening socket
+        coordinatorAgent * agent = events[i].data.ptr;
+
+        // Accept new connections
+        if (agent == NULL) {
+          accept_agents();
+          continue;
+        }
+
+        // Read the states, drop the agent on disconnect or error
+        if (!read_agent(agent)) {
+          agent->dropped = true;
+        }
+      }
+
+      // Get the current time
+      now = get_time_ns();
+
+      // If the next allocation is not due yet
+      if (now < deadline) {
+        continue;
+      }
+
+      // Release the slots of the agents that are gone
+      drop_agents(now);
+
+      // Share the budget
+      if (!allocate(now)) {
+        goto cleanup;
+      }
+
+      // Drop the agents that couldn't be told
+      drop_agents(now);
+
+      // Schedule the next allocation
+      deadline = now + interval * 1000000ULL;
+    }
+
+    // Exit normally
+    code = 0;
+  }
+
+  /***** CLEANUP *****/
+  cleanup:
+  {
+    // Disconnect all agents, they decide alone from now on
+    while (agents != NULL) {
+      close_agent(agents);
+    }
+
+    // Free the candidates
+    SAFE_FREE(candidates);
+    SAFE_FREE(entries);
+
+    // Close the epoll instance
+    if (epollFd != -1) {
+      close(epollFd);
+    }
+
+    // Close the listening socket and remove its file
+    if (listenFd != -1) {
+      close(listenFd);
+
+      if (net_unix_path(listenAddress) != NULL) {
+        unlink(net_unix_path(listenAddress));
+      }
+    }
+  }
+
+  // Return the exit code
+  return code;
+}
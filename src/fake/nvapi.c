@@ -0,0 +1,203 @@
+// Required for RTLD_DEFAULT
+#define _GNU_SOURCE
+
+#include <nvapi.h>
+#include <dlfcn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "trace.h"
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Flag indicating whether the library is initialized
+static bool initialized = false;
+
+// Number of performance state transitions of each fake GPU
+static unsigned long transitions[FAKE_MAX_GPUS];
+
+// Last forced performance state of each fake GPU
+static NvU32 pstates[FAKE_MAX_GPUS];
+
+/***** ***** ***** ***** ***** MACROS ***** ***** ***** ***** *****/
+
+// Fake handles encode the GPU index, offset by one to never be NULL
+#define HANDLE_TO_INDEX(handle) ((unsigned int) ((uintptr_t) (handle) - 1))
+#define INDEX_TO_HANDLE(index) ((NvPhysicalGpuHandle) (uintptr_t) ((index) + 1))
+
+#define NVAPI_HANDLE(handle) do {                            \
+  if (!initialized) {                                        \
+    return NVAPI_API_NOT_INITIALIZED;                        \
+  }                                                          \
+                                                             \
+  if (HANDLE_TO_INDEX(handle) >= fake_trace_gpu_count()) {   \
+    return NVAPI_EXPECTED_PHYSICAL_GPU_HANDLE;               \
+  }                                                          \
+                                                             \
+  if (fake_trace_lost(HANDLE_TO_INDEX(handle))) {            \
+    return NVAPI_NVIDIA_DEVICE_NOT_FOUND;                    \
+  }                                                          \
+} while (0)
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+static NvAPI_Status fake_NvAPI_EnumPhysicalGPUs(NvPhysicalGpuHandle nvGPUHandle[NVAPI_MAX_PHYSICAL_GPUS], NvU32 * pGpuCount) {
+  // Check if the library is initialized
+  if (!initialized) {
+    return NVAPI_API_NOT_INITIALIZED;
+  }
+
+  // Get the number of fake GPUs
+  unsigned int count = fake_trace_gpu_count();
+
+  // Enumerate in reverse NVML order, so the daemon has to match handles by bus id
+  for (unsigned int i = 0; i < count; i++) {
+    nvGPUHandle[i] = INDEX_TO_HANDLE(count - 1 - i);
+  }
+
+  // Return the number of GPUs
+  *pGpuCount = count;
+
+  // Return success
+  return NVAPI_OK;
+}
+
+static NvAPI_Status fake_NvAPI_GPU_GetBusId(NvPhysicalGpuHandle hPhysicalGpu, NvU32 * pBusId) {
+  // Validate the handle
+  NVAPI_HANDLE(hPhysicalGpu);
+
+  // Must match the bus reported by the fake NVML
+  *pBusId = HANDLE_TO_INDEX(hPhysicalGpu) + 1;
+
+  // Return success
+  return NVAPI_OK;
+}
+
+static NvAPI_Status fake_NvAPI_GPU_GetBusSlotId(NvPhysicalGpuHandle hPhysicalGpu, NvU32 * pBusSlotId) {
+  // Validate the handle
+  NVAPI_HANDLE(hPhysicalGpu);
+
+  // Must match the device reported by the fake NVML
+  *pBusSlotId = 0;
+
+  // Return success
+  return NVAPI_OK;
+}
+
+static NvAPI_Status fake_NvAPI_GPU_SetForcePstate(NvPhysicalGpuHandle hPhysicalGpu, NvU32 pstateId, NvU32 fallbackState) {
+  // Validate the handle
+  NVAPI_HANDLE(hPhysicalGpu);
+
+  // Performance states range from P0 to P15, 16 selects automatic management
+  if (pstateId > 16) {
+    return NVAPI_INVALID_ARGUMENT;
+  }
+
+  // Get the GPU index
+  unsigned int index = HANDLE_TO_INDEX(hPhysicalGpu);
+
+  // Count real transitions only
+  if (pstates[index] != pstateId) {
+    transitions[index]++;
+  }
+
+  // Store the performance state
+  pstates[index] = pstateId;
+
+  // Let the fake NVML draw power accordingly, if it is the one loaded
+  void (* notify)(unsigned int, unsigned int) = (void (*)(unsigned int, unsigned int)) dlsym(RTLD_DEFAULT, "fake_nvml_set_pstate");
+
+  if (notify != NULL) {
+    notify(index, pstateId);
+  }
+
+  // Record the call
+  fake_trace_log("pstate %u %u\n", index, pstateId);
+
+  // Return success
+  return NVAPI_OK;
+}
+
+static NvAPI_Status fake_NvAPI_GetErrorMessage(NvAPI_Status nr, NvAPI_ShortString szDesc) {
+  // Format the status code
+  snprintf(szDesc, NVAPI_SHORT_STRING_MAX, "NVAPI_STATUS(%d)", (int) nr);
+
+  // Return success
+  return NVAPI_OK;
+}
+
+static NvAPI_Status fake_NvAPI_Initialize(void) {
+  // If already initialized
+  if (initialized) {
+    return NVAPI_OK;
+  }
+
+  // Load the trace
+  if (!fake_trace_load()) {
+    return NVAPI_ERROR;
+  }
+
+  // Reset the per GPU bookkeeping; 16 means automatic management
+  for (unsigned int i = 0; i < FAKE_MAX_GPUS; i++) {
+    transitions[i] = 0;
+    pstates[i] = 16;
+  }
+
+  // Mark the library as initialized
+  initialized = true;
+
+  // Return success
+  return NVAPI_OK;
+}
+
+static NvAPI_Status fake_NvAPI_Unload(void) {
+  // Check if the library is initialized
+  if (!initialized) {
+    return NVAPI_API_NOT_INITIALIZED;
+  }
+
+  // Record the number of transitions of each GPU
+  for (unsigned int i = 0; i < fake_trace_gpu_count(); i++) {
+    fake_trace_log("transitions %u %lu\n", i, transitions[i]);
+  }
+
+  // Release the trace
+  fake_trace_unload();
+
+  // Mark the library as uninitialized
+  initialized = false;
+
+  // Return success
+  return NVAPI_OK;
+}
+
+void * nvapi_QueryInterface(int id) {
+  // Resolve the interface ids used by NvAPI_Initialize() in src/nvapi.c
+  switch ((unsigned int) id) {
+    case 0xe5ac921f:
+      return (void *) fake_NvAPI_EnumPhysicalGPUs;
+
+    case 0x1be0b8e5:
+      return (void *) fake_NvAPI_GPU_GetBusId;
+
+    case 0x2a0a350f:
+      return (void *) fake_NvAPI_GPU_GetBusSlotId;
+
+    case 0x025bfb10:
+      return (void *) fake_NvAPI_GPU_SetForcePstate;
+
+    case 0x6c2d048c:
+      return (void *) fake_NvAPI_GetErrorMessage;
+
+    case 0x0150e828:
+      return (void *) fake_NvAPI_Initialize;
+
+    case 0xd22bdd7e:
+      return (void *) fake_NvAPI_Unload;
+
+    default:
+      return NULL;
+  }
+}
@@ -0,0 +1,525 @@
+#include <nvml.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure backing the opaque NVML device handle
+struct nvmlDevice_st {
+  // Index of the fake GPU
+  unsigned int index;
+};
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Number of successful nvmlInit() calls not yet matched by nvmlShutdown()
+static unsigned int initCount = 0;
+
+// Device handles of all fake GPUs
+static struct nvmlDevice_st devices[FAKE_MAX_GPUS];
+
+// Flag indicating whether field values are emulated, unset to behave like an older driver
+static bool fieldsSupported = true;
+
+// Performance state forced through the fake NvAPI, 16 for automatic management
+static unsigned int pstates[FAKE_MAX_GPUS];
+
+// Number of consecutive GPUs sharing a fake NVSwitch, 0 if GPUs have no NVLink
+static unsigned int nvlinkGroup = 0;
+
+// Bytes received over PCIe so far, and the time they were counted up to (in milliseconds since the epoch)
+static unsigned long long pcieBytes[FAKE_MAX_GPUS];
+static unsigned long long pcieTimes[FAKE_MAX_GPUS];
+
+/***** ***** ***** ***** ***** MACROS ***** ***** ***** ***** *****/
+
+#define NVML_DEVICE(device) do {                   \
+  if (initCount == 0) {                            \
+    return NVML_ERROR_UNINITIALIZED;               \
+  }                                                \
+                                                   \
+  if (device == NULL) {                            \
+    return NVML_ERROR_INVALID_ARGUMENT;            \
+  }                                                \
+                                                   \
+  fake_trace_stall(device->index);                 \
+                                                   \
+  if (fake_trace_lost(device->index)) {            \
+    return NVML_ERROR_GPU_IS_LOST;                 \
+  }                                                \
+} while (0)
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static unsigned int fake_power(unsigned int index, unsigned int utilization) {
+  // Get the forced performance state, 16 if the driver manages it
+  unsigned int pstateId = pstates[index];
+
+  // 30 W idle and 280 W at full load, 205 W from P3 to P7 and 130 W from P8 down (in milliwatts)
+  if (pstateId >= 8 && pstateId < 16) {
+    return 30000 + utilization * 1000;
+  } else if (pstateId >= 3 && pstateId < 8) {
+    return 30000 + utilization * 1750;
+  } else {
+    return 30000 + utilization * 2500;
+  }
+}
+
+static unsigned long long fake_pcie_bytes(unsigned int index, unsigned int throughput, unsigned long long now) {
+  // Count the throughput of the trace (in megabytes per second) over the time since the previous read
+  if (now > pcieTimes[index]) {
+    pcieBytes[index] += (unsigned long long) throughput * 1000 * (now - pcieTimes[index]);
+    pcieTimes[index] = now;
+  }
+
+  // Return the bytes received so far
+  return pcieBytes[index];
+}
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+nvmlReturn_t nvmlInit(void) {
+  // Load the trace
+  if (!fake_trace_load()) {
+    return NVML_ERROR_UNKNOWN;
+  }
+
+  // Initialize the device handles, under automatic performance state management
+  for (unsigned int i = 0; i < FAKE_MAX_GPUS; i++) {
+    devices[i].index = i;
+    pstates[i] = 16;
+  }
+
+  // Check if field values should be reported as unsupported
+  fieldsSupported = getenv("FAKE_GPU_NO_FIELDS") == NULL;
+
+  // Get the size of the NVLink groups, if any
+  const char * nvlink = getenv("FAKE_GPU_NVLINK");
+  nvlinkGroup = nvlink != NULL ? (unsigned int) strtoul(nvlink, NULL, 10) : 0;
+
+  // Increment the initialization counter
+  initCount++;
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlShutdown(void) {
+  // Check if the library is initialized
+  if (initCount == 0) {
+    return NVML_ERROR_UNINITIALIZED;
+  }
+
+  // Decrement the initialization counter
+  initCount--;
+
+  // Release the trace
+  fake_trace_unload();
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+const char * nvmlErrorString(nvmlReturn_t result) {
+  switch (result) {
+    case NVML_SUCCESS:
+      return "Success";
+
+    case NVML_ERROR_UNINITIALIZED:
+      return "Uninitialized";
+
+    case NVML_ERROR_INVALID_ARGUMENT:
+      return "Invalid Argument";
+
+    case NVML_ERROR_NOT_SUPPORTED:
+      return "Not Supported";
+
+    case NVML_ERROR_NOT_FOUND:
+      return "Not Found";
+
+    case NVML_ERROR_INSUFFICIENT_SIZE:
+      return "Insufficient Size";
+
+    case NVML_ERROR_GPU_IS_LOST:
+      return "GPU is lost";
+
+    default:
+      return "Unknown Error";
+  }
+}
+
+nvmlReturn_t nvmlSystemGetDriverVersion(char * version, unsigned int length) {
+  // Check if the library is initialized
+  if (initCount == 0) {
+    return NVML_ERROR_UNINITIALIZED;
+  }
+
+  // Report a version no real driver has
+  snprintf(version, length, "0.0.fake");
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetHandleByIndex(unsigned int index, nvmlDevice_t * device) {
+  // Check if the library is initialized
+  if (initCount == 0) {
+    return NVML_ERROR_UNINITIALIZED;
+  }
+
+  // Validate the arguments
+  if (device == NULL || index >= fake_trace_gpu_count()) {
+    return NVML_ERROR_INVALID_ARGUMENT;
+  }
+
+  // Return the handle
+  *device = &devices[index];
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetPciInfo(nvmlDevice_t device, nvmlPciInfo_t * pci) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Clear the structure
+  memset(pci, 0, sizeof(*pci));
+
+  // Fake GPUs live on consecutive buses of the first domain
+  pci->domain = 0;
+  pci->bus = device->index + 1;
+  pci->device = 0;
+
+  // Format the bus id strings
+  snprintf(pci->busId, sizeof(pci->busId), "%08X:%02X:%02X.0", pci->domain, pci->bus, pci->device);
+  snprintf(pci->busIdLegacy, sizeof(pci->busIdLegacy), "%04X:%02X:%02X.0", pci->domain, pci->bus, pci->device);
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetUUID(nvmlDevice_t device, char * uuid, unsigned int length) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Format a UUID that is stable across runs
+  snprintf(uuid, length, "GPU-fa6e0000-0000-0000-0000-%012x", device->index);
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetName(nvmlDevice_t device, char * name, unsigned int length) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Format the name
+  snprintf(name, length, "Fake GPU %u", device->index);
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetTemperature(nvmlDevice_t device, nvmlTemperatureSensors_t sensorType, unsigned int * temp) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Only the GPU sensor is emulated
+  if (sensorType != NVML_TEMPERATURE_GPU) {
+    return NVML_ERROR_NOT_SUPPORTED;
+  }
+
+  // Replay the temperature from the trace
+  *temp = fake_trace_sample(device->index).temperature;
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetUtilizationRates(nvmlDevice_t device, nvmlUtilization_t * utilization) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Replay the utilization from the trace
+  utilization->gpu = fake_trace_sample(device->index).utilization;
+  utilization->memory = fake_trace_sample(device->index).memory;
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetSamples(nvmlDevice_t device, nvmlSamplingType_t type, unsigned long long lastSeenTimeStamp, nvmlValueType_t * sampleValType, unsigned int * sampleCount, nvmlSample_t * samples) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Only the GPU and memory controller utilization buffers are emulated
+  if (type != NVML_GPU_UTILIZATION_SAMPLES && type != NVML_MEMORY_UTILIZATION_SAMPLES) {
+    return NVML_ERROR_NOT_SUPPORTED;
+  }
+
+  // Sample timestamps are in microseconds, one sample every FAKE_SAMPLE_PERIOD milliseconds
+  unsigned long long now = fake_trace_now();
+  unsigned long long first = lastSeenTimeStamp / 1000 / FAKE_SAMPLE_PERIOD + 1;
+  unsigned long long last = now / FAKE_SAMPLE_PERIOD;
+
+  // If there are no samples since the last seen one
+  if (first > last) {
+    return NVML_ERROR_NOT_FOUND;
+  }
+
+  // If only the number of samples is requested
+  if (samples == NULL) {
+    *sampleCount = (unsigned int) (last - first + 1);
+    return NVML_SUCCESS;
+  }
+
+  // Return the most recent samples that fit into the buffer
+  if (last - first + 1 > *sampleCount) {
+    first = last + 1 - *sampleCount;
+  }
+
+  // Fill the samples from the trace
+  for (unsigned long long i = first; i <= last; i++) {
+    // Get the trace point of the sample
+    fakeTracePoint point = fake_trace_sample_at(device->index, i * FAKE_SAMPLE_PERIOD);
+
+    samples[i - first].timeStamp = i * FAKE_SAMPLE_PERIOD * 1000;
+    samples[i - first].sampleValue.uiVal = type == NVML_MEMORY_UTILIZATION_SAMPLES ? point.memory : point.utilization;
+  }
+
+  // Return the number of samples and their type
+  *sampleCount = (unsigned int) (last - first + 1);
+  *sampleValType = NVML_VALUE_TYPE_UNSIGNED_INT;
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetComputeRunningProcesses(nvmlDevice_t device, unsigned int * infoCount, nvmlProcessInfo_t * infos) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Replay the number of processes from the trace
+  unsigned int processes = fake_trace_sample(device->index).processes;
+
+  // If the buffer is too small
+  if (*infoCount < processes) {
+    *infoCount = processes;
+    return NVML_ERROR_INSUFFICIENT_SIZE;
+  }
+
+  // Fill the process information, each GPU has its own range of pids
+  for (unsigned int i = 0; i < processes; i++) {
+    memset(&infos[i], 0, sizeof(infos[i]));
+    infos[i].pid = 1000 + device->index * 1000 + i;
+  }
+
+  // Return the number of processes
+  *infoCount = processes;
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetPcieThroughput(nvmlDevice_t device, nvmlPcieUtilCounter_t counter, unsigned int * value) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Replay the throughput from the trace as host to device traffic (in kilobytes per second)
+  *value = counter == NVML_PCIE_UTIL_RX_BYTES ? fake_trace_sample(device->index).pcie * 1000 : 0;
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetEncoderUtilization(nvmlDevice_t device, unsigned int * utilization, unsigned int * samplingPeriodUs) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Replay the utilization from the trace, over one sample period
+  *utilization = fake_trace_sample(device->index).encoder;
+  *samplingPeriodUs = FAKE_SAMPLE_PERIOD * 1000;
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetDecoderUtilization(nvmlDevice_t device, unsigned int * utilization, unsigned int * samplingPeriodUs) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Replay the utilization from the trace, over one sample period
+  *utilization = fake_trace_sample(device->index).decoder;
+  *samplingPeriodUs = FAKE_SAMPLE_PERIOD * 1000;
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetPowerUsage(nvmlDevice_t device, unsigned int * power) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Derive the power draw from the utilization
+  *power = fake_power(device->index, fake_trace_sample(device->index).utilization);
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetEnforcedPowerLimit(nvmlDevice_t device, unsigned int * limit) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Report a limit above the full load draw (in milliwatts)
+  *limit = 300000;
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetSupportedPerformanceStates(nvmlDevice_t device, nvmlPstates_t * pstates, unsigned int size) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Performance states of a typical GPU
+  static const nvmlPstates_t supported[] = { NVML_PSTATE_0, NVML_PSTATE_2, NVML_PSTATE_5, NVML_PSTATE_8 };
+
+  // Check if the array is large enough (in bytes)
+  if (size < sizeof(supported)) {
+    return NVML_ERROR_INSUFFICIENT_SIZE;
+  }
+
+  // Fill the array, the remaining entries are unknown
+  for (unsigned int i = 0; i < size / sizeof(nvmlPstates_t); i++) {
+    pstates[i] = i < sizeof(supported) / sizeof(supported[0]) ? supported[i] : NVML_PSTATE_UNKNOWN;
+  }
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetTopologyCommonAncestor(nvmlDevice_t device1, nvmlDevice_t device2, nvmlGpuTopologyLevel_t * pathInfo) {
+  // Validate the devices
+  NVML_DEVICE(device1);
+  NVML_DEVICE(device2);
+
+  // Each fake GPU sits on its own root port, so GPUs only meet at the host bridge
+  *pathInfo = device1 == device2 ? NVML_TOPOLOGY_INTERNAL : NVML_TOPOLOGY_HOSTBRIDGE;
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetNvLinkState(nvmlDevice_t device, unsigned int link, nvmlEnableState_t * isActive) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // GPUs without NVLink, and links past the two each fake GPU has, are not supported
+  if (nvlinkGroup == 0 || link >= 2) {
+    return NVML_ERROR_NOT_SUPPORTED;
+  }
+
+  // Both links are up
+  *isActive = NVML_FEATURE_ENABLED;
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetNvLinkRemotePciInfo(nvmlDevice_t device, unsigned int link, nvmlPciInfo_t * pci) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // GPUs without NVLink, and links past the two each fake GPU has, are not supported
+  if (nvlinkGroup == 0 || link >= 2) {
+    return NVML_ERROR_NOT_SUPPORTED;
+  }
+
+  // Clear the structure
+  memset(pci, 0, sizeof(*pci));
+
+  // Both links lead to the NVSwitch of the group, which lives past the GPU buses
+  pci->domain = 0;
+  pci->bus = 0x80 + device->index / nvlinkGroup;
+  pci->device = 0;
+
+  // Format the bus id strings
+  snprintf(pci->busId, sizeof(pci->busId), "%08X:%02X:%02X.0", pci->domain, pci->bus, pci->device);
+  snprintf(pci->busIdLegacy, sizeof(pci->busIdLegacy), "%04X:%02X:%02X.0", pci->domain, pci->bus, pci->device);
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlDeviceGetFieldValues(nvmlDevice_t device, int valuesCount, nvmlFieldValue_t * values) {
+  // Validate the device
+  NVML_DEVICE(device);
+
+  // Get the current point of the trace
+  fakeTracePoint point = fake_trace_sample(device->index);
+
+  // Fill each requested field
+  for (int i = 0; i < valuesCount; i++) {
+    // Get the field
+    nvmlFieldValue_t * field = &values[i];
+
+    // Fields carry their own result
+    field->timestamp = (long long) fake_trace_now() * 1000;
+    field->latencyUsec = 0;
+    field->valueType = NVML_VALUE_TYPE_UNSIGNED_INT;
+    field->nvmlReturn = NVML_SUCCESS;
+
+    // Older drivers know none of the fields
+    if (!fieldsSupported) {
+      field->nvmlReturn = NVML_ERROR_NOT_SUPPORTED;
+      continue;
+    }
+
+    // Emulate the fields the daemon reads
+    switch (field->fieldId) {
+      case NVML_FI_DEV_MEMORY_TEMP:
+        // The memory runs a few degrees cooler than the GPU
+        field->value.uiVal = point.temperature > 5 ? point.temperature - 5 : 0;
+        break;
+
+      case NVML_FI_DEV_POWER_INSTANT:
+        // Same power draw as nvmlDeviceGetPowerUsage()
+        field->value.uiVal = fake_power(device->index, point.utilization);
+        break;
+
+      #if defined(NVML_FI_DEV_PCIE_COUNT_TX_BYTES) && defined(NVML_FI_DEV_PCIE_COUNT_RX_BYTES)
+        case NVML_FI_DEV_PCIE_COUNT_TX_BYTES:
+          // Same host to device traffic as nvmlDeviceGetPcieThroughput(), nothing is sent
+          field->valueType = NVML_VALUE_TYPE_UNSIGNED_LONG_LONG;
+          field->value.ullVal = 0;
+          break;
+
+        case NVML_FI_DEV_PCIE_COUNT_RX_BYTES:
+          // The throughput of the trace, counted up as bytes
+          field->valueType = NVML_VALUE_TYPE_UNSIGNED_LONG_LONG;
+          field->value.ullVal = fake_pcie_bytes(device->index, point.pcie, fake_trace_now());
+          break;
+      #endif
+
+      default:
+        field->nvmlReturn = NVML_ERROR_NOT_SUPPORTED;
+        break;
+    }
+  }
+
+  // Return success
+  return NVML_SUCCESS;
+}
+
+void fake_nvml_set_pstate(unsigned int gpu, unsigned int pstateId) {
+  // Called by the fake NvAPI, which has no other way to reach this library
+  if (gpu < FAKE_MAX_GPUS) {
+    pstates[gpu] = pstateId;
+  }
+}
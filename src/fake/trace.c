@@ -0,0 +1,404 @@
+#include "trace.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../utils.h"
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the trace of a single GPU
+typedef struct {
+  // Trace points, sorted by time
+  fakeTracePoint * points;
+
+  // Number of trace points
+  size_t count;
+
+  // Capacity of the points array
+  size_t capacity;
+} fakeTrace;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Number of initialization calls (initialization is reference counted)
+static unsigned int references = 0;
+
+// Number of fake GPUs
+static unsigned int gpuCount = 1;
+
+// Traces of all GPUs
+static fakeTrace traces[FAKE_MAX_GPUS];
+
+// Length of a trace cycle (in milliseconds), zero if the trace should not loop
+static unsigned long long loopLength = 0;
+
+// Epoch of the trace (CLOCK_MONOTONIC, in nanoseconds)
+static unsigned long long epoch = 0;
+
+// Stream for the event log
+static FILE * logFile = NULL;
+
+// Delay of each call on a slow GPU (in milliseconds)
+static unsigned long stalls[FAKE_MAX_GPUS];
+
+// Time window during which each GPU is lost (in milliseconds since the epoch), empty if never
+static unsigned long long lostFrom[FAKE_MAX_GPUS];
+static unsigned long long lostUntil[FAKE_MAX_GPUS];
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static bool trace_append(unsigned int gpu, fakeTracePoint point) {
+  // Get the trace of the GPU
+  fakeTrace * trace = &traces[gpu];
+
+  // Points must be specified in chronological order
+  if (trace->count != 0 && trace->points[trace->count - 1].time > point.time) {
+    return false;
+  }
+
+  // Grow the array if needed
+  if (trace->count == trace->capacity) {
+    // Double the capacity
+    size_t capacity = trace->capacity ? trace->capacity * 2 : 64;
+
+    // Reallocate the points array
+    fakeTracePoint * points = realloc(trace->points, capacity * sizeof(fakeTracePoint));
+
+    // Check if the reallocation failed
+    if (points == NULL) {
+      return false;
+    }
+
+    // Store the new array
+    trace->points = points;
+    trace->capacity = capacity;
+  }
+
+  // Store the point
+  trace->points[trace->count++] = point;
+
+  // Return true to indicate success
+  return true;
+}
+
+static bool trace_parse(const char * path) {
+  // Open the trace file
+  FILE * file = fopen(path, "r");
+
+  // Check if the file was opened
+  if (file == NULL) {
+    fprintf(stderr, "fake: unable to open trace %s: %s\n", path, strerror(errno));
+    return false;
+  }
+
+  // Buffer to hold the current line
+  char line[256];
+
+  // Current line number
+  unsigned int lineNumber = 0;
+
+  // Read the file line by line
+  while (fgets(line, sizeof(line), file) != NULL) {
+    // Increment the line number
+    lineNumber++;
+
+    // Fields of the line
+    unsigned long long time;
+    char gpu[16];
+    unsigned int temperature;
+    unsigned int utilization;
+    unsigned int processes = 0;
+    unsigned int memory = 0;
+    unsigned int pcie = 0;
+    unsigned int encoder = 0;
+    unsigned int decoder = 0;
+
+    // Skip comments
+    if (line[strspn(line, " \t")] == '#') {
+      continue;
+    }
+
+    // Parse the line as "<time ms> <gpu|*> <temperature> <utilization> [processes [memory [pcie [encoder [decoder]]]]]"
+    int fields = sscanf(line, "%llu %15s %u %u %u %u %u %u %u", &time, gpu, &temperature, &utilization, &processes, &memory, &pcie, &encoder, &decoder);
+
+    // Skip empty lines
+    if (fields <= 0) {
+      continue;
+    }
+
+    // Check if the line is complete
+    if (fields < 4) {
+      fprintf(stderr, "fake: %s:%u: expected \"<time> <gpu> <temperature> <utilization> [processes [memory [pcie [encoder [decoder]]]]]\"\n", path, lineNumber);
+      fclose(file);
+      return false;
+    }
+
+    // Construct the trace point
+    fakeTracePoint point = { time, temperature, utilization, processes, memory, pcie, encoder, decoder };
+
+    // Range of GPUs the point applies to
+    unsigned long first = 0;
+    unsigned long last = gpuCount - 1;
+
+    // If the point applies to a single GPU
+    if (strcmp(gpu, "*") != 0) {
+      // Parse the GPU index
+      if (!parse_ulong(gpu, &first) || first >= gpuCount) {
+        fprintf(stderr, "fake: %s:%u: invalid GPU index %s\n", path, lineNumber, gpu);
+        fclose(file);
+        return false;
+      }
+
+      // Only this GPU
+      last = first;
+    }
+
+    // Append the point to each GPU
+    for (unsigned long i = first; i <= last; i++) {
+      if (!trace_append(i, point)) {
+        fprintf(stderr, "fake: %s:%u: points must be in chronological order\n", path, lineNumber);
+        fclose(file);
+        return false;
+      }
+    }
+
+    // Track the length of the trace cycle
+    if (time + 1 > loopLength) {
+      loopLength = time + 1;
+    }
+  }
+
+  // Close the trace file
+  fclose(file);
+
+  // Return true to indicate success
+  return true;
+}
+
+bool fake_trace_load(void) {
+  // If the trace is already loaded
+  if (references++ != 0) {
+    return true;
+  }
+
+  // Get the number of fake GPUs
+  const char * count = getenv("FAKE_GPU_COUNT");
+
+  // If the number of GPUs is specified
+  if (count != NULL) {
+    // Variable to hold the parsed value
+    unsigned long value;
+
+    // Parse and validate the number of GPUs
+    if (!parse_ulong(count, &value) || value == 0 || value > FAKE_MAX_GPUS) {
+      fprintf(stderr, "fake: FAKE_GPU_COUNT must be between 1 and %u\n", FAKE_MAX_GPUS);
+      references--;
+      return false;
+    }
+
+    // Store the number of GPUs
+    gpuCount = value;
+  }
+
+  // Get the epoch shared between the fake libraries
+  const char * sharedEpoch = getenv("FAKE_GPU_EPOCH");
+
+  // If another library already defined the epoch, reuse it; otherwise define it
+  if (sharedEpoch == NULL || sscanf(sharedEpoch, "%llu", &epoch) != 1) {
+    // Buffer to hold the formatted epoch
+    char buffer[32];
+
+    // Use the current time as the epoch
+    epoch = get_time_ns();
+
+    // Export the epoch so the other library uses the same time base
+    snprintf(buffer, sizeof(buffer), "%llu", epoch);
+    setenv("FAKE_GPU_EPOCH", buffer, 0);
+  }
+
+  // Get the path of the trace
+  const char * path = getenv("FAKE_GPU_TRACE");
+
+  // Parse the trace if specified
+  if (path != NULL && !trace_parse(path)) {
+    fake_trace_unload();
+    return false;
+  }
+
+  // Disable looping unless requested
+  if (getenv("FAKE_GPU_TRACE_LOOP") == NULL) {
+    loopLength = 0;
+  }
+
+  // Get the list of slow GPUs, formatted as "<gpu>:<ms>[,<gpu>:<ms>...]"
+  const char * slow = getenv("FAKE_GPU_SLOW");
+
+  // Parse the list of slow GPUs
+  for (const char * entry = slow; entry != NULL && *entry != '\0'; entry = strchr(entry, ',') ? strchr(entry, ',') + 1 : NULL) {
+    // Fields of the entry
+    unsigned int gpu;
+    unsigned long delay;
+
+    // Parse the entry
+    if (sscanf(entry, "%u:%lu", &gpu, &delay) != 2 || gpu >= gpuCount) {
+      fprintf(stderr, "fake: invalid FAKE_GPU_SLOW entry: %s\n", entry);
+      fake_trace_unload();
+      return false;
+    }
+
+    // Store the delay
+    stalls[gpu] = delay;
+  }
+
+  // Get the list of lost GPUs, formatted as "<gpu>:<from ms>:<until ms>[,...]"
+  const char * lost = getenv("FAKE_GPU_LOST");
+
+  // Parse the list of lost GPUs
+  for (const char * entry = lost; entry != NULL && *entry != '\0'; entry = strchr(entry, ',') ? strchr(entry, ',') + 1 : NULL) {
+    // Fields of the entry
+    unsigned int gpu;
+    unsigned long long from;
+    unsigned long long until;
+
+    // Parse the entry
+    if (sscanf(entry, "%u:%llu:%llu", &gpu, &from, &until) != 3 || gpu >= gpuCount || from > until) {
+      fprintf(stderr, "fake: invalid FAKE_GPU_LOST entry: %s\n", entry);
+      fake_trace_unload();
+      return false;
+    }
+
+    // Store the window
+    lostFrom[gpu] = from;
+    lostUntil[gpu] = until;
+  }
+
+  // Get the path of the event log
+  const char * logPath = getenv("FAKE_GPU_LOG");
+
+  // Open the event log if specified
+  if (logPath != NULL) {
+    // Open the log in append mode
+    logFile = fopen(logPath, "a");
+
+    // Check if the log was opened
+    if (logFile == NULL) {
+      fprintf(stderr, "fake: unable to open log %s: %s\n", logPath, strerror(errno));
+      fake_trace_unload();
+      return false;
+    }
+
+    // Flush each line so the log can be followed while the daemon runs
+    setvbuf(logFile, NULL, _IOLBF, 0);
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+void fake_trace_unload(void) {
+  // Only the last reference holder releases the resources
+  if (references == 0 || --references != 0) {
+    return;
+  }
+
+  // Free the traces
+  for (unsigned int i = 0; i < FAKE_MAX_GPUS; i++) {
+    SAFE_FREE(traces[i].points);
+    traces[i].count = 0;
+    traces[i].capacity = 0;
+    stalls[i] = 0;
+    lostFrom[i] = 0;
+    lostUntil[i] = 0;
+  }
+
+  // Close the event log
+  if (logFile != NULL) {
+    fclose(logFile);
+    logFile = NULL;
+  }
+}
+
+unsigned int fake_trace_gpu_count(void) {
+  return gpuCount;
+}
+
+unsigned long long fake_trace_now(void) {
+  // Milliseconds since the epoch
+  return (get_time_ns() - epoch) / 1000000ULL;
+}
+
+void fake_trace_stall(unsigned int gpu) {
+  // Emulate a slow driver call on this GPU
+  if (stalls[gpu] != 0) {
+    usleep(stalls[gpu] * 1000);
+  }
+}
+
+bool fake_trace_lost(unsigned int gpu) {
+  // Get the current time
+  unsigned long long now = fake_trace_now();
+
+  // Check if the GPU is off the bus at this time
+  return now >= lostFrom[gpu] && now < lostUntil[gpu];
+}
+
+fakeTracePoint fake_trace_sample(unsigned int gpu) {
+  // Sample the trace at the current time
+  return fake_trace_sample_at(gpu, fake_trace_now());
+}
+
+fakeTracePoint fake_trace_sample_at(unsigned int gpu, unsigned long long now) {
+  // Default point if the trace has no data for the given time
+  fakeTracePoint point = { 0, FAKE_DEFAULT_TEMPERATURE, FAKE_DEFAULT_UTILIZATION, 0, 0, 0, 0, 0 };
+
+  // Get the trace of the GPU
+  fakeTrace * trace = &traces[gpu];
+
+  // Wrap the time around if the trace loops
+  if (loopLength != 0) {
+    now %= loopLength;
+  }
+
+  // Binary search for the last point at or before the given time
+  size_t low = 0;
+  size_t high = trace->count;
+
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+
+    if (trace->points[middle].time <= now) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  // If such a point exists, use it
+  if (low != 0) {
+    point = trace->points[low - 1];
+  }
+
+  // Return the point
+  return point;
+}
+
+void fake_trace_log(const char * format, ...) {
+  // Buffer to hold the message
+  char message[256];
+
+  // Variable argument list
+  va_list args;
+
+  // Format the message
+  va_start(args, format);
+  vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+
+  // Write the timestamp followed by the message in a single call
+  fprintf(logFile ? logFile : stderr, "%llu %s", fake_trace_now(), message);
+}
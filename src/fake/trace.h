@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of fake GPUs (matches NVAPI_MAX_PHYSICAL_GPUS)
+#define FAKE_MAX_GPUS 64
+
+// Temperature reported when no trace point is available (in degrees C)
+#define FAKE_DEFAULT_TEMPERATURE 40
+
+// Utilization reported when no trace point is available (in percentage)
+#define FAKE_DEFAULT_UTILIZATION 0
+
+// Period of the emulated utilization sample buffer (in milliseconds)
+#define FAKE_SAMPLE_PERIOD 20
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold a single point of a telemetry trace
+typedef struct {
+  // Time of the point (in milliseconds since the epoch)
+  unsigned long long time;
+
+  // GPU temperature (in degrees C)
+  unsigned int temperature;
+
+  // GPU utilization (in percentage)
+  unsigned int utilization;
+
+  // Number of running compute processes
+  unsigned int processes;
+
+  // Memory controller utilization (in percentage)
+  unsigned int memory;
+
+  // PCIe throughput, both directions together (in megabytes per second)
+  unsigned int pcie;
+
+  // Encoder and decoder utilization (in percentage)
+  unsigned int encoder;
+  unsigned int decoder;
+} fakeTracePoint;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool fake_trace_load(void);
+void fake_trace_unload(void);
+unsigned int fake_trace_gpu_count(void);
+unsigned long long fake_trace_now(void);
+fakeTracePoint fake_trace_sample(unsigned int gpu);
+fakeTracePoint fake_trace_sample_at(unsigned int gpu, unsigned long long now);
+void fake_trace_stall(unsigned int gpu);
+bool fake_trace_lost(unsigned int gpu);
+void fake_trace_log(const char * format, ...);
@@ -0,0 +1,444 @@
+#ifdef __linux__
+  // Required for syscall()
+  #define _GNU_SOURCE
+#endif
+
+#include "fan.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+  #include <poll.h>
+  #include <pthread.h>
+  #include <signal.h>
+  #include <spawn.h>
+  #include <sys/eventfd.h>
+  #include <sys/syscall.h>
+  #include <sys/wait.h>
+  #include <unistd.h>
+#endif
+
+#include "metrics.h"
+#include "scheduler.h"
+#include "utils.h"
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Fan states
+typedef enum {
+  // No script has been requested yet
+  FAN_STATE_UNKNOWN,
+
+  // The fan is enabled
+  FAN_STATE_ENABLED,
+
+  // The fan is disabled
+  FAN_STATE_DISABLED,
+} fanState;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Latest requested fan state
+static fanState requested = FAN_STATE_UNKNOWN;
+
+// Script and timeout (in milliseconds) applying the latest requested state
+static char * requestedScript = NULL;
+static unsigned long requestedTimeout = 0;
+
+// URL requested instead of running the script, and how it is requested
+static char * requestedUrl = NULL;
+static httpOptions requestedHttp;
+
+// Fan state of the last script started
+static fanState applied = FAN_STATE_UNKNOWN;
+
+#ifdef __linux__
+  // Environment passed to the scripts
+  extern char ** environ;
+
+  // Process running the script, -1 if none
+  static pid_t child = -1;
+
+  // Process file descriptor of the running script, -1 if the kernel has no pidfd_open
+  static int childFd = -1;
+
+  // Flag indicating whether the running script enables the fan
+  static bool childEnable = false;
+
+  // Time at which the running script is killed (CLOCK_MONOTONIC, in nanoseconds), zero if never
+  static unsigned long long childDeadline = 0;
+
+  // Thread making the HTTP request, so the control loop never waits for the network
+  static pthread_t requestThread;
+
+  // Flag indicating whether the thread is running
+  static bool requestRunning = false;
+
+  // Flag indicating whether the thread has finished, and the status it got
+  static bool requestDone = false;
+  static int requestStatus = 0;
+
+  // URL and options of the running request, owned by the thread until it finishes
+  static char * requestUrl = NULL;
+  static httpOptions requestOptions;
+
+  // Flag indicating whether the running request enables the fan
+  static bool requestEnable = false;
+
+  // Event signalled by the thread when done, -1 if not created yet
+  static int requestEvent = -1;
+#endif
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static void report(bool enable, int exitCode) {
+  // Publish the result
+  metrics_fan_script_result(enable, exitCode);
+
+  // Print error message if the script failed
+  if (exitCode == FAN_TIMED_OUT) {
+    printf("Fan %s script timed out and was killed\n", enable ? "enable" : "disable");
+  } else if (exitCode != 0) {
+    printf("Fan %s script failed with exit code %d\n", enable ? "enable" : "disable", exitCode);
+  }
+}
+
+static void report_url(bool enable, int status) {
+  // Publish the result, zero for a successful request like a successful script
+  metrics_fan_script_result(enable, status >= 200 && status < 300 ? 0 : status);
+
+  // Print error message if the request failed
+  if (status == HTTP_TIMED_OUT) {
+    printf("Fan %s URL timed out\n", enable ? "enable" : "disable");
+  } else if (status == HTTP_FAILED) {
+    printf("Fan %s URL request failed\n", enable ? "enable" : "disable");
+  } else if (status < 200 || status >= 300) {
+    printf("Fan %s URL returned status %d\n", enable ? "enable" : "disable", status);
+  }
+}
+
+#ifdef __linux__
+  static void * request_main(void * argument) {
+    // Make the request, with its retries
+    int status = http_get(requestUrl, &requestOptions);
+
+    // Publish the status
+    requestStatus = status;
+    ATOMIC_STORE(&requestDone, true);
+
+    // Wake up the control loop
+    unsigned long long value = 1;
+    write(requestEvent, &value, sizeof(value));
+
+    // Return nothing
+    return NULL;
+  }
+
+  static bool start_request(bool enable, const char * url, const httpOptions * http) {
+    // Create the completion event once
+    if (requestEvent == -1) {
+      requestEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+      if (requestEvent == -1) {
+        fprintf(stderr, "eventfd(): %s\n", strerror(errno));
+        return false;
+      }
+    }
+
+    // Give the thread its own copy of the request
+    requestUrl = strdup(url);
+
+    if (requestUrl == NULL) {
+      fprintf(stderr, "Unable to allocate memory for the fan URL\n");
+      return false;
+    }
+
+    requestOptions = *http;
+    requestEnable = enable;
+    requestDone = false;
+
+    // Start the request
+    int ret = pthread_create(&requestThread, NULL, request_main, NULL);
+
+    // Check if the thread was created
+    if (ret != 0) {
+      fprintf(stderr, "pthread_create(): %s\n", strerror(ret));
+      SAFE_FREE(requestUrl);
+      return false;
+    }
+
+    // Mark the request as running
+    requestRunning = true;
+
+    // Wake up the control loop when the request is done, otherwise it is collected on the next poll
+    scheduler_watch(requestEvent);
+
+    // Return true to indicate success
+    return true;
+  }
+
+  static void reap_request(void) {
+    // If no request is running or it is not done yet
+    if (!requestRunning || !ATOMIC_LOAD(&requestDone)) {
+      return;
+    }
+
+    // Collect the thread
+    pthread_join(requestThread, NULL);
+    requestRunning = false;
+
+    // Acknowledge the event
+    unsigned long long value;
+    read(requestEvent, &value, sizeof(value));
+    scheduler_unwatch(requestEvent);
+
+    // Release the copy of the URL
+    SAFE_FREE(requestUrl);
+
+    // Report the result
+    report_url(requestEnable, requestStatus);
+  }
+
+  static bool start_script(bool enable, const char * script, unsigned long timeout) {
+    // Run the script through the shell, like system() does
+    char * argv[] = { "sh", "-c", (char *) script, NULL };
+
+    // Attributes of the script process
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+
+    // Put the script in its own process group, so a timeout also kills the commands it started
+    posix_spawnattr_setpgroup(&attributes, 0);
+
+    // Don't pass down the signal mask of the calling thread
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attributes, &mask);
+
+    // Apply the attributes
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+
+    // Start the script without waiting for it
+    int ret = posix_spawn(&child, "/bin/sh", NULL, &attributes, argv, environ);
+
+    // Release the attributes
+    posix_spawnattr_destroy(&attributes);
+
+    // Check if the script was started
+    if (ret != 0) {
+      fprintf(stderr, "posix_spawn(): %s\n", strerror(ret));
+      child = -1;
+      return false;
+    }
+
+    // Remember what the script does and when it is killed
+    childEnable = enable;
+    childDeadline = timeout != 0 ? get_time_ns() + (unsigned long long) timeout * 1000000ULL : 0;
+
+    #ifdef SYS_pidfd_open
+      // Wake up the control loop as soon as the script exits, older kernels wait for the next poll
+      childFd = (int) syscall(SYS_pidfd_open, child, 0);
+
+      if (childFd != -1 && !scheduler_watch(childFd)) {
+        close(childFd);
+        childFd = -1;
+      }
+    #endif
+
+    // Return true to indicate success
+    return true;
+  }
+
+  static bool reap_script(void) {
+    // If no script is running
+    if (child == -1) {
+      return true;
+    }
+
+    // Variable to hold the exit status
+    int status;
+
+    // Check if the script exited
+    pid_t ret = waitpid(child, &status, WNOHANG);
+
+    // Check if the status was retrieved
+    if (ret == -1) {
+      fprintf(stderr, "waitpid(): %s\n", strerror(errno));
+      return false;
+    }
+
+    // If the script is still running
+    if (ret == 0) {
+      // Let it run until the timeout
+      if (childDeadline == 0 || get_time_ns() < childDeadline) {
+        return true;
+      }
+
+      // Kill the script and the commands it started
+      kill(-child, SIGKILL);
+
+      // Collect it, SIGKILL can't be ignored so this doesn't block for long
+      while (waitpid(child, &status, 0) == -1 && errno == EINTR);
+
+      // Report the timeout
+      report(childEnable, FAN_TIMED_OUT);
+    } else {
+      // Report the exit code, or the signal that terminated the script like the shell does
+      report(childEnable, WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+    }
+
+    // Stop watching the script
+    if (childFd != -1) {
+      scheduler_unwatch(childFd);
+      close(childFd);
+      childFd = -1;
+    }
+
+    // Forget the script
+    child = -1;
+
+    // Return true to indicate success
+    return true;
+  }
+#endif
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+bool fan_request(bool enable, const char * script, const char * url, unsigned long timeout, const httpOptions * http) {
+  // Get the desired state
+  fanState state = enable ? FAN_STATE_ENABLED : FAN_STATE_DISABLED;
+
+  // Only the latest request matters, it replaces the one still waiting for the running action
+  if (state != requested) {
+    // Store the desired state
+    requested = state;
+
+    // Copy the script, the options may be reloaded before it runs
+    SAFE_FREE(requestedScript);
+
+    if (script != NULL && (requestedScript = strdup(script)) == NULL) {
+      fprintf(stderr, "Unable to allocate memory for the fan script\n");
+      return false;
+    }
+
+    // Copy the URL, which takes precedence over the script
+    SAFE_FREE(requestedUrl);
+
+    if (url != NULL && (requestedUrl = strdup(url)) == NULL) {
+      fprintf(stderr, "Unable to allocate memory for the fan URL\n");
+      return false;
+    }
+
+    // Store the timeouts
+    requestedTimeout = timeout;
+    requestedHttp = *http;
+  }
+
+  // Start the script if nothing else is running
+  return fan_process();
+}
+
+bool fan_process(void) {
+  #ifdef __linux__
+    // Collect the running script if it exited or timed out
+    if (!reap_script()) {
+      return false;
+    }
+
+    // Collect the running request if it is done
+    reap_request();
+
+    // The next action waits for the running one
+    if (child != -1 || requestRunning) {
+      return true;
+    }
+  #endif
+
+  // If the fan is already in the requested state
+  if (requested == applied) {
+    return true;
+  }
+
+  // Update the fan state, even if the script fails, so a broken script isn't rerun on every poll
+  applied = requested;
+
+  // Get the direction of the change
+  bool enable = applied == FAN_STATE_ENABLED;
+
+  // If a URL is provided
+  if (requestedUrl != NULL) {
+    // Print message indicating the URL is being requested
+    printf("Requesting fan %s URL\n", enable ? "enable" : "disable");
+
+    // Count the invocation
+    metrics_fan_script(enable);
+
+    #ifdef __linux__
+      // Make the request in the background, a failure to start it is reported but not fatal
+      start_request(enable, requestedUrl, &requestedHttp);
+    #else
+      // Make the request
+      report_url(enable, http_get(requestedUrl, &requestedHttp));
+    #endif
+
+    // Return true to indicate success
+    return true;
+  }
+
+  // If no script is provided
+  if (requestedScript == NULL) {
+    return true;
+  }
+
+  // Print message indicating the script is being invoked
+  printf("Invoking fan %s script\n", enable ? "enable" : "disable");
+
+  // Count the invocation
+  metrics_fan_script(enable);
+
+  #ifdef __linux__
+    // Start the script in the background, a failure to start it is reported but not fatal
+    start_script(enable, requestedScript, requestedTimeout);
+  #else
+    // Run the script, without the means to time it out
+    report(enable, system(requestedScript));
+  #endif
+
+  // Return true to indicate success
+  return true;
+}
+
+void fan_deinit(void) {
+  #ifdef __linux__
+    // Let the running and the waiting scripts finish, within their timeouts
+    while (child != -1 || requestRunning || requested != applied) {
+      // Collect the running script or start the waiting one
+      if (!fan_process()) {
+        break;
+      }
+
+      // Check again shortly
+      if (child != -1 || requestRunning) {
+        poll(NULL, 0, 10);
+      }
+    }
+
+    // Release the completion event
+    if (requestEvent != -1) {
+      close(requestEvent);
+      requestEvent = -1;
+    }
+  #endif
+
+  // Close the kept-alive connection
+  http_close();
+
+  // Forget the requested state
+  SAFE_FREE(requestedScript);
+  SAFE_FREE(requestedUrl);
+  requested = FAN_STATE_UNKNOWN;
+  applied = FAN_STATE_UNKNOWN;
+}
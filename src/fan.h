@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "http.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Exit code reported for a script killed after its timeout
+#define FAN_TIMED_OUT -1
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool fan_request(bool enable, const char * script, const char * url, unsigned long timeout, const httpOptions * http);
+bool fan_process(void);
+void fan_deinit(void);
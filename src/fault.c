@@ -0,0 +1,90 @@
+#include "fault.h"
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Worst driver error of the current thread since it was last taken
+#ifdef _WIN32
+  static __declspec(thread) faultKind currentFault = FAULT_NONE;
+#else
+  static _Thread_local faultKind currentFault = FAULT_NONE;
+#endif
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static void raise_fault(faultKind kind) {
+  // Keep the worst error, a lost GPU also times out
+  if (kind > currentFault) {
+    currentFault = kind;
+  }
+}
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+void fault_nvml(nvmlReturn_t result) {
+  switch (result) {
+    case NVML_SUCCESS:
+      return;
+
+    case NVML_ERROR_TIMEOUT:
+    case NVML_ERROR_IRQ_ISSUE:
+    case NVML_ERROR_UNKNOWN:
+      raise_fault(FAULT_TRANSIENT);
+      return;
+
+    case NVML_ERROR_GPU_IS_LOST:
+    case NVML_ERROR_RESET_REQUIRED:
+      raise_fault(FAULT_LOST);
+      return;
+
+    default:
+      raise_fault(FAULT_FATAL);
+      return;
+  }
+}
+
+void fault_nvapi(NvAPI_Status status) {
+  switch (status) {
+    case NVAPI_OK:
+      return;
+
+    case NVAPI_ERROR:
+      raise_fault(FAULT_TRANSIENT);
+      return;
+
+    case NVAPI_NVIDIA_DEVICE_NOT_FOUND:
+    case NVAPI_HANDLE_INVALIDATED:
+      raise_fault(FAULT_LOST);
+      return;
+
+    default:
+      raise_fault(FAULT_FATAL);
+      return;
+  }
+}
+
+faultKind fault_take(void) {
+  // Get the worst error
+  faultKind kind = currentFault;
+
+  // Start over for the next calls
+  currentFault = FAULT_NONE;
+
+  // Return the worst error
+  return kind;
+}
+
+const char * fault_name(faultKind kind) {
+  switch (kind) {
+    case FAULT_NONE:
+      return "none";
+
+    case FAULT_TRANSIENT:
+      return "transient";
+
+    case FAULT_LOST:
+      return "lost";
+
+    default:
+      return "fatal";
+  }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <nvapi.h>
+#include <nvml.h>
+
+/***** ***** ***** ***** ***** TYPES ***** ***** ***** ***** *****/
+
+// Kind of the worst driver error of the current thread, in increasing severity
+typedef enum {
+  // No driver call failed
+  FAULT_NONE,
+
+  // A call failed in a way that may pass, such as a timeout
+  FAULT_TRANSIENT,
+
+  // The GPU fell off the bus or needs a reset, its handle is fetched again before retrying
+  FAULT_LOST,
+
+  // A call failed in a way retrying can't fix, such as an invalid argument
+  FAULT_FATAL,
+} faultKind;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+void fault_nvml(nvmlReturn_t result);
+void fault_nvapi(NvAPI_Status status);
+faultKind fault_take(void);
+const char * fault_name(faultKind kind);
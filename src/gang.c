@@ -0,0 +1,272 @@
+#include "gang.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvml.h"
+#include "utils.h"
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// PCI bus id of each GPU
+static char busIds[GANG_GPUS_MAX][sizeof(((nvmlPciInfo_t *) NULL)->busId)];
+
+// PCI bus id of the device at the other end of each active NVLink of each GPU, empty if the link is down
+static char remoteBusIds[GANG_GPUS_MAX][NVML_NVLINK_MAX_LINKS][sizeof(((nvmlPciInfo_t *) NULL)->busId)];
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static unsigned int find_leader(unsigned int * leaders, unsigned int i) {
+  // Follow the leaders up to the first GPU of the gang
+  while (leaders[i] != i) {
+    i = leaders[i];
+  }
+
+  // Return the first GPU of the gang
+  return i;
+}
+
+static void join(unsigned int * leaders, unsigned int a, unsigned int b) {
+  // Get the gangs of both GPUs
+  a = find_leader(leaders, a);
+  b = find_leader(leaders, b);
+
+  // The first GPU leads the merged gang
+  if (a < b) {
+    leaders[b] = a;
+  } else {
+    leaders[a] = b;
+  }
+}
+
+static bool parse_gangs(const char * value, const bool * managed, unsigned int count, unsigned int * leaders) {
+  // Duplicate the value, as it is split in place
+  char * string = strdup(value);
+
+  // Check if string duplication failed
+  if (string == NULL) {
+    fprintf(stderr, "Unable to allocate memory for the gangs\n");
+    return false;
+  }
+
+  // Split the value into gangs, "<id>+<id>[+<id>...]" each
+  char * tokens[GANG_GPUS_MAX];
+  size_t tokenCount = 0;
+
+  for (char * token = strtok(string, ","); token != NULL; token = strtok(NULL, ",")) {
+    // A GPU is in at most one gang
+    if (tokenCount == GANG_GPUS_MAX) {
+      fprintf(stderr, "Too many gangs: %s\n", value);
+      goto failure;
+    }
+
+    tokens[tokenCount++] = token;
+  }
+
+  // Flags indicating which GPUs are already in a gang
+  bool assigned[GANG_GPUS_MAX] = { false };
+
+  // Parse each gang
+  for (size_t i = 0; i < tokenCount; i++) {
+    // Ids of the GPUs of the gang
+    unsigned long ids[GANG_GPUS_MAX];
+    size_t idsCount;
+
+    // A gang has at least two GPUs
+    if (!parse_ulong_array(tokens[i], "+", GANG_GPUS_MAX, ids, &idsCount) || idsCount < 2) {
+      fprintf(stderr, "Invalid gang: %s, expected <id>+<id>[+<id>...]\n", tokens[i]);
+      goto failure;
+    }
+
+    // Check and join each GPU
+    for (size_t j = 0; j < idsCount; j++) {
+      // Validate the id
+      if (ids[j] >= count) {
+        fprintf(stderr, "Invalid GPU id in a gang: %lu\n", ids[j]);
+        goto failure;
+      }
+
+      // Only managed GPUs switch together
+      if (!managed[ids[j]]) {
+        fprintf(stderr, "GPU %lu of a gang is not managed\n", ids[j]);
+        goto failure;
+      }
+
+      // A GPU can't follow two gangs
+      if (assigned[ids[j]]) {
+        fprintf(stderr, "GPU %lu is in more than one gang\n", ids[j]);
+        goto failure;
+      }
+
+      // Join the gang
+      assigned[ids[j]] = true;
+      join(leaders, ids[0], ids[j]);
+    }
+  }
+
+  // Free the duplicated string
+  SAFE_FREE(string);
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Free the duplicated string
+  SAFE_FREE(string);
+
+  // Return false to indicate failure
+  return false;
+}
+
+static bool read_links(const nvmlDevice_t * devices, unsigned int i) {
+  // Variable to hold the PCI information
+  nvmlPciInfo_t pci;
+
+  // Get the PCI location of the GPU
+  NVML_CALL(nvmlDeviceGetPciInfo(devices[i], &pci), failure);
+  strcpy(busIds[i], pci.busId);
+
+  // Start with every link down
+  memset(remoteBusIds[i], 0, sizeof(remoteBusIds[i]));
+
+  // Get the other end of each active NVLink
+  for (unsigned int link = 0; link < NVML_NVLINK_MAX_LINKS; link++) {
+    // Variable to hold the state of the link
+    nvmlEnableState_t active;
+
+    // GPUs without NVLink, or with fewer links, report an error
+    if (nvmlDeviceGetNvLinkState(devices[i], link, &active) != NVML_SUCCESS) {
+      break;
+    }
+
+    // Store the other end of an active link
+    if (active == NVML_FEATURE_ENABLED && nvmlDeviceGetNvLinkRemotePciInfo(devices[i], link, &pci) == NVML_SUCCESS) {
+      strcpy(remoteBusIds[i][link], pci.busId);
+    }
+  }
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
+
+static bool nvlinked(unsigned int i, unsigned int j) {
+  // Compare the links of both GPUs
+  for (unsigned int a = 0; a < NVML_NVLINK_MAX_LINKS; a++) {
+    // A link of the first GPU to the second one, in either direction
+    if ((remoteBusIds[i][a][0] != '\0' && strcmp(remoteBusIds[i][a], busIds[j]) == 0) || (remoteBusIds[j][a][0] != '\0' && strcmp(remoteBusIds[j][a], busIds[i]) == 0)) {
+      return true;
+    }
+
+    // Links to the same NVSwitch
+    for (unsigned int b = 0; remoteBusIds[i][a][0] != '\0' && b < NVML_NVLINK_MAX_LINKS; b++) {
+      if (strcmp(remoteBusIds[i][a], remoteBusIds[j][b]) == 0) {
+        return true;
+      }
+    }
+  }
+
+  // Return false if the GPUs are not connected by NVLink
+  return false;
+}
+
+static bool detect_gangs(const nvmlDevice_t * devices, const bool * managed, unsigned int count, unsigned int * leaders) {
+  // Read the links of each managed GPU
+  for (unsigned int i = 0; i < count; i++) {
+    if (managed[i]) {
+      ASSERT_TRUE(read_links(devices, i), failure);
+    }
+  }
+
+  // Compare each pair of managed GPUs
+  for (unsigned int i = 0; i < count; i++) {
+    for (unsigned int j = i + 1; managed[i] && j < count; j++) {
+      // Skip unmanaged GPUs
+      if (!managed[j]) {
+        continue;
+      }
+
+      // Variable to hold the closest common ancestor, which is only reported on Linux
+      nvmlGpuTopologyLevel_t level;
+
+      // GPUs connected by NVLink or behind the same PCIe switches run tensor parallel work together
+      if (nvlinked(i, j) || (nvmlDeviceGetTopologyCommonAncestor(devices[i], devices[j], &level) == NVML_SUCCESS && level <= NVML_TOPOLOGY_MULTIPLE)) {
+        join(leaders, i, j);
+      }
+    }
+  }
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+bool gang_assign(const char * value, const nvmlDevice_t * devices, const bool * managed, unsigned int count, unsigned int * leaders) {
+  // Each GPU starts alone
+  for (unsigned int i = 0; i < count; i++) {
+    leaders[i] = i;
+  }
+
+  // Without gangs, each GPU switches alone
+  if (value == NULL) {
+    return true;
+  }
+
+  // Group the GPUs as given, or by their links
+  if (strcmp(value, GANG_AUTO) == 0) {
+    ASSERT_TRUE(detect_gangs(devices, managed, count, leaders), failure);
+  } else {
+    ASSERT_TRUE(parse_gangs(value, managed, count, leaders), failure);
+  }
+
+  // Point each GPU straight to the first GPU of its gang
+  for (unsigned int i = 0; i < count; i++) {
+    leaders[i] = find_leader(leaders, i);
+  }
+
+  // Number of gangs
+  unsigned int gangs = 0;
+
+  // Print each gang
+  for (unsigned int i = 0; i < count; i++) {
+    // Buffer to hold the GPUs of the gang
+    char members[GANG_GPUS_MAX * 4] = "";
+    size_t length = 0;
+    unsigned int size = 0;
+
+    // List the GPUs led by this one
+    for (unsigned int j = i; j < count; j++) {
+      if (leaders[j] == i) {
+        length += snprintf(members + length, sizeof(members) - length, size == 0 ? "%u" : "+%u", j);
+        size++;
+      }
+    }
+
+    // Print gangs of more than one GPU
+    if (size > 1) {
+      printf("GPUs %s switch performance state together\n", members);
+      gangs++;
+    }
+  }
+
+  // Print message indicating no GPUs are linked
+  if (gangs == 0) {
+    printf("No linked GPUs found, each GPU switches alone\n");
+  }
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
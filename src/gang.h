@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include <nvml.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs (matches NVAPI_MAX_PHYSICAL_GPUS)
+#define GANG_GPUS_MAX 64
+
+// Value of --gangs grouping the GPUs by their links
+#define GANG_AUTO "auto"
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool gang_assign(const char * value, const nvmlDevice_t * devices, const bool * managed, unsigned int count, unsigned int * leaders);
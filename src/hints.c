@@ -0,0 +1,500 @@
+#ifdef __linux__
+  // Required for accept4()
+  #define _GNU_SOURCE
+#endif
+
+#include "hints.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+  #include <fcntl.h>
+  #include <sys/epoll.h>
+  #include <sys/socket.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+
+#include "utils.h"
+
+#ifdef __linux__
+  /***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+  // Structure to hold the state of a connected client
+  typedef struct hintsClient {
+    // Socket of the client
+    int fd;
+
+    // Buffer holding the incomplete request line
+    char buffer[HINTS_LINE_MAX];
+
+    // Number of bytes in the buffer
+    size_t length;
+
+    // Lease expiration of each GPU (CLOCK_MONOTONIC, in nanoseconds), zero if not held
+    unsigned long long until[HINTS_GPUS_MAX];
+
+    // Previous and next clients in the list
+    struct hintsClient * prev;
+    struct hintsClient * next;
+  } hintsClient;
+
+  /***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+  // Path of the listening socket
+  static char * socketPath = NULL;
+
+  // Listening socket
+  static int listenFd = -1;
+
+  // Epoll instance watching the listening socket and the clients
+  static int epollFd = -1;
+
+  // List of connected clients
+  static hintsClient * clients = NULL;
+
+  // Number of connected clients
+  static unsigned int clientCount = 0;
+
+  // Latest lease expiration of each GPU over all clients (CLOCK_MONOTONIC, in nanoseconds)
+  static unsigned long long leases[HINTS_GPUS_MAX];
+
+  /***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+  static void update_leases(void) {
+    // Recompute the latest expiration of each GPU
+    for (unsigned int i = 0; i < HINTS_GPUS_MAX; i++) {
+      // Latest expiration over all clients
+      unsigned long long until = 0;
+
+      // Loop through the clients
+      for (hintsClient * client = clients; client != NULL; client = client->next) {
+        if (client->until[i] > until) {
+          until = client->until[i];
+        }
+      }
+
+      // Publish the expiration, workers read it without locking
+      ATOMIC_STORE(&leases[i], until);
+    }
+  }
+
+  static void close_client(hintsClient * client) {
+    // Unlink the client from the list
+    if (client->prev != NULL) {
+      client->prev->next = client->next;
+    } else {
+      clients = client->next;
+    }
+
+    if (client->next != NULL) {
+      client->next->prev = client->prev;
+    }
+
+    // Close the socket, which also removes it from the epoll instance
+    close(client->fd);
+
+    // Free the client
+    free(client);
+
+    // Decrement the number of clients
+    clientCount--;
+
+    // Leases of the client end with its connection
+    update_leases();
+  }
+
+  static bool reply(hintsClient * client, const char * message) {
+    // Get the length of the message
+    size_t length = strlen(message);
+
+    // Replies are small, a client that doesn't read them is dropped
+    return send(client->fd, message, length, MSG_NOSIGNAL | MSG_DONTWAIT) == (ssize_t) length;
+  }
+
+  static bool parse_gpus(char * list, bool * gpus) {
+    // Clear the set
+    memset(gpus, 0, sizeof(bool) * HINTS_GPUS_MAX);
+
+    // The wildcard selects all GPUs
+    if (strcmp(list, "*") == 0) {
+      for (unsigned int i = 0; i < HINTS_GPUS_MAX; i++) {
+        gpus[i] = true;
+      }
+
+      return true;
+    }
+
+    // Array to hold the parsed ids
+    unsigned long ids[HINTS_GPUS_MAX];
+
+    // Number of parsed ids
+    size_t count;
+
+    // Parse the comma separated ids
+    if (!parse_ulong_array(list, ",", HINTS_GPUS_MAX, ids, &count) || count == 0) {
+      return false;
+    }
+
+    // Add the ids to the set
+    for (size_t i = 0; i < count; i++) {
+      // Validate the id
+      if (ids[i] >= HINTS_GPUS_MAX) {
+        return false;
+      }
+
+      // Add the id
+      gpus[ids[i]] = true;
+    }
+
+    // Return true to indicate success
+    return true;
+  }
+
+  static bool handle_request(hintsClient * client, char * line) {
+    // Split the line into words
+    char * saveptr;
+    char * command = strtok_r(line, " \t\r", &saveptr);
+    char * list = strtok_r(NULL, " \t\r", &saveptr);
+    char * duration = strtok_r(NULL, " \t\r", &saveptr);
+    char * extra = strtok_r(NULL, " \t\r", &saveptr);
+
+    // Set of GPUs the request refers to
+    bool gpus[HINTS_GPUS_MAX];
+
+    // Ignore empty lines
+    if (command == NULL) {
+      return true;
+    }
+
+    // "HOLD <ids|*> <ms>" holds the GPUs at high performance state for the duration
+    if (strcmp(command, "HOLD") == 0 && list != NULL && duration != NULL && extra == NULL) {
+      // Variable to hold the duration
+      unsigned long milliseconds;
+
+      // Parse the arguments
+      if (!parse_gpus(list, gpus) || !parse_ulong(duration, &milliseconds)) {
+        return reply(client, "ERR invalid arguments\n");
+      }
+
+      // Compute the expiration
+      unsigned long long until = get_time_ns() + (unsigned long long) milliseconds * 1000000ULL;
+
+      // Replace the leases of the client on the GPUs
+      for (unsigned int i = 0; i < HINTS_GPUS_MAX; i++) {
+        if (gpus[i]) {
+          client->until[i] = until;
+        }
+      }
+
+      // Publish the leases
+      update_leases();
+
+      // Acknowledge the request
+      return reply(client, "OK\n");
+    }
+
+    // "RELEASE <ids|*>" ends the leases of the client on the GPUs
+    if (strcmp(command, "RELEASE") == 0 && list != NULL && duration == NULL) {
+      // Parse the arguments
+      if (!parse_gpus(list, gpus)) {
+        return reply(client, "ERR invalid arguments\n");
+      }
+
+      // End the leases of the client on the GPUs
+      for (unsigned int i = 0; i < HINTS_GPUS_MAX; i++) {
+        if (gpus[i]) {
+          client->until[i] = 0;
+        }
+      }
+
+      // Publish the leases
+      update_leases();
+
+      // Acknowledge the request
+      return reply(client, "OK\n");
+    }
+
+    // Reject unknown requests
+    return reply(client, "ERR unknown request\n");
+  }
+
+  static bool read_client(hintsClient * client) {
+    // Read everything available
+    while (true) {
+      // Read into the free part of the buffer
+      ssize_t received = recv(client->fd, client->buffer + client->length, sizeof(client->buffer) - client->length, MSG_DONTWAIT);
+
+      // If the client disconnected
+      if (received == 0) {
+        return false;
+      }
+
+      // If the read failed
+      if (received == -1) {
+        // No more data for now
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return true;
+        }
+
+        // Retry if interrupted by a signal
+        if (errno == EINTR) {
+          continue;
+        }
+
+        // Drop the client on any other error
+        return false;
+      }
+
+      // Account for the received bytes
+      client->length += received;
+
+      // Start of the current line
+      char * start = client->buffer;
+
+      // Process all complete lines
+      char * end;
+
+      while ((end = memchr(start, '\n', client->length - (start - client->buffer))) != NULL) {
+        // Terminate the line
+        *end = '\0';
+
+        // Handle the request
+        if (!handle_request(client, start)) {
+          return false;
+        }
+
+        // Move to the next line
+        start = end + 1;
+      }
+
+      // Move the incomplete line to the beginning of the buffer
+      client->length -= start - client->buffer;
+      memmove(client->buffer, start, client->length);
+
+      // Drop clients sending overlong lines
+      if (client->length == sizeof(client->buffer)) {
+        reply(client, "ERR line too long\n");
+        return false;
+      }
+    }
+  }
+
+  static void accept_clients(void) {
+    // Accept all pending connections
+    while (true) {
+      // Accept the connection
+      int fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+      // Stop if there are no more pending connections
+      if (fd == -1) {
+        return;
+      }
+
+      // Refuse the connection if there are too many clients
+      if (clientCount >= HINTS_CLIENTS_MAX) {
+        close(fd);
+        continue;
+      }
+
+      // Allocate the client
+      hintsClient * client = calloc(1, sizeof(hintsClient));
+
+      // Check if the allocation failed
+      if (client == NULL) {
+        close(fd);
+        continue;
+      }
+
+      // Store the socket
+      client->fd = fd;
+
+      // Watch the client for incoming data
+      struct epoll_event event = { .events = EPOLLIN, .data.ptr = client };
+
+      if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+        close(fd);
+        free(client);
+        continue;
+      }
+
+      // Link the client into the list
+      client->next = clients;
+
+      if (clients != NULL) {
+        clients->prev = client;
+      }
+
+      clients = client;
+
+      // Increment the number of clients
+      clientCount++;
+    }
+  }
+
+  /***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+  bool hints_init(const char * path) {
+    // Socket address
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+
+    // Validate the path length
+    if (strlen(path) >= sizeof(address.sun_path)) {
+      fprintf(stderr, "Hint socket path is too long: %s\n", path);
+      return false;
+    }
+
+    // Copy the path
+    strcpy(address.sun_path, path);
+
+    // Create the listening socket
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    // Check if the socket was created
+    if (listenFd == -1) {
+      fprintf(stderr, "socket(): %s\n", strerror(errno));
+      return false;
+    }
+
+    // Remove a stale socket left by a previous instance
+    unlink(path);
+
+    // Bind and listen
+    if (bind(listenFd, (struct sockaddr *) &address, sizeof(address)) == -1 || listen(listenFd, SOMAXCONN) == -1) {
+      fprintf(stderr, "Unable to listen on %s: %s\n", path, strerror(errno));
+      hints_deinit();
+      return false;
+    }
+
+    // Remember the path to remove the socket on exit
+    socketPath = strdup(path);
+
+    // Create the epoll instance
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    // Check if the epoll instance was created
+    if (epollFd == -1) {
+      fprintf(stderr, "epoll_create1(): %s\n", strerror(errno));
+      hints_deinit();
+      return false;
+    }
+
+    // Watch the listening socket for connections
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = NULL };
+
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == -1) {
+      fprintf(stderr, "epoll_ctl(): %s\n", strerror(errno));
+      hints_deinit();
+      return false;
+    }
+
+    // Return true to indicate success
+    return true;
+  }
+
+  void hints_deinit(void) {
+    // Disconnect all clients
+    while (clients != NULL) {
+      close_client(clients);
+    }
+
+    // Close the epoll instance
+    if (epollFd != -1) {
+      close(epollFd);
+      epollFd = -1;
+    }
+
+    // Close the listening socket
+    if (listenFd != -1) {
+      close(listenFd);
+      listenFd = -1;
+    }
+
+    // Remove the socket file
+    if (socketPath != NULL) {
+      unlink(socketPath);
+      SAFE_FREE(socketPath);
+    }
+  }
+
+  int hints_fd(void) {
+    return epollFd;
+  }
+
+  bool hints_process(void) {
+    // Buffer to hold the ready events
+    struct epoll_event events[64];
+
+    // Handle ready events until none are left
+    while (true) {
+      // Poll without blocking
+      int count = epoll_wait(epollFd, events, 64, 0);
+
+      // Check if the poll failed
+      if (count == -1) {
+        // Retry if interrupted by a signal
+        if (errno == EINTR) {
+          continue;
+        }
+
+        fprintf(stderr, "epoll_wait(): %s\n", strerror(errno));
+        return false;
+      }
+
+      // Stop when there are no more events
+      if (count == 0) {
+        return true;
+      }
+
+      // Loop through the events
+      for (int i = 0; i < count; i++) {
+        // Get the client, NULL for the listening socket
+        hintsClient * client = events[i].data.ptr;
+
+        // Accept new connections
+        if (client == NULL) {
+          accept_clients();
+          continue;
+        }
+
+        // Read the requests, drop the client on disconnect or error
+        if (!read_client(client)) {
+          close_client(client);
+        }
+      }
+    }
+  }
+
+  bool hints_held(unsigned int gpu, unsigned long long now) {
+    // Check if the GPU has an unexpired lease
+    return gpu < HINTS_GPUS_MAX && ATOMIC_LOAD(&leases[gpu]) > now;
+  }
+#else
+  /***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+  bool hints_init(const char * path) {
+    // Print an error message
+    fprintf(stderr, "Hint socket is not supported on this platform\n");
+
+    // Return false to indicate failure
+    return false;
+  }
+
+  void hints_deinit(void) {
+  }
+
+  int hints_fd(void) {
+    return -1;
+  }
+
+  bool hints_process(void) {
+    return true;
+  }
+
+  bool hints_held(unsigned int gpu, unsigned long long now) {
+    return false;
+  }
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs a lease can refer to (matches NVAPI_MAX_PHYSICAL_GPUS)
+#define HINTS_GPUS_MAX 64
+
+// Maximum number of connected clients
+#define HINTS_CLIENTS_MAX 1024
+
+// Maximum length of a request line
+#define HINTS_LINE_MAX 512
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool hints_init(const char * path);
+void hints_deinit(void);
+int hints_fd(void);
+bool hints_process(void);
+bool hints_held(unsigned int gpu, unsigned long long now);
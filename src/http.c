@@ -0,0 +1,640 @@
+#include "http.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+  #include <netdb.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <poll.h>
+  #include <strings.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+#endif
+
+#include "utils.h"
+
+#ifdef __linux__
+  /***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+  // Result of a read at the end of the connection
+  #define HTTP_EOF -3
+
+  /***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+  // Structure to hold the parts of a URL
+  typedef struct {
+    // Host name or address, without the brackets of an IPv6 address
+    char host[HTTP_HOST_MAX];
+
+    // Host and port as written in the URL, for the Host header
+    char authority[HTTP_HOST_MAX + 8];
+
+    // Port
+    char port[8];
+
+    // Path and query
+    char path[HTTP_PATH_MAX];
+  } httpUrl;
+
+  // Structure to hold a buffered reader of the response
+  typedef struct {
+    // Socket
+    int fd;
+
+    // Time allowed between two reads (in milliseconds)
+    unsigned long timeout;
+
+    // Received bytes not consumed yet
+    char buffer[1024];
+    size_t start;
+    size_t end;
+
+    // Flag indicating whether any byte of the response was received
+    bool received;
+  } httpReader;
+
+  /***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+  // Kept-alive connection, -1 if none
+  static int connection = -1;
+
+  // Host and port of the kept-alive connection
+  static char connectionHost[HTTP_HOST_MAX];
+  static char connectionPort[8];
+
+  /***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+  static bool parse_url(const char * url, httpUrl * parsed) {
+    // Only plain HTTP is supported
+    if (strncmp(url, "http://", 7) != 0) {
+      return false;
+    }
+
+    // The authority ends at the path
+    const char * authority = url + 7;
+    const char * path = strchr(authority, '/');
+    size_t authorityLength = path != NULL ? (size_t) (path - authority) : strlen(authority);
+
+    // Host name and the character after it
+    const char * host = authority;
+    size_t hostLength;
+    const char * rest;
+
+    // If the host is an IPv6 address
+    if (*authority == '[') {
+      // Find the end of the address
+      const char * end = memchr(authority, ']', authorityLength);
+
+      if (end == NULL) {
+        return false;
+      }
+
+      host = authority + 1;
+      hostLength = end - host;
+      rest = end + 1;
+    } else {
+      // The host ends at the port or the path
+      const char * colon = memchr(authority, ':', authorityLength);
+
+      hostLength = colon != NULL ? (size_t) (colon - authority) : authorityLength;
+      rest = authority + hostLength;
+    }
+
+    // Validate the lengths
+    if (hostLength == 0 || hostLength >= sizeof(parsed->host) || authorityLength >= sizeof(parsed->authority)) {
+      return false;
+    }
+
+    // Copy the host and the authority
+    memcpy(parsed->host, host, hostLength);
+    parsed->host[hostLength] = '\0';
+    memcpy(parsed->authority, authority, authorityLength);
+    parsed->authority[authorityLength] = '\0';
+
+    // If a port is given
+    if (rest < authority + authorityLength) {
+      // Variable to hold the port
+      unsigned long port;
+
+      // Parse the port
+      char text[8];
+      size_t length = authority + authorityLength - rest - 1;
+
+      if (*rest != ':' || length == 0 || length >= sizeof(text)) {
+        return false;
+      }
+
+      memcpy(text, rest + 1, length);
+      text[length] = '\0';
+
+      if (!parse_ulong(text, &port) || port == 0 || port > 65535) {
+        return false;
+      }
+
+      snprintf(parsed->port, sizeof(parsed->port), "%lu", port);
+    } else {
+      // Use the default port
+      strcpy(parsed->port, "80");
+    }
+
+    // Copy the path, the root if none is given
+    if (path == NULL) {
+      strcpy(parsed->path, "/");
+    } else if (strlen(path) < sizeof(parsed->path)) {
+      strcpy(parsed->path, path);
+    } else {
+      return false;
+    }
+
+    // Return true to indicate success
+    return true;
+  }
+
+  static int wait_fd(int fd, short events, unsigned long timeout) {
+    // Deadline of the wait
+    unsigned long long deadline = get_time_ns() + (unsigned long long) timeout * 1000000ULL;
+
+    while (true) {
+      // Time left until the deadline
+      unsigned long long now = get_time_ns();
+      int left = now < deadline ? (int) ((deadline - now + 999999ULL) / 1000000ULL) : 0;
+
+      // Wait for the socket
+      struct pollfd pfd = { fd, events, 0 };
+      int ret = poll(&pfd, 1, left);
+
+      // Retry if interrupted by a signal
+      if (ret == -1 && errno == EINTR) {
+        continue;
+      }
+
+      // Return 1 if ready, 0 on timeout and -1 on error
+      return ret;
+    }
+  }
+
+  static int open_connection(const httpUrl * url, unsigned long timeout) {
+    // Resolve the host, a name lookup is not covered by the timeout
+    struct addrinfo hints = { 0 };
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo * addresses;
+    int ret = getaddrinfo(url->host, url->port, &hints, &addresses);
+
+    // Check if the host was resolved
+    if (ret != 0) {
+      fprintf(stderr, "getaddrinfo(%s): %s\n", url->host, gai_strerror(ret));
+      return HTTP_FAILED;
+    }
+
+    // Result of the last attempt
+    int result = HTTP_FAILED;
+
+    // Try each address in turn
+    for (struct addrinfo * address = addresses; address != NULL; address = address->ai_next) {
+      // Create a non-blocking socket, so the connection and the reads can time out
+      int fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, address->ai_protocol);
+
+      if (fd == -1) {
+        continue;
+      }
+
+      // Start connecting
+      if (connect(fd, address->ai_addr, address->ai_addrlen) == -1) {
+        // Connecting synchronously failed
+        if (errno != EINPROGRESS) {
+          close(fd);
+          continue;
+        }
+
+        // Wait for the connection
+        ret = wait_fd(fd, POLLOUT, timeout);
+
+        // Variable to hold the connection error
+        int error = 0;
+        socklen_t length = sizeof(error);
+
+        // Check if the connection was established
+        if (ret != 1 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error != 0) {
+          result = ret == 0 ? HTTP_TIMED_OUT : HTTP_FAILED;
+          close(fd);
+          continue;
+        }
+      }
+
+      // Send the request without waiting for more data
+      int enable = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+      // Return the connected socket
+      freeaddrinfo(addresses);
+      return fd;
+    }
+
+    // Free the addresses
+    freeaddrinfo(addresses);
+
+    // Return the result of the last attempt
+    return result;
+  }
+
+  static int send_all(int fd, const char * data, size_t length, unsigned long timeout) {
+    // Send until everything is written
+    while (length > 0) {
+      // Send what fits into the socket buffer
+      ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+
+      // If the socket buffer is full
+      if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        // Wait for room in the buffer
+        int ret = wait_fd(fd, POLLOUT, timeout);
+
+        if (ret != 1) {
+          return ret == 0 ? HTTP_TIMED_OUT : HTTP_FAILED;
+        }
+
+        continue;
+      }
+
+      // Retry if interrupted by a signal
+      if (sent == -1 && errno == EINTR) {
+        continue;
+      }
+
+      // Check if the data was sent
+      if (sent == -1) {
+        return HTTP_FAILED;
+      }
+
+      // Advance past the sent data
+      data += sent;
+      length -= sent;
+    }
+
+    // Return 0 to indicate success
+    return 0;
+  }
+
+  static int read_byte(httpReader * reader) {
+    // If the buffer is empty
+    while (reader->start == reader->end) {
+      // Receive more data
+      ssize_t received = recv(reader->fd, reader->buffer, sizeof(reader->buffer), 0);
+
+      // If nothing is available yet
+      if (received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        // Wait for the data
+        int ret = wait_fd(reader->fd, POLLIN, reader->timeout);
+
+        if (ret != 1) {
+          return ret == 0 ? HTTP_TIMED_OUT : HTTP_FAILED;
+        }
+
+        continue;
+      }
+
+      // Retry if interrupted by a signal
+      if (received == -1 && errno == EINTR) {
+        continue;
+      }
+
+      // Check if the data was received
+      if (received == -1) {
+        return HTTP_FAILED;
+      }
+
+      // Check if the server closed the connection
+      if (received == 0) {
+        return HTTP_EOF;
+      }
+
+      // Fill the buffer
+      reader->start = 0;
+      reader->end = received;
+      reader->received = true;
+    }
+
+    // Return the next byte
+    return (unsigned char) reader->buffer[reader->start++];
+  }
+
+  static int read_line(httpReader * reader, char * line, size_t size) {
+    // Length of the line
+    size_t length = 0;
+
+    // Read until the end of the line
+    while (true) {
+      // Read the next byte
+      int c = read_byte(reader);
+
+      // Check if the byte was read
+      if (c < 0) {
+        return c == HTTP_EOF ? HTTP_FAILED : c;
+      }
+
+      // Stop at the end of the line
+      if (c == '\n') {
+        break;
+      }
+
+      // Reject lines that don't fit
+      if (length + 1 >= size) {
+        return HTTP_FAILED;
+      }
+
+      // Store the byte
+      line[length++] = (char) c;
+    }
+
+    // Strip the carriage return
+    if (length > 0 && line[length - 1] == '\r') {
+      length--;
+    }
+
+    // Terminate the line
+    line[length] = '\0';
+
+    // Return 0 to indicate success
+    return 0;
+  }
+
+  static int discard(httpReader * reader, unsigned long long count) {
+    // Skip the bytes
+    for (unsigned long long i = 0; i < count; i++) {
+      int c = read_byte(reader);
+
+      if (c < 0) {
+        return c == HTTP_EOF ? HTTP_FAILED : c;
+      }
+    }
+
+    // Return 0 to indicate success
+    return 0;
+  }
+
+  static int read_body(httpReader * reader, bool chunked, bool sized, unsigned long long length) {
+    // If the body has a known length
+    if (sized) {
+      return discard(reader, length);
+    }
+
+    // If the body is not chunked, it ends with the connection
+    if (!chunked) {
+      while (true) {
+        int c = read_byte(reader);
+
+        if (c < 0) {
+          return c == HTTP_EOF ? 0 : c;
+        }
+      }
+    }
+
+    // Buffer holding a chunk size or trailer line
+    char line[256];
+
+    // Read the chunks
+    while (true) {
+      // Read the size of the chunk
+      int ret = read_line(reader, line, sizeof(line));
+
+      if (ret != 0) {
+        return ret;
+      }
+
+      // Parse the hexadecimal size, ignoring the extensions
+      char * end;
+      unsigned long long size = strtoull(line, &end, 16);
+
+      if (end == line) {
+        return HTTP_FAILED;
+      }
+
+      // The last chunk is followed by the trailers
+      if (size == 0) {
+        break;
+      }
+
+      // Skip the chunk and the line break after it
+      if ((ret = discard(reader, size + 2)) != 0) {
+        return ret;
+      }
+    }
+
+    // Skip the trailers up to the empty line
+    do {
+      int ret = read_line(reader, line, sizeof(line));
+
+      if (ret != 0) {
+        return ret;
+      }
+    } while (line[0] != '\0');
+
+    // Return 0 to indicate success
+    return 0;
+  }
+
+  static int request(const httpUrl * url, const httpOptions * options, bool * received) {
+    // Open a connection if none is kept alive
+    if (connection == -1) {
+      // Connect to the host
+      int fd = open_connection(url, options->connectTimeout);
+
+      if (fd < 0) {
+        return fd;
+      }
+
+      // Remember the connection
+      connection = fd;
+      strcpy(connectionHost, url->host);
+      strcpy(connectionPort, url->port);
+    }
+
+    // Build the request
+    char buffer[HTTP_PATH_MAX + HTTP_HOST_MAX + 128];
+    int length = snprintf(buffer, sizeof(buffer), "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: nvidia-pstated\r\nConnection: keep-alive\r\n\r\n", url->path, url->authority);
+
+    // Reader of the response
+    httpReader reader = { connection, options->readTimeout, { 0 }, 0, 0, false };
+
+    // Status of the response
+    int status = HTTP_FAILED;
+
+    // Send the request
+    int ret = send_all(connection, buffer, length, options->readTimeout);
+
+    if (ret != 0) {
+      goto failure;
+    }
+
+    // Read the status line
+    if ((ret = read_line(&reader, buffer, sizeof(buffer))) != 0) {
+      goto failure;
+    }
+
+    // Parse the status
+    if (sscanf(buffer, "HTTP/%*d.%*d %d", &status) != 1) {
+      ret = HTTP_FAILED;
+      goto failure;
+    }
+
+    // Properties of the body
+    bool chunked = false;
+    bool sized = false;
+    bool keepAlive = strncmp(buffer, "HTTP/1.0", 8) != 0;
+    unsigned long long bodyLength = 0;
+
+    // Read the headers up to the empty line
+    for (size_t total = 0; ; ) {
+      // Read the header
+      if ((ret = read_line(&reader, buffer, sizeof(buffer))) != 0) {
+        goto failure;
+      }
+
+      // Stop at the end of the headers
+      if (buffer[0] == '\0') {
+        break;
+      }
+
+      // Limit the size of the headers
+      total += strlen(buffer);
+
+      if (total > HTTP_HEADERS_MAX) {
+        ret = HTTP_FAILED;
+        goto failure;
+      }
+
+      // Look at the headers describing the body and the connection
+      if (strncasecmp(buffer, "Content-Length:", 15) == 0) {
+        sized = true;
+        bodyLength = strtoull(buffer + 15, NULL, 10);
+      } else if (strncasecmp(buffer, "Transfer-Encoding:", 18) == 0 && strstr(buffer + 18, "chunked") != NULL) {
+        chunked = true;
+      } else if (strncasecmp(buffer, "Connection:", 11) == 0) {
+        keepAlive = strstr(buffer + 11, "close") == NULL && strstr(buffer + 11, "Close") == NULL;
+      }
+    }
+
+    // Responses without a body
+    if (status == 204 || status == 304 || (status >= 100 && status < 200)) {
+      sized = true;
+      bodyLength = 0;
+    }
+
+    // Read the body, so the connection can carry the next request
+    if ((ret = read_body(&reader, chunked && !sized, sized, bodyLength)) != 0) {
+      goto failure;
+    }
+
+    // A body ending with the connection, or an explicit close, ends the keep-alive
+    if (!keepAlive || (!sized && !chunked)) {
+      http_close();
+    }
+
+    // Return the status
+    return status;
+
+    failure:
+    // Report whether the server answered at all, a closed kept-alive connection fails before that
+    *received = reader.received;
+
+    // The connection is in an unknown state
+    http_close();
+
+    // Return the error
+    return ret;
+  }
+
+  /***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+  bool http_check_url(const char * url) {
+    // Variable to hold the parsed URL
+    httpUrl parsed;
+
+    // Check if the URL can be requested
+    if (!parse_url(url, &parsed)) {
+      fprintf(stderr, "Invalid URL: %s, expected http://<host>[:<port>][/<path>]\n", url);
+      return false;
+    }
+
+    // Return true to indicate success
+    return true;
+  }
+
+  int http_get(const char * url, const httpOptions * options) {
+    // Variable to hold the parsed URL
+    httpUrl parsed;
+
+    // Parse the URL
+    if (!parse_url(url, &parsed)) {
+      return HTTP_FAILED;
+    }
+
+    // The kept-alive connection is only reused for the same host
+    if (connection != -1 && (strcmp(connectionHost, parsed.host) != 0 || strcmp(connectionPort, parsed.port) != 0)) {
+      http_close();
+    }
+
+    // Status of the last attempt
+    int status = HTTP_FAILED;
+
+    // Make the request, retrying failed attempts
+    for (unsigned long attempt = 0; attempt <= options->retries; attempt++) {
+      // Back off before each retry
+      if (attempt > 0) {
+        poll(NULL, 0, (int) (HTTP_BACKOFF << (attempt - 1 < 10 ? attempt - 1 : 10)));
+      }
+
+      // Flag indicating whether the request was made on a kept-alive connection
+      bool reused = connection != -1;
+
+      // Flag indicating whether the server answered
+      bool received = false;
+
+      // Make the request
+      status = request(&parsed, options, &received);
+
+      // The server may have closed the idle connection, retry on a new one right away
+      if (status < 0 && reused && !received) {
+        status = request(&parsed, options, &received);
+      }
+
+      // Only network errors and server errors are worth retrying
+      if (status >= 0 && status < 500) {
+        break;
+      }
+    }
+
+    // Return the status of the last attempt
+    return status;
+  }
+
+  void http_close(void) {
+    // Close the kept-alive connection
+    if (connection != -1) {
+      close(connection);
+      connection = -1;
+    }
+  }
+#else
+  /***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+  bool http_check_url(const char * url) {
+    // Print an error message
+    fprintf(stderr, "Fan URLs are not supported on this platform\n");
+
+    // Return false to indicate failure
+    return false;
+  }
+
+  int http_get(const char * url, const httpOptions * options) {
+    return HTTP_FAILED;
+  }
+
+  void http_close(void) {
+  }
+#endif
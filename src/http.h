@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum length of a host name
+#define HTTP_HOST_MAX 256
+
+// Maximum length of a request path
+#define HTTP_PATH_MAX 1024
+
+// Maximum size of the response headers
+#define HTTP_HEADERS_MAX 8192
+
+// Delay before the first retry, doubled for each further one (in milliseconds)
+#define HTTP_BACKOFF 100
+
+// Status reported when no response was received in time
+#define HTTP_TIMED_OUT -1
+
+// Status reported when the request failed for any other reason
+#define HTTP_FAILED -2
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold how a request is made
+typedef struct {
+  // Time allowed to establish the connection (in milliseconds)
+  unsigned long connectTimeout;
+
+  // Time allowed between two reads of the response (in milliseconds)
+  unsigned long readTimeout;
+
+  // Number of retries after a failed attempt
+  unsigned long retries;
+} httpOptions;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool http_check_url(const char * url);
+int http_get(const char * url, const httpOptions * options);
+void http_close(void);
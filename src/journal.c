@@ -0,0 +1,341 @@
+#include "journal.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+  #include <fcntl.h>
+  #include <sys/file.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#include "nvml.h"
+#include "utils.h"
+
+#ifdef __linux__
+  /***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+  // Identifies a journal and the version of its layout
+  #define JOURNAL_MAGIC "PSTJRNL1"
+
+  /***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+  // Structure of the header of the journal
+  typedef struct {
+    // Identifies the journal and the version of its layout
+    char magic[8];
+
+    // Sequence number, odd while the header is being written
+    uint32_t sequence;
+
+    // Number of GPUs in the journal
+    uint32_t count;
+
+    // Time of the latest write (wall clock, in milliseconds), zero before the first one
+    uint64_t wallTime;
+
+    // Time of the latest write (CLOCK_MONOTONIC, in nanoseconds), to tell a journal from before a reboot
+    uint64_t monotonicTime;
+
+    // Flag indicating whether the fan was enabled
+    uint32_t fanEnabled;
+
+    // Number of iterations all GPUs were idle for
+    uint32_t idleTime;
+  } journalHeader;
+
+  // Structure of the record of a GPU, each one is written by the thread ticking the GPU
+  typedef struct {
+    // Sequence number, odd while the record is being written
+    uint32_t sequence;
+
+    // Flag indicating whether the GPU was managed
+    uint32_t managed;
+
+    // Performance state of the GPU
+    uint32_t pstateId;
+
+    // Counter for iterations since the GPU was last busy
+    uint32_t iterations;
+
+    // Time the GPU was last busy (CLOCK_MONOTONIC, in nanoseconds)
+    uint64_t busyTime;
+
+    // UUID of the GPU, which identifies it across restarts
+    char uuid[NVML_DEVICE_UUID_V2_BUFFER_SIZE];
+  } journalRecord;
+
+  // Structure of the journal file
+  typedef struct {
+    // Header of the journal
+    journalHeader header;
+
+    // Record of each GPU, in NVML order
+    journalRecord gpus[JOURNAL_GPUS_MAX];
+  } journalFile;
+
+  /***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+  // Descriptor of the journal file, locked while the daemon runs
+  static int fd = -1;
+
+  // Journal mapped in memory, NULL if disabled
+  static journalFile * journal = NULL;
+
+  /***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+  static unsigned long long get_wall_time_ms(void) {
+    // Get the wall clock time
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+
+    // Convert it to milliseconds
+    return (unsigned long long) ts.tv_sec * 1000ULL + (unsigned long long) ts.tv_nsec / 1000000ULL;
+  }
+
+  static void begin_write(uint32_t * sequence) {
+    // Mark the entry as being written, a crash in the middle of the write leaves it odd
+    __atomic_store_n(sequence, *sequence + 1, __ATOMIC_RELAXED);
+
+    // Keep the writes of the entry after the mark
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+  }
+
+  static void end_write(uint32_t * sequence) {
+    // Mark the entry as complete, after its writes
+    ATOMIC_STORE(sequence, *sequence + 1);
+  }
+
+  static bool read_entry(const uint32_t * sequence, void * copy, const void * entry, size_t size) {
+    // Get the sequence number before reading
+    uint32_t before = ATOMIC_LOAD(sequence);
+
+    // Copy the entry
+    memcpy(copy, entry, size);
+
+    // Keep the copy before the second check
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    // The entry is complete if it wasn't being written
+    return (before & 1) == 0 && ATOMIC_LOAD(sequence) == before;
+  }
+
+  static bool restore(const char * path, char (* uuids)[NVML_DEVICE_UUID_V2_BUFFER_SIZE], unsigned int count, journalState * restored) {
+    // Copy of the header
+    journalHeader header;
+
+    // A new, torn or foreign journal has nothing to resume
+    if (!read_entry(&journal->header.sequence, &header, &journal->header, sizeof(header)) || memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0 || header.wallTime == 0) {
+      printf("Journal %s is empty, starting from low performance state\n", path);
+      return false;
+    }
+
+    // The GPUs may have been reset or used by others since the journal was written
+    unsigned long long now = get_wall_time_ms();
+
+    if (header.wallTime > now || now - header.wallTime > JOURNAL_MAX_AGE || header.monotonicTime > get_time_ns()) {
+      printf("Journal %s is stale, starting from low performance state\n", path);
+      return false;
+    }
+
+    // The journal must describe the same GPUs
+    bool matched = header.count == count;
+
+    // Look up each GPU by its UUID, the enumeration order may have changed
+    for (unsigned int i = 0; matched && i < count; i++) {
+      // Assume the GPU is missing
+      matched = false;
+
+      for (unsigned int j = 0; j < header.count && j < JOURNAL_GPUS_MAX; j++) {
+        // Copy of the record
+        journalRecord record;
+
+        // Skip torn records and other GPUs
+        if (!read_entry(&journal->gpus[j].sequence, &record, &journal->gpus[j], sizeof(record)) || strncmp(record.uuid, uuids[i], sizeof(record.uuid)) != 0) {
+          continue;
+        }
+
+        // Store the state of the GPU
+        restored->gpus[i] = (journalGpu) { record.managed != 0, record.pstateId, record.iterations, record.busyTime };
+        matched = true;
+        break;
+      }
+    }
+
+    // Print message indicating the GPUs changed
+    if (!matched) {
+      printf("Journal %s doesn't match the GPUs, starting from low performance state\n", path);
+      return false;
+    }
+
+    // Store the state of the daemon
+    restored->fanEnabled = header.fanEnabled != 0;
+    restored->idleTime = header.idleTime;
+
+    // Return true to indicate the state can be resumed
+    return true;
+  }
+
+  /***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+  bool journal_open(const char * path, const nvmlDevice_t * devices, unsigned int count, journalState * restored, bool * resumed) {
+    // Nothing is resumed until the journal is read
+    *resumed = false;
+
+    // Validate the arguments
+    if (count > JOURNAL_GPUS_MAX) {
+      fprintf(stderr, "Too many GPUs for the journal: %u\n", count);
+      return false;
+    }
+
+    // UUID of each GPU
+    char uuids[JOURNAL_GPUS_MAX][NVML_DEVICE_UUID_V2_BUFFER_SIZE];
+
+    for (unsigned int i = 0; i < count; i++) {
+      NVML_CALL(nvmlDeviceGetUUID(devices[i], uuids[i], sizeof(uuids[i])), failure);
+    }
+
+    // Open or create the journal
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    if (fd == -1) {
+      fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+      goto failure;
+    }
+
+    // A journal written by two daemons would describe neither
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+      fprintf(stderr, "Unable to lock %s: %s\n", path, errno == EWOULDBLOCK ? "used by another instance" : strerror(errno));
+      goto failure;
+    }
+
+    // Get the size of the journal
+    struct stat st;
+
+    if (fstat(fd, &st) != 0) {
+      fprintf(stderr, "Unable to stat %s: %s\n", path, strerror(errno));
+      goto failure;
+    }
+
+    // Grow or shrink the journal to its layout, a journal of another size is discarded below
+    if (ftruncate(fd, sizeof(journalFile)) != 0) {
+      fprintf(stderr, "Unable to resize %s: %s\n", path, strerror(errno));
+      goto failure;
+    }
+
+    // Map the journal, the dirty pages survive a crash of the daemon without syncing them
+    void * mapping = mmap(NULL, sizeof(journalFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (mapping == MAP_FAILED) {
+      fprintf(stderr, "Unable to map %s: %s\n", path, strerror(errno));
+      goto failure;
+    }
+
+    journal = mapping;
+
+    // Read the state left by the previous run
+    if (st.st_size == sizeof(journalFile)) {
+      *resumed = restore(path, uuids, count, restored);
+    } else {
+      printf("Journal %s is empty, starting from low performance state\n", path);
+    }
+
+    // Describe the current GPUs, the journal stays stale until the first iteration is written
+    begin_write(&journal->header.sequence);
+    memcpy(journal->header.magic, JOURNAL_MAGIC, sizeof(journal->header.magic));
+    journal->header.count = count;
+    journal->header.wallTime = 0;
+    end_write(&journal->header.sequence);
+
+    for (unsigned int i = 0; i < count; i++) {
+      // Get the record of the GPU
+      journalRecord * record = &journal->gpus[i];
+
+      // Key the record by the UUID of the GPU
+      begin_write(&record->sequence);
+      memcpy(record->uuid, uuids[i], sizeof(record->uuid));
+      end_write(&record->sequence);
+    }
+
+    // Return true to indicate success
+    return true;
+
+    failure:
+    // Release the journal
+    journal_close();
+
+    // Return false to indicate failure
+    return false;
+  }
+
+  void journal_close(void) {
+    // Unmap the journal
+    if (journal != NULL) {
+      munmap(journal, sizeof(journalFile));
+      journal = NULL;
+    }
+
+    // Close the journal, which releases the lock
+    if (fd != -1) {
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  void journal_write_gpu(unsigned int gpu, const journalGpu * state) {
+    // If the journal is disabled
+    if (journal == NULL || gpu >= JOURNAL_GPUS_MAX) {
+      return;
+    }
+
+    // Get the record of the GPU
+    journalRecord * record = &journal->gpus[gpu];
+
+    // Write the state of the GPU
+    begin_write(&record->sequence);
+    record->managed = state->managed;
+    record->pstateId = state->pstateId;
+    record->iterations = state->iterations;
+    record->busyTime = state->busyTime;
+    end_write(&record->sequence);
+  }
+
+  void journal_write(bool fanEnabled, unsigned int idleTime) {
+    // If the journal is disabled
+    if (journal == NULL) {
+      return;
+    }
+
+    // Write the state of the daemon, and when it was last known to be valid
+    begin_write(&journal->header.sequence);
+    journal->header.wallTime = get_wall_time_ms();
+    journal->header.monotonicTime = get_time_ns();
+    journal->header.fanEnabled = fanEnabled;
+    journal->header.idleTime = idleTime;
+    end_write(&journal->header.sequence);
+  }
+#else
+  /***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+  bool journal_open(const char * path, const nvmlDevice_t * devices, unsigned int count, journalState * restored, bool * resumed) {
+    // Print an error message
+    fprintf(stderr, "Journal is not supported on this platform\n");
+
+    // Return false to indicate failure
+    return false;
+  }
+
+  void journal_close(void) {
+  }
+
+  void journal_write_gpu(unsigned int gpu, const journalGpu * state) {
+  }
+
+  void journal_write(bool fanEnabled, unsigned int idleTime) {
+  }
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include <nvml.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs in the journal (matches NVAPI_MAX_PHYSICAL_GPUS)
+#define JOURNAL_GPUS_MAX 64
+
+// Age after which the journal no longer describes the GPUs (in milliseconds)
+#define JOURNAL_MAX_AGE 30000
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the journaled state of a GPU
+typedef struct {
+  // Flag indicating whether the GPU was managed
+  bool managed;
+
+  // Performance state of the GPU
+  unsigned int pstateId;
+
+  // Counter for iterations since the GPU was last busy
+  unsigned int iterations;
+
+  // Time the GPU was last busy (CLOCK_MONOTONIC, in nanoseconds)
+  unsigned long long busyTime;
+} journalGpu;
+
+// Structure to hold the journaled state of the daemon
+typedef struct {
+  // Flag indicating whether the fan was enabled
+  bool fanEnabled;
+
+  // Number of iterations all GPUs were idle for
+  unsigned int idleTime;
+
+  // State of each GPU, in NVML order
+  journalGpu gpus[JOURNAL_GPUS_MAX];
+} journalState;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool journal_open(const char * path, const nvmlDevice_t * devices, unsigned int count, journalState * restored, bool * resumed);
+void journal_close(void);
+void journal_write_gpu(unsigned int gpu, const journalGpu * state);
+void journal_write(bool fanEnabled, unsigned int idleTime);
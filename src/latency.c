@@ -0,0 +1,185 @@
+#include "latency.h"
+
+#include <stdio.h>
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Duration above which a call is reported as an outlier (in nanoseconds), zero to disable
+static unsigned long long threshold = 0;
+
+// List of call sites that recorded at least one call
+static latencySite * sites = NULL;
+
+// GPU the calls of the current thread are made for
+#ifdef _WIN32
+  static __declspec(thread) unsigned int currentGpu = LATENCY_GPU_NONE;
+#else
+  static _Thread_local unsigned int currentGpu = LATENCY_GPU_NONE;
+#endif
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static unsigned int bucket_of(unsigned long long duration) {
+  // Bucket n holds durations below 2^n, so the bucket is the bit length of the duration
+  #ifdef _WIN32
+    unsigned int bucket = 0;
+
+    while (duration != 0) {
+      duration >>= 1;
+      bucket++;
+    }
+  #else
+    unsigned int bucket = duration == 0 ? 0 : 64 - __builtin_clzll(duration);
+  #endif
+
+  // Longer calls end up in the last bucket
+  return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+static void register_site(latencySite * site) {
+  #ifdef _WIN32
+    // Without worker threads there is nothing to synchronize
+    if (site->registered) {
+      return;
+    }
+
+    site->registered = true;
+    site->next = sites;
+    sites = site;
+  #else
+    // Only the first thread to record a call links the site
+    if (__atomic_exchange_n(&site->registered, true, __ATOMIC_ACQ_REL)) {
+      return;
+    }
+
+    // Push the site onto the list
+    site->next = __atomic_load_n(&sites, __ATOMIC_ACQUIRE);
+
+    while (!__atomic_compare_exchange_n(&sites, &site->next, site, false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+  #endif
+}
+
+static unsigned long long percentile(const unsigned long long * counts, unsigned long long total, unsigned long long max, unsigned int percent) {
+  // Number of calls below the percentile
+  unsigned long long rank = (total * percent + 99) / 100;
+
+  // Number of calls seen so far
+  unsigned long long seen = 0;
+
+  // Find the bucket holding the percentile
+  for (unsigned int i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += counts[i];
+
+    if (seen >= rank) {
+      // Return the upper bound of the bucket, which can't exceed the largest duration
+      return (1ULL << i) < max ? (1ULL << i) : max;
+    }
+  }
+
+  // Return the largest duration
+  return max;
+}
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+void latency_set_threshold(unsigned long milliseconds) {
+  // Store the threshold
+  threshold = (unsigned long long) milliseconds * 1000000ULL;
+}
+
+void latency_set_gpu(unsigned int gpu) {
+  // Attribute the following calls of this thread to the GPU
+  currentGpu = gpu < LATENCY_GPUS_MAX ? gpu : LATENCY_GPU_NONE;
+}
+
+void latency_record(latencySite * site, unsigned long long duration) {
+  // Link the site on its first call
+  if (!ATOMIC_LOAD(&site->registered)) {
+    register_site(site);
+  }
+
+  // Get the GPU of the call; each GPU is polled by a single thread, so its counters have a single writer
+  unsigned int gpu = currentGpu;
+
+  // Update the histogram
+  unsigned long long * count = &site->counts[gpu][bucket_of(duration)];
+  ATOMIC_STORE(count, ATOMIC_LOAD(count) + 1);
+
+  // Update the total and the maximum
+  ATOMIC_STORE(&site->total[gpu], ATOMIC_LOAD(&site->total[gpu]) + duration);
+
+  if (duration > ATOMIC_LOAD(&site->max[gpu])) {
+    ATOMIC_STORE(&site->max[gpu], duration);
+  }
+
+  // If the call is an outlier
+  if (threshold != 0 && duration > threshold) {
+    // Get the current time
+    unsigned long long now = get_time_ns();
+
+    // Don't repeat the warning for a call that is slow on every poll
+    if (site->warned[gpu] == 0 || now - site->warned[gpu] >= (unsigned long long) LATENCY_WARNING_PERIOD * 1000000ULL) {
+      // Remember the warning
+      site->warned[gpu] = now;
+
+      // Print the warning
+      if (gpu == LATENCY_GPU_NONE) {
+        fprintf(stderr, "Slow driver call: %s took %llu us\n", site->call, duration / 1000);
+      } else {
+        fprintf(stderr, "Slow driver call on GPU %u: %s took %llu us\n", gpu, site->call, duration / 1000);
+      }
+    }
+  }
+}
+
+void latency_print_summary(void) {
+  // Print the header
+  printf("Driver call latency (us):\n");
+  printf("  %-40s %4s %10s %10s %10s %10s %10s\n", "call", "gpu", "count", "mean", "p50", "p99", "max");
+
+  // Loop through the call sites
+  for (latencySite * site = ATOMIC_LOAD(&sites); site != NULL; site = site->next) {
+    // Length of the function name, without the arguments
+    int length = (int) strcspn(site->call, "(");
+
+    // Loop through the GPUs
+    for (unsigned int gpu = 0; gpu <= LATENCY_GPUS_MAX; gpu++) {
+      // Copy the histogram
+      unsigned long long counts[LATENCY_BUCKETS];
+      unsigned long long calls = 0;
+
+      for (unsigned int i = 0; i < LATENCY_BUCKETS; i++) {
+        counts[i] = ATOMIC_LOAD(&site->counts[gpu][i]);
+        calls += counts[i];
+      }
+
+      // Skip GPUs without calls
+      if (calls == 0) {
+        continue;
+      }
+
+      // Format the GPU column
+      char gpuName[8];
+
+      if (gpu == LATENCY_GPU_NONE) {
+        snprintf(gpuName, sizeof(gpuName), "-");
+      } else {
+        snprintf(gpuName, sizeof(gpuName), "%u", gpu);
+      }
+
+      // Get the largest duration
+      unsigned long long max = ATOMIC_LOAD(&site->max[gpu]);
+
+      // Print the statistics, percentiles are rounded up to the next power of two
+      printf("  %-40.*s %4s %10llu %10.1f %10.1f %10.1f %10.1f\n",
+        length, site->call, gpuName, calls,
+        ATOMIC_LOAD(&site->total[gpu]) / 1000.0 / calls,
+        percentile(counts, calls, max, 50) / 1000.0,
+        percentile(counts, calls, max, 99) / 1000.0,
+        max / 1000.0);
+    }
+  }
+
+  // Make the summary visible right away when requested by a signal
+  fflush(stdout);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "utils.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Number of histogram buckets, bucket n counts calls that took less than 2^n nanoseconds
+#define LATENCY_BUCKETS 36
+
+// Maximum number of GPUs tracked (matches NVAPI_MAX_PHYSICAL_GPUS)
+#define LATENCY_GPUS_MAX 64
+
+// Index used for calls that are not made on behalf of a specific GPU
+#define LATENCY_GPU_NONE LATENCY_GPUS_MAX
+
+// Minimum time between two warnings about the same call on the same GPU (in milliseconds)
+#define LATENCY_WARNING_PERIOD 10000
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the latency histograms of a call site
+typedef struct latencySite {
+  // Source text of the call
+  const char * call;
+
+  // Flag indicating whether the site is linked into the list of sites
+  bool registered;
+
+  // Number of calls in each bucket, per GPU
+  unsigned long long counts[LATENCY_GPUS_MAX + 1][LATENCY_BUCKETS];
+
+  // Total and largest duration of the calls, per GPU (in nanoseconds)
+  unsigned long long total[LATENCY_GPUS_MAX + 1];
+  unsigned long long max[LATENCY_GPUS_MAX + 1];
+
+  // Time of the last outlier warning, per GPU (in nanoseconds)
+  unsigned long long warned[LATENCY_GPUS_MAX + 1];
+
+  // Next site in the list
+  struct latencySite * next;
+} latencySite;
+
+/***** ***** ***** ***** ***** MACROS ***** ***** ***** ***** *****/
+
+// Macro to evaluate a driver call, store its result and record its duration
+#define LATENCY_CALL(result, call) do {                         \
+  /* Histograms of this call site */                            \
+  static latencySite latencySite_ = { #call };                  \
+                                                                \
+  /* Get the start time */                                      \
+  unsigned long long latencyStart_ = get_time_ns();             \
+                                                                \
+  /* Evaluate the call and store the result */                  \
+  (result) = (call);                                            \
+                                                                \
+  /* Record the duration */                                     \
+  latency_record(&latencySite_, get_time_ns() - latencyStart_); \
+} while (0)
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+void latency_set_threshold(unsigned long milliseconds);
+void latency_set_gpu(unsigned int gpu);
+void latency_record(latencySite * site, unsigned long long duration);
+void latency_print_summary(void);
@@ -1,48 +1,157 @@
 #include <nvapi.h>
 #include <nvml.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 
 #ifdef _WIN32
   #include <windows.h>
-#elif __linux__
-  #include <unistd.h>
 #endif
 
+#include "budget.h"
+#include "cluster.h"
+#include "config.h"
+#include "control.h"
+#include "fan.h"
+#include "fault.h"
+#include "gang.h"
+#include "hints.h"
+#include "http.h"
+#include "journal.h"
+#include "latency.h"
+#include "metrics.h"
 #include "nvapi.h"
 #include "nvml.h"
+#include "policy.h"
+#include "record.h"
+#include "scheduler.h"
+#include "telemetry.h"
+#include "topology.h"
 #include "utils.h"
+#include "workers.h"
 
 /***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
 
+// Time allowed to connect to a fan URL (in milliseconds)
+#define FAN_CONNECT_TIMEOUT 1000
+
+// Time allowed between two reads of a fan URL response (in milliseconds)
+#define FAN_READ_TIMEOUT 2000
+
+// Number of retries of a failed fan URL request
+#define FAN_RETRIES 2
+
+// Time after which a fan script is killed (in milliseconds)
+#define FAN_SCRIPT_TIMEOUT 10000
+
+// Time a GPU is left alone after a failed tick, doubled after each further one (in milliseconds)
+#define FAULT_BACKOFF_MIN 1000
+
+// Longest time a failing GPU is left alone (in milliseconds)
+#define FAULT_BACKOFF_MAX 60000
+
+// Vote of an overheated or quarantined GPU, leaving it out of its gang
+#define GANG_NO_VOTE UINT_MAX
+
 // Number of iterations to wait before considering disabling the fan
 #define ITERATIONS_BEFORE_IDLE 9000
 
-// Number of iterations to wait before switching states
-#define ITERATIONS_BEFORE_SWITCH 30
+// Duration above which a driver call is reported as slow (in milliseconds)
+#define LATENCY_WARNING 50
 
-// High performance state for the GPU
-#define PERFORMANCE_STATE_HIGH 16
+// Power assumed for a GPU in high performance state when the driver doesn't report its limit (in watts)
+#define POWER_BUDGET_HIGH_POWER 300
 
-// Low performance state for the GPU
-#define PERFORMANCE_STATE_LOW 8
+// Maximum number of compute processes tracked per GPU
+#define PROCESSES_MAX 64
 
 // Sleep interval (in milliseconds) between utilization checks
 #define SLEEP_INTERVAL 100
 
-// Temperature threshold (in degrees C)
-#define TEMPERATURE_THRESHOLD 80
+// Distance to the temperature threshold at which lazy sampling reads the temperature (in degrees C)
+#define TEMPERATURE_MARGIN 5
+
+// Longest time between two temperature reads with lazy sampling (in milliseconds)
+#define TEMPERATURE_REREAD_INTERVAL 5000
 
-// Utilization threshold (in percentage)
-#define UTILIZATION_THRESHOLD 0
+// Maximum number of utilization samples retrieved per poll
+#define UTILIZATION_SAMPLES_MAX 128
 
 /***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
 
+// Modes of utilization sampling
+typedef enum {
+  // Use the current utilization rate
+  UTILIZATION_MODE_RATE,
+
+  // Use the maximum of the utilization samples since the previous poll
+  UTILIZATION_MODE_MAX,
+
+  // Use the mean of the utilization samples since the previous poll
+  UTILIZATION_MODE_MEAN,
+} utilizationMode;
+
+// Structure to hold the options, from the command line and the configuration file
+typedef struct {
+  char * configFile;
+  char * coordinator;
+  char * coordinatorNode;
+  unsigned long decoderUtilizationThreshold;
+  char * disableFanScript;
+  char * disableFanUrl;
+  char * enableFanScript;
+  char * enableFanUrl;
+  unsigned long encoderUtilizationThreshold;
+  unsigned long ewmaWeight;
+  unsigned long fanConnectTimeout;
+  unsigned long fanReadTimeout;
+  unsigned long fanRetries;
+  unsigned long fanScriptTimeout;
+  char * gangs;
+  char * hintSocket;
+  unsigned long holdTime;
+  unsigned long ids[NVAPI_MAX_PHYSICAL_GPUS];
+  size_t idsCount;
+  unsigned long iterationsBeforeIdle;
+  unsigned long iterationsBeforeSwitch;
+  char * journal;
+  policyStep ladder[LADDER_STEPS_MAX];
+  size_t ladderSteps;
+  unsigned long latencyWarning;
+  bool lazyTemperature;
+  unsigned long maxSleepInterval;
+  unsigned long memoryUtilizationThreshold;
+  char * metricsFile;
+  char * metricsListen;
+  unsigned long minSleepInterval;
+  unsigned long performanceStateHigh;
+  unsigned long performanceStateLow;
+  unsigned long powerBudget;
+  unsigned long pcieThroughputThreshold;
+  const policy * pstatePolicy;
+  unsigned long processCountThreshold;
+  bool processTrigger;
+  char * recordFile;
+  unsigned long sleepInterval;
+  unsigned long temperatureMargin;
+  unsigned long temperatureRereadInterval;
+  unsigned long temperatureThreshold;
+  bool threaded;
+  char * topologyCache;
+  utilizationMode utilizationSampling;
+  unsigned long utilizationThreshold;
+  unsigned long utilizationThresholdDown;
+  unsigned long utilizationThresholdUp;
+} daemonOptions;
+
 // Structure to hold the state of each GPU
 typedef struct {
-  // Counter for iterations when in a specific state
-  unsigned int iterations;
+  // Settings of the GPU
+  controlConfig settings;
+
+  // State of the performance state policy
+  policyState policy;
 
   // Current performance state of the GPU
   unsigned int pstateId;
@@ -50,15 +159,102 @@ typedef struct {
   // GPU management state
   bool managed;
 
+  // First GPU of the gang of the GPU, which ticks the whole gang, the GPU itself if not in a gang
+  unsigned int gangLeader;
+
+  // Flag indicating whether the GPU switches together with other GPUs
+  bool ganged;
+
+  // Performance state the GPU asked for in its latest tick, GANG_NO_VOTE if it didn't
+  unsigned int vote;
+
   // Flag to prevent idle ticks
   bool preventIdleTick;
+
+  // Last sampled utilization of the GPU
+  unsigned int utilization;
+
+  // Flag indicating whether the utilization rose since the previous sample
+  bool utilizationRising;
+
+  // Number of fan enable requests issued for the GPU
+  unsigned int fanRequests;
+
+  // Number of fan enable requests already handled
+  unsigned int fanRequestsHandled;
+
+  // Timestamp of the last seen utilization sample
+  unsigned long long lastSampleTimestamp;
+
+  // Last sampled memory controller utilization of the GPU
+  unsigned int memoryUtilization;
+
+  // Timestamp of the last seen memory controller utilization sample
+  unsigned long long lastMemorySampleTimestamp;
+
+  // Last read temperature (in degrees C) and power draw (in milliwatts) of the GPU
+  unsigned int temperature;
+  unsigned int power;
+
+  // Flag indicating whether the GPU asked for high performance state in its latest tick
+  bool wantsHigh;
+
+  // Flag indicating whether the power budget holds the GPU below high performance state
+  bool budgetDenied;
+
+  // Estimated power draw below and in high performance state (in milliwatts), zero if not known yet
+  unsigned long long lowPower;
+  unsigned long long highPower;
+
+  // Time since which the GPU waits for the power budget (CLOCK_MONOTONIC, in nanoseconds), zero if not waiting
+  unsigned long long waitingSince;
+
+  // Process ids of the compute processes seen in the previous poll
+  unsigned int processIds[PROCESSES_MAX];
+
+  // Number of compute processes seen in the previous poll
+  unsigned int processCount;
+
+  // Number of consecutive failed ticks of the GPU, zero while it is healthy
+  unsigned int failures;
+
+  // Time of the next attempt to tick a quarantined GPU (CLOCK_MONOTONIC, in nanoseconds)
+  unsigned long long retryTime;
+
+  // Flag indicating whether the handle of the GPU is fetched again before the next attempt
+  bool lost;
 } gpuState;
 
 /***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
 
+// Options
+static daemonOptions options;
+
+// Options that can be set in the section of a GPU
+static const char * const gpuOptionNames[] = {
+  "ewma-weight",
+  "hold-time",
+  "iterations-before-switch",
+  "ladder",
+  "performance-state-high",
+  "performance-state-low",
+  "policy",
+  "temperature-threshold",
+  "utilization-threshold",
+  "utilization-threshold-down",
+  "utilization-threshold-up",
+  NULL,
+};
+
 // Flag indicating whether the program should continue running
 static volatile sig_atomic_t shouldRun = true;
 
+// Flag indicating whether the latency summary was requested
+static volatile sig_atomic_t summaryRequested = false;
+
+// Flag indicating whether reloading the configuration was requested
+static volatile sig_atomic_t reloadRequested = false;
+
 // Flag indicating whether an error has occurred
 static bool errorOccurred = false;
 
@@ -73,211 +269,2119 @@ static nvmlDevice_t nvmlDevices[NVAPI_MAX_PHYSICAL_GPUS];
 // Variable to store the number of GPU devices
 static unsigned int deviceCount;
 
-// Variable to store GPU temperature
-static unsigned int temperature;
+// Variable to store GPU states
+static gpuState gpuStates[NVAPI_MAX_PHYSICAL_GPUS];
+
+// Variable to store idle time
+static unsigned int idleTime = 0;
+
+// Flag indicating whether the fan was last asked to be enabled
+static bool fanEnabled = false;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static void handle_exit(int signal) {
+  // Check if the received signal is SIGINT or SIGTERM
+  if (signal == SIGINT || signal == SIGTERM) {
+    // Set the global flag to false to indicate the program should stop running
+    shouldRun = false;
+  }
+}
+
+static void handle_summary(int signal) {
+  // Print the latency summary from the control loop
+  summaryRequested = true;
+}
+
+static void handle_reload(int signal) {
+  // Reload the configuration from the control loop
+  reloadRequested = true;
+}
+
+static bool invoke_fan_script(bool isEnableScript, char * script) {
+  // How the fan URL is requested
+  httpOptions http = { options.fanConnectTimeout, options.fanReadTimeout, options.fanRetries };
+
+  // Remember the desired fan state for the journal
+  fanEnabled = isEnableScript;
+
+  // Hand the desired fan state to the actuator, the URL or the script is handled without blocking the control loop
+  return fan_request(isEnableScript, script, isEnableScript ? options.enableFanUrl : options.disableFanUrl, options.fanScriptTimeout, &http);
+}
+
+static bool may_enter_high(unsigned int i) {
+  // Both the coordinator and the power budget of the node must allow it
+  return cluster_granted(i) && !ATOMIC_LOAD(&gpuStates[i].budgetDenied);
+}
+
+static bool set_pstate(unsigned int i, unsigned int pstateId) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Attribute the driver calls to the GPU
+  latency_set_gpu(i);
+
+  // If GPU are unmanaged
+  if (!state->managed) {
+    // Return true to indicate success
+    return true;
+  }
+
+  // Set the GPU to the desired performance state
+  NVAPI_CALL(NvAPI_GPU_SetForcePstate(nvapiDevices[i], pstateId, 0), failure);
+
+  // Restart the policy from the new performance state
+  policy_reset(&state->policy, get_time_ns());
+
+  // Update the GPU state with the new performance state
+  ATOMIC_STORE(&state->pstateId, pstateId);
+
+  // Account for the transition
+  metrics_pstate(i, pstateId);
+
+  // Record the decision
+  record_pstate(i, pstateId);
+
+  // Print the current GPU state
+  printf("GPU %u entered performance state %u\n", i, state->pstateId);
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
+
+static bool enter_pstate(unsigned int i, unsigned int pstateId) {
+  // Stay below high performance state until the coordinator or the power budget grants a slot
+  if (pstateId == gpuStates[i].settings.policyConfiguration.performanceStateHigh && !may_enter_high(i)) {
+    // Return true, the GPU asks again on its next tick
+    return true;
+  }
+
+  // Set the GPU to the desired performance state
+  return set_pstate(i, pstateId);
+}
+
+static bool aggregate_samples(unsigned int i, nvmlSamplingType_t type, unsigned long long * lastTimestamp, unsigned int * value) {
+  // Buffer to hold the samples
+  nvmlSample_t samples[UTILIZATION_SAMPLES_MAX];
+
+  // Number of samples that fit into the buffer
+  unsigned int sampleCount = UTILIZATION_SAMPLES_MAX;
+
+  // Type of the sample values
+  nvmlValueType_t sampleType;
+
+  // Variable to hold the result
+  nvmlReturn_t result;
+
+  // Retrieve the samples taken since the last seen one
+  LATENCY_CALL(result, nvmlDeviceGetSamples(nvmlDevices[i], type, *lastTimestamp, &sampleType, &sampleCount, samples));
+
+  // If the driver took no new samples since the previous poll, the caller keeps the previous value
+  if (result == NVML_ERROR_NOT_FOUND || (result == NVML_SUCCESS && sampleCount == 0)) {
+    return true;
+  }
+
+  // Check if the samples were retrieved
+  if (result != NVML_SUCCESS) {
+    // Print the error message to standard error
+    fprintf(stderr, "nvmlDeviceGetSamples(): %s\n", nvmlErrorString(result));
+
+    // Keep the kind of the error for the fault isolation
+    fault_nvml(result);
+
+    // Return false to indicate failure
+    return false;
+  }
+
+  // Aggregates of the samples
+  unsigned long long sum = 0;
+  unsigned long long max = 0;
+
+  // Loop through the samples
+  for (unsigned int j = 0; j < sampleCount; j++) {
+    // Variable to hold the sample value
+    unsigned long long sample;
+
+    // Convert the sample value
+    switch (sampleType) {
+      case NVML_VALUE_TYPE_UNSIGNED_LONG:
+        sample = samples[j].sampleValue.ulVal;
+        break;
+
+      case NVML_VALUE_TYPE_UNSIGNED_LONG_LONG:
+        sample = samples[j].sampleValue.ullVal;
+        break;
+
+      default:
+        sample = samples[j].sampleValue.uiVal;
+        break;
+    }
+
+    // Update the aggregates
+    sum += sample;
+    max = sample > max ? sample : max;
+
+    // Remember the newest sample
+    if (samples[j].timeStamp > *lastTimestamp) {
+      *lastTimestamp = samples[j].timeStamp;
+    }
+  }
+
+  // Return the aggregate selected by the mode
+  *value = (unsigned int) (options.utilizationSampling == UTILIZATION_MODE_MAX ? max : sum / sampleCount);
+
+  // Return true to indicate success
+  return true;
+}
+
+static bool sample_utilization(unsigned int i, unsigned int * value, unsigned int * memory) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // If using the current utilization rate
+  if (options.utilizationSampling == UTILIZATION_MODE_RATE) {
+    // Variable to store GPU utilization information
+    nvmlUtilization_t utilization;
+
+    // Retrieve the current utilization rates of the GPU
+    NVML_CALL(nvmlDeviceGetUtilizationRates(nvmlDevices[i], &utilization), failure);
+
+    // Return the GPU and memory controller utilization, both come with the same call
+    *value = utilization.gpu;
+    *memory = utilization.memory;
+
+    // Return true to indicate success
+    return true;
+  }
+
+  // Keep the previous values unless the driver took new samples
+  *value = state->utilization;
+  *memory = state->memoryUtilization;
+
+  // Aggregate the utilization samples since the previous poll
+  ASSERT_TRUE(aggregate_samples(i, NVML_GPU_UTILIZATION_SAMPLES, &state->lastSampleTimestamp, value), failure);
+
+  // Aggregate the memory controller samples the same way, only if they are used
+  if (options.memoryUtilizationThreshold != 0) {
+    ASSERT_TRUE(aggregate_samples(i, NVML_MEMORY_UTILIZATION_SAMPLES, &state->lastMemorySampleTimestamp, memory), failure);
+  }
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
+
+static bool detect_process_launch(unsigned int i, bool * launched) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Buffer to hold the process information
+  nvmlProcessInfo_t infos[PROCESSES_MAX];
+
+  // Number of processes that fit into the buffer
+  unsigned int count = PROCESSES_MAX;
+
+  // Variable to hold the result
+  nvmlReturn_t result;
+
+  // Retrieve the compute processes running on the GPU
+  LATENCY_CALL(result, nvmlDeviceGetComputeRunningProcesses(nvmlDevices[i], &count, infos));
+
+  // If more processes run than can be tracked
+  if (result == NVML_ERROR_INSUFFICIENT_SIZE) {
+    // Only report the launch that overflowed the buffer
+    *launched = state->processCount < PROCESSES_MAX;
+
+    // Remember the buffer as full
+    state->processCount = PROCESSES_MAX;
+
+    // Return true to indicate success
+    return true;
+  }
+
+  // Check if the processes were retrieved
+  if (result != NVML_SUCCESS) {
+    // Print the error message to standard error
+    fprintf(stderr, "nvmlDeviceGetComputeRunningProcesses(): %s\n", nvmlErrorString(result));
+
+    // Keep the kind of the error for the fault isolation
+    fault_nvml(result);
+
+    // Return false to indicate failure
+    return false;
+  }
+
+  // Assume no process was launched
+  *launched = false;
+
+  // Loop through the running processes
+  for (unsigned int j = 0; j < count && !*launched; j++) {
+    // Assume the process is new
+    *launched = true;
+
+    // Look for the process in the previous poll
+    for (unsigned int k = 0; k < state->processCount; k++) {
+      if (state->processIds[k] == infos[j].pid) {
+        // The process is already known
+        *launched = false;
+        break;
+      }
+    }
+  }
+
+  // Remember the running processes
+  for (unsigned int j = 0; j < count; j++) {
+    state->processIds[j] = infos[j].pid;
+  }
+
+  // Remember the number of running processes
+  state->processCount = count;
+
+  // Return true to indicate success
+  return true;
+}
+
+static void request_fan(gpuState * state) {
+  // Only the thread ticking the GPU writes the counter, the control loop compares it with the handled count
+  ATOMIC_STORE(&state->fanRequests, state->fanRequests + 1);
+}
+
+static bool apply_lease(unsigned int i) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Thermal protection takes precedence over leases
+  if (state->preventIdleTick) {
+    return true;
+  }
+
+  // If the GPU is not held by a lease or already in high performance state
+  if (!hints_held(i, get_time_ns()) || state->pstateId == state->settings.policyConfiguration.performanceStateHigh) {
+    return true;
+  }
+
+  // Switch to high performance state
+  if (!enter_pstate(i, state->settings.policyConfiguration.performanceStateHigh)) {
+    return false;
+  }
+
+  // Enable the fan
+  request_fan(state);
+
+  // Return true to indicate success
+  return true;
+}
+
+static bool switch_pstate(unsigned int i, unsigned int pstateId) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // If the GPU is already there
+  if (pstateId == state->pstateId) {
+    return true;
+  }
+
+  // Flag indicating whether the GPU speeds up
+  bool faster = policy_rank(pstateId) < policy_rank(state->pstateId);
+
+  // Switch to the desired performance state
+  if (!enter_pstate(i, pstateId)) {
+    return false;
+  }
+
+  // Enable the fan when switching to a faster performance state
+  if (faster && state->pstateId == pstateId) {
+    request_fan(state);
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+static bool busy_signal(unsigned int i, unsigned int memoryUtilization) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Variable to hold the value of a signal
+  unsigned int value;
+
+  // Memory-bound kernels keep the memory controller busy while few SMs are
+  if (options.memoryUtilizationThreshold != 0 && memoryUtilization > options.memoryUtilizationThreshold) {
+    return true;
+  }
+
+  // Long copies between the host and the GPU run on the copy engines
+  if (options.pcieThroughputThreshold != 0 && telemetry_get(i, TELEMETRY_PCIE_THROUGHPUT, &value) && value > options.pcieThroughputThreshold) {
+    return true;
+  }
+
+  // Transcoding runs on NVENC and NVDEC
+  if (options.encoderUtilizationThreshold != 0 && telemetry_get(i, TELEMETRY_ENCODER_UTILIZATION, &value) && value > options.encoderUtilizationThreshold) {
+    return true;
+  }
+
+  if (options.decoderUtilizationThreshold != 0 && telemetry_get(i, TELEMETRY_DECODER_UTILIZATION, &value) && value > options.decoderUtilizationThreshold) {
+    return true;
+  }
+
+  // Process launch detection already counted the processes in this tick
+  if (options.processCountThreshold != 0 && options.processTrigger) {
+    return state->processCount >= options.processCountThreshold;
+  }
+
+  if (options.processCountThreshold != 0 && telemetry_get(i, TELEMETRY_PROCESSES, &value)) {
+    return value >= options.processCountThreshold;
+  }
+
+  // Return false if no other engine is busy
+  return false;
+}
+
+static unsigned long long read_clock(void * context) {
+  // The daemon runs on the monotonic clock
+  return get_time_ns();
+}
+
+static bool read_temperature(void * context, unsigned int * value) {
+  // Get the index of the GPU
+  unsigned int i = *(const unsigned int *) context;
+
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Variables to store the optional telemetry of the GPU
+  unsigned int memoryTemperature;
+  unsigned int power;
+
+  // Read the telemetry of the GPU
+  ASSERT_TRUE(telemetry_update(i), failure);
+
+  // Get the current temperature of the GPU
+  ASSERT_TRUE(telemetry_get(i, TELEMETRY_TEMPERATURE, value), failure);
+
+  // Publish the temperature
+  metrics_temperature(i, *value);
+
+  // Keep it for the coordinator
+  ATOMIC_STORE(&state->temperature, *value);
+
+  // Publish the optional telemetry the driver reported
+  if (telemetry_get(i, TELEMETRY_MEMORY_TEMPERATURE, &memoryTemperature)) {
+    metrics_memory_temperature(i, memoryTemperature);
+  }
+
+  if (telemetry_get(i, TELEMETRY_POWER, &power)) {
+    metrics_power(i, power);
+    ATOMIC_STORE(&state->power, power);
+  }
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
+
+static bool read_utilization(void * context, unsigned int * value, bool * available) {
+  // Get the index of the GPU
+  unsigned int i = *(const unsigned int *) context;
+
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Get the settings of the GPU
+  const controlConfig * settings = &state->settings;
+
+  // Variable to store GPU utilization
+  unsigned int utilization;
+
+  // Variable to store memory controller utilization
+  unsigned int memoryUtilization;
+
+  // The GPU is below the temperature threshold, allow idle ticks
+  ATOMIC_STORE(&state->preventIdleTick, false);
+
+  // If the coordinator or the power budget took the slot back
+  if (state->pstateId == settings->policyConfiguration.performanceStateHigh && !may_enter_high(i)) {
+    // Leave high performance state for the step below, the policy asks for it again below
+    ASSERT_TRUE(enter_pstate(i, policy_step_down(&settings->policyConfiguration, state->pstateId)), failure);
+  }
+
+  // If the GPU is held at high performance state by a client
+  if (hints_held(i, get_time_ns())) {
+    // A held GPU always wants a slot, and its gang with it
+    ATOMIC_STORE(&state->wantsHigh, true);
+    state->vote = settings->policyConfiguration.performanceStateHigh;
+
+    // Switch to high performance state if needed
+    ASSERT_TRUE(apply_lease(i), failure);
+
+    // Restart the policy once the lease expires
+    policy_reset(&state->policy, get_time_ns());
+
+    // Record the sample, the utilization is not read while held
+    record_sample(i, state->temperature, RECORD_NO_UTILIZATION);
+
+    // The lease decides instead of the policy
+    *available = false;
+
+    // Return true to indicate success
+    return true;
+  }
+
+  // If process launch detection is enabled
+  if (options.processTrigger) {
+    // Flag indicating whether a new compute process appeared
+    bool launched;
+
+    // Check for new compute processes
+    ASSERT_TRUE(detect_process_launch(i, &launched), failure);
+
+    // If a process appeared and the GPU is not already in high performance state
+    if (launched && state->pstateId != settings->policyConfiguration.performanceStateHigh) {
+      // Switch to high performance state before the process submits work
+      if (!enter_pstate(i, settings->policyConfiguration.performanceStateHigh)) {
+        goto failure;
+      }
+
+      // Enable the fan
+      request_fan(state);
+    }
+  }
+
+  // Retrieve the utilization of the GPU
+  ASSERT_TRUE(sample_utilization(i, &utilization, &memoryUtilization), failure);
+
+  // Track if the utilization is rising
+  ATOMIC_STORE(&state->utilizationRising, utilization > state->utilization);
+
+  // Store the utilization
+  ATOMIC_STORE(&state->utilization, utilization);
+
+  // Store the memory controller utilization, kept when no new samples arrive
+  state->memoryUtilization = memoryUtilization;
+
+  // Publish the utilization
+  metrics_utilization(i, utilization);
+
+  // Another engine busy above its threshold counts as full utilization, whatever the policy
+  *value = busy_signal(i, memoryUtilization) ? 100 : utilization;
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
+
+static bool tick_gpu(unsigned int i) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Attribute the driver calls to the GPU
+  latency_set_gpu(i);
+
+  // Take the time from the monotonic clock and the telemetry from the driver
+  controlSource source = { &i, read_clock, read_temperature, read_utilization };
+
+  // Variable to hold the result of the control step
+  controlStep step;
+
+  // Run the control step
+  ASSERT_TRUE(control_step(&state->settings, &state->policy, &source, &state->pstateId, &step), failure);
+
+  // If the GPU temperature exceeds the defined threshold
+  if (step.outcome == CONTROL_OVERHEATED) {
+    // If the GPU is not already there
+    if (state->pstateId != step.pstateId) {
+      // Switch to the lower performance state
+      if (!enter_pstate(i, step.pstateId)) {
+        goto failure;
+      }
+
+      // Enable the fan
+      request_fan(state);
+
+      // Prevent idle ticks
+      ATOMIC_STORE(&state->preventIdleTick, true);
+
+      // Count the thermal override
+      metrics_thermal_override(i);
+    }
+
+    // An overheated GPU doesn't compete for a slot, nor pulls its gang up
+    ATOMIC_STORE(&state->wantsHigh, false);
+    state->vote = GANG_NO_VOTE;
+
+    // Record the sample, the utilization is not read while overheated
+    record_sample(i, step.temperature, RECORD_NO_UTILIZATION);
+
+    // Skip further checks for this iteration
+    return true;
+  }
+
+  // A lease held the GPU, skip further checks for this iteration
+  if (step.outcome == CONTROL_SKIPPED) {
+    return true;
+  }
+
+  // Record the sample the policy saw, so a replay takes the same decisions
+  record_sample(i, step.temperature, step.utilization);
+
+  // Tell the coordinator whether the GPU wants a slot
+  ATOMIC_STORE(&state->wantsHigh, step.pstateId == state->settings.policyConfiguration.performanceStateHigh);
+
+  // A GPU in a gang only votes, the gang switches together once all of them voted
+  state->vote = step.pstateId;
+
+  if (state->ganged) {
+    return true;
+  }
+
+  // Switch to the desired performance state
+  ASSERT_TRUE(switch_pstate(i, step.pstateId), failure);
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
+
+static bool refresh_handle(unsigned int i) {
+  // Attribute the driver calls to the GPU
+  latency_set_gpu(i);
+
+  // Fetch the handle of the GPU again, the old one may point to the GPU before it fell off the bus
+  NVML_CALL(nvmlDeviceGetHandleByIndex(i, &nvmlDevices[i]), failure);
+
+  // Read the telemetry through the new handle
+  telemetry_set_device(i, nvmlDevices[i]);
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
+
+static bool isolate_fault(unsigned int i) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Get the worst driver error of the failed tick
+  faultKind kind = fault_take();
+
+  // Errors retrying can't fix stop the daemon
+  if (kind == FAULT_NONE || kind == FAULT_FATAL) {
+    return false;
+  }
+
+  // Count the consecutive failure
+  ATOMIC_STORE(&state->failures, state->failures + 1);
+
+  // Fetch the handle again before the next attempt on a lost GPU
+  state->lost = state->lost || kind == FAULT_LOST;
+
+  // Leave the GPU alone, twice as long after each further failure
+  unsigned long long backoff = FAULT_BACKOFF_MIN;
+
+  for (unsigned int n = 1; n < state->failures && backoff < FAULT_BACKOFF_MAX; n++) {
+    backoff *= 2;
+  }
+
+  if (backoff > FAULT_BACKOFF_MAX) {
+    backoff = FAULT_BACKOFF_MAX;
+  }
+
+  state->retryTime = get_time_ns() + backoff * 1000000ULL;
+
+  // A quarantined GPU doesn't compete for a slot, nor pulls its gang up
+  ATOMIC_STORE(&state->wantsHigh, false);
+  state->vote = GANG_NO_VOTE;
+
+  // Count the fault
+  metrics_fault(i);
+
+  // Print message indicating the GPU is quarantined
+  printf("GPU %u failed with a %s error, retrying in %llu ms\n", i, fault_name(kind), backoff);
+
+  // Hand the GPU back to the driver while it is left alone, if it still responds
+  if (state->failures == 1 && state->pstateId != 16 && set_pstate(i, 16)) {
+    printf("GPU %u is managed by the driver until it recovers\n", i);
+  }
+
+  // Errors of the attempt above don't carry over
+  fault_take();
+
+  // Return true, the other GPUs keep being managed
+  return true;
+}
+
+static bool tick_checked(unsigned int i) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Only the errors of this tick decide
+  fault_take();
+
+  // If the GPU is quarantined
+  if (state->failures != 0) {
+    // Wait for the next attempt, without holding back the other GPUs
+    if (get_time_ns() < state->retryTime) {
+      state->vote = GANG_NO_VOTE;
+      return true;
+    }
+
+    // Fetch the handle of a lost GPU again
+    if (state->lost) {
+      if (!refresh_handle(i)) {
+        return isolate_fault(i);
+      }
+
+      state->lost = false;
+    }
+  }
+
+  // Update the GPU
+  if (!tick_gpu(i)) {
+    return isolate_fault(i);
+  }
+
+  // If the GPU recovered
+  if (state->failures != 0) {
+    // Print message indicating the GPU is managed again
+    printf("GPU %u recovered after %u failed attempts\n", i, state->failures);
+
+    // Release the GPU from quarantine
+    ATOMIC_STORE(&state->failures, 0);
+    metrics_recovered(i);
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+static bool tick_gang(unsigned int i) {
+  // A GPU outside of a gang is ticked alone
+  if (!gpuStates[i].ganged) {
+    return tick_checked(i);
+  }
+
+  // Get the settings of the first GPU, which the gang follows
+  const policyConfig * config = &gpuStates[i].settings.policyConfiguration;
+
+  // Fastest performance state any GPU of the gang voted for
+  unsigned int target = GANG_NO_VOTE;
+
+  // Tick each GPU of the gang
+  for (unsigned int j = i; j < deviceCount; j++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[j];
+
+    // Skip GPUs of other gangs
+    if (!state->managed || state->gangLeader != i) {
+      continue;
+    }
+
+    // Update the GPU, collecting its vote
+    ASSERT_TRUE(tick_checked(j), failure);
+
+    // Keep the fastest vote
+    if (state->vote != GANG_NO_VOTE && (target == GANG_NO_VOTE || policy_rank(state->vote) < policy_rank(target))) {
+      target = state->vote;
+    }
+  }
+
+  // If every GPU of the gang is overheated
+  if (target == GANG_NO_VOTE) {
+    return true;
+  }
+
+  // Flag indicating whether the gang wants high performance state
+  bool wantsHigh = target == config->performanceStateHigh;
+
+  // Flag indicating whether every voting GPU may enter high performance state
+  bool allowed = true;
+
+  // Ask for a slot for each voting GPU of the gang
+  for (unsigned int j = i; j < deviceCount; j++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[j];
+
+    // Skip GPUs of other gangs and those not voting
+    if (!state->managed || state->gangLeader != i || state->vote == GANG_NO_VOTE) {
+      continue;
+    }
+
+    // The gang asks for a slot as a whole
+    ATOMIC_STORE(&state->wantsHigh, wantsHigh);
+
+    // Check if the GPU may enter high performance state
+    allowed = allowed && may_enter_high(j);
+  }
+
+  // A single rank held back by the coordinator or the power budget slows down the whole gang, which waits a step below
+  if (wantsHigh && !allowed) {
+    target = policy_step_down(config, target);
+  }
+
+  // Switch each voting GPU of the gang in this tick
+  for (unsigned int j = i; j < deviceCount; j++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[j];
+
+    // Skip GPUs of other gangs and those not voting
+    if (!state->managed || state->gangLeader != i || state->vote == GANG_NO_VOTE) {
+      continue;
+    }
+
+    // Switch the GPU, a failing GPU is left behind while the others switch
+    if (!switch_pstate(j, target)) {
+      ASSERT_TRUE(isolate_fault(j), failure);
+    }
+  }
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
+
+static void share_power_budget(void) {
+  // If the power budget is disabled
+  if (options.powerBudget == 0) {
+    // Let every GPU go high
+    for (unsigned int i = 0; i < deviceCount; i++) {
+      ATOMIC_STORE(&gpuStates[i].budgetDenied, false);
+    }
+
+    return;
+  }
+
+  // Entries of the managed GPUs
+  budgetEntry entries[NVAPI_MAX_PHYSICAL_GPUS];
+
+  // Number of entries
+  size_t count = 0;
+
+  // Get the current time
+  unsigned long long now = get_time_ns();
+
+  // Describe each managed GPU
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[i];
+
+    // Check if GPU is unmanaged
+    if (!state->managed) {
+      continue;
+    }
+
+    // Get the power draw
+    unsigned long long power = ATOMIC_LOAD(&state->power);
+
+    // Start from the enforced power limit, the worst case in high performance state
+    if (state->highPower == 0) {
+      // Variable to hold the limit
+      unsigned int limit;
+
+      // Variable to hold the result
+      nvmlReturn_t result;
+
+      // Attribute the driver call to the GPU
+      latency_set_gpu(i);
+
+      // Retrieve the limit, a default is assumed if the driver doesn't report it
+      LATENCY_CALL(result, nvmlDeviceGetEnforcedPowerLimit(nvmlDevices[i], &limit));
+
+      state->highPower = result == NVML_SUCCESS ? limit : POWER_BUDGET_HIGH_POWER * 1000ULL;
+    }
+
+    // Learn the draw of each state, the peak in high performance state fades slowly so one heavy load doesn't count forever
+    if (ATOMIC_LOAD(&state->pstateId) == state->settings.policyConfiguration.performanceStateHigh) {
+      unsigned long long faded = state->highPower - state->highPower / 1000;
+      state->highPower = power > faded ? power : faded;
+    }
+
+    // The current draw bounds the draw below high performance state, which is only known once the GPU is there
+    state->lowPower = power;
+
+    // Get the utilization
+    unsigned int utilization = ATOMIC_LOAD(&state->utilization);
+
+    // Describe the GPU, busier GPUs go first
+    entries[count++] = (budgetEntry) {
+      .lowPower = state->lowPower,
+      .highPower = state->highPower,
+      .pressure = utilization,
+      .waiting = state->waitingSince != 0 ? (now - state->waitingSince) / 1000000ULL : 0,
+      .order = i,
+      .index = i,
+      .wantsHigh = ATOMIC_LOAD(&state->wantsHigh),
+      .granted = !ATOMIC_LOAD(&state->budgetDenied),
+    };
+  }
+
+  // Share the budget (in milliwatts)
+  budget_allocate(entries, count, (unsigned long long) options.powerBudget * 1000ULL);
+
+  // Apply the decisions
+  for (size_t j = 0; j < count; j++) {
+    // Get the GPU
+    unsigned int i = entries[j].index;
+    gpuState * state = &gpuStates[i];
+
+    // Track how long the GPU waits for the budget
+    if (!entries[j].wantsHigh || entries[j].granted) {
+      state->waitingSince = 0;
+    } else if (state->waitingSince == 0) {
+      state->waitingSince = now;
+
+      // Print message indicating the GPU is held back
+      printf("GPU %u is held below high performance state by the power budget\n", i);
+    }
+
+    // Publish the decision, the GPU applies it on its next tick
+    ATOMIC_STORE(&state->budgetDenied, !entries[j].granted);
+  }
+}
+
+static bool replace_string(char ** target, const char * value) {
+  // Copy the new value
+  char * copy = strdup(value);
+
+  // Check if the value was copied
+  if (copy == NULL) {
+    fprintf(stderr, "Unable to allocate memory for an option\n");
+    return false;
+  }
+
+  // Replace the previous value
+  free(*target);
+  *target = copy;
+
+  // Return true to indicate success
+  return true;
+}
+
+static void default_options(daemonOptions * target) {
+  // Clear all options
+  memset(target, 0, sizeof(*target));
+
+  // Set the defaults
+  target->ewmaWeight = EWMA_WEIGHT;
+  target->fanConnectTimeout = FAN_CONNECT_TIMEOUT;
+  target->fanReadTimeout = FAN_READ_TIMEOUT;
+  target->fanRetries = FAN_RETRIES;
+  target->fanScriptTimeout = FAN_SCRIPT_TIMEOUT;
+  target->holdTime = HOLD_TIME;
+  target->iterationsBeforeIdle = ITERATIONS_BEFORE_IDLE;
+  target->iterationsBeforeSwitch = ITERATIONS_BEFORE_SWITCH;
+  target->latencyWarning = LATENCY_WARNING;
+  target->performanceStateHigh = PERFORMANCE_STATE_HIGH;
+  target->performanceStateLow = PERFORMANCE_STATE_LOW;
+  target->sleepInterval = SLEEP_INTERVAL;
+  target->temperatureMargin = TEMPERATURE_MARGIN;
+  target->temperatureRereadInterval = TEMPERATURE_REREAD_INTERVAL;
+  target->temperatureThreshold = TEMPERATURE_THRESHOLD;
+  target->utilizationSampling = UTILIZATION_MODE_RATE;
+  target->utilizationThreshold = UTILIZATION_THRESHOLD;
+  target->utilizationThresholdDown = ULONG_MAX;
+  target->utilizationThresholdUp = ULONG_MAX;
+}
+
+static void free_options(daemonOptions * target) {
+  // Free the strings owned by the options
+  SAFE_FREE(target->configFile);
+  SAFE_FREE(target->coordinator);
+  SAFE_FREE(target->coordinatorNode);
+  SAFE_FREE(target->disableFanScript);
+  SAFE_FREE(target->disableFanUrl);
+  SAFE_FREE(target->enableFanScript);
+  SAFE_FREE(target->enableFanUrl);
+  SAFE_FREE(target->gangs);
+  SAFE_FREE(target->hintSocket);
+  SAFE_FREE(target->journal);
+  SAFE_FREE(target->metricsFile);
+  SAFE_FREE(target->metricsListen);
+  SAFE_FREE(target->recordFile);
+  SAFE_FREE(target->topologyCache);
+}
+
+static bool parse_options(daemonOptions * target, int argc, char * argv[], unsigned int * unknown) {
+  // Iterate through the arguments
+  for (unsigned int i = 1; i < argc; i++) {
+    // Check if the option is "-ew" or "--ewma-weight" and if there is a next argument
+    if ((IS_OPTION("-ew") || IS_OPTION("--ewma-weight")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in ewmaWeight
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->ewmaWeight), invalid);
+      continue;
+    }
+
+    // Check if the option is "-hs" or "--hint-socket" and if there is a next argument
+    if ((IS_OPTION("-hs") || IS_OPTION("--hint-socket")) && HAS_NEXT_ARG) {
+      // Copy it into hintSocket
+      ASSERT_TRUE(replace_string(&target->hintSocket, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-ht" or "--hold-time" and if there is a next argument
+    if ((IS_OPTION("-ht") || IS_OPTION("--hold-time")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in holdTime
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->holdTime), invalid);
+      continue;
+    }
+
+    // Check if the option is "-i" or "--ids" and if there is a next argument
+    if ((IS_OPTION("-i") || IS_OPTION("--ids")) && HAS_NEXT_ARG) {
+      // Parse the integer array option and store it in ids
+      ASSERT_TRUE(parse_ulong_array(argv[++i], ",", NVAPI_MAX_PHYSICAL_GPUS, target->ids, &target->idsCount), invalid);
+      continue;
+    }
+
+    // Check if the option is "-h" or "--help"
+    if ((IS_OPTION("-h") || IS_OPTION("--help"))) {
+      // Print usage instructions
+      goto invalid;
+    }
+
+    // Check if the option is "-c" or "--config" and if there is a next argument
+    if ((IS_OPTION("-c") || IS_OPTION("--config")) && HAS_NEXT_ARG) {
+      // Copy it into configFile
+      ASSERT_TRUE(replace_string(&target->configFile, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-co" or "--coordinator" and if there is a next argument
+    if ((IS_OPTION("-co") || IS_OPTION("--coordinator")) && HAS_NEXT_ARG) {
+      // Copy it into coordinator
+      ASSERT_TRUE(replace_string(&target->coordinator, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-cn" or "--coordinator-node" and if there is a next argument
+    if ((IS_OPTION("-cn") || IS_OPTION("--coordinator-node")) && HAS_NEXT_ARG) {
+      // Copy it into coordinatorNode
+      ASSERT_TRUE(replace_string(&target->coordinatorNode, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-dfs" or "("--disable-fan-script" and if there is a next argument
+    if ((IS_OPTION("-dfs") || IS_OPTION("--disable-fan-script")) && HAS_NEXT_ARG) {
+      // Copy it into disableFanScript
+      ASSERT_TRUE(replace_string(&target->disableFanScript, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-dfu" or "--disable-fan-url" and if there is a next argument
+    if ((IS_OPTION("-dfu") || IS_OPTION("--disable-fan-url")) && HAS_NEXT_ARG) {
+      // Validate the URL and copy it into disableFanUrl
+      ASSERT_TRUE(http_check_url(argv[i + 1]) && replace_string(&target->disableFanUrl, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-dut" or "--decoder-utilization-threshold" and if there is a next argument
+    if ((IS_OPTION("-dut") || IS_OPTION("--decoder-utilization-threshold")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in decoderUtilizationThreshold
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->decoderUtilizationThreshold), invalid);
+      continue;
+    }
+
+    // Check if the option is "-efs" or --enable-fan-script" and if there is a next argument
+    if ((IS_OPTION("-efs") || IS_OPTION("--enable-fan-script")) && HAS_NEXT_ARG) {
+      // Copy it into enableFanScript
+      ASSERT_TRUE(replace_string(&target->enableFanScript, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-efu" or "--enable-fan-url" and if there is a next argument
+    if ((IS_OPTION("-efu") || IS_OPTION("--enable-fan-url")) && HAS_NEXT_ARG) {
+      // Validate the URL and copy it into enableFanUrl
+      ASSERT_TRUE(http_check_url(argv[i + 1]) && replace_string(&target->enableFanUrl, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-eut" or "--encoder-utilization-threshold" and if there is a next argument
+    if ((IS_OPTION("-eut") || IS_OPTION("--encoder-utilization-threshold")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in encoderUtilizationThreshold
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->encoderUtilizationThreshold), invalid);
+      continue;
+    }
+
+    // Check if the option is "-fct" or "--fan-connect-timeout" and if there is a next argument
+    if ((IS_OPTION("-fct") || IS_OPTION("--fan-connect-timeout")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in fanConnectTimeout
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->fanConnectTimeout), invalid);
+      continue;
+    }
+
+    // Check if the option is "-fr" or "--fan-retries" and if there is a next argument
+    if ((IS_OPTION("-fr") || IS_OPTION("--fan-retries")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in fanRetries
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->fanRetries), invalid);
+      continue;
+    }
+
+    // Check if the option is "-frt" or "--fan-read-timeout" and if there is a next argument
+    if ((IS_OPTION("-frt") || IS_OPTION("--fan-read-timeout")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in fanReadTimeout
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->fanReadTimeout), invalid);
+      continue;
+    }
+
+    // Check if the option is "-fst" or "--fan-script-timeout" and if there is a next argument
+    if ((IS_OPTION("-fst") || IS_OPTION("--fan-script-timeout")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in fanScriptTimeout
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->fanScriptTimeout), invalid);
+      continue;
+    }
+
+    // Check if the option is "-g" or "--gangs" and if there is a next argument
+    if ((IS_OPTION("-g") || IS_OPTION("--gangs")) && HAS_NEXT_ARG) {
+      // Copy it into gangs
+      ASSERT_TRUE(replace_string(&target->gangs, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-ibi" or "--iterations-before-idle" and if there is a next argument
+    if ((IS_OPTION("-ibi") || IS_OPTION("--iterations-before-idle")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in iterationsBeforeIdle
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->iterationsBeforeIdle), invalid);
+      continue;
+    }
+
+    // Check if the option is "-ibs" or "--iterations-before-switch" and if there is a next argument
+    if ((IS_OPTION("-ibs") || IS_OPTION("--iterations-before-switch")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in iterationsBeforeSwitch
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->iterationsBeforeSwitch), invalid);
+      continue;
+    }
+
+    // Check if the option is "-j" or "--journal" and if there is a next argument
+    if ((IS_OPTION("-j") || IS_OPTION("--journal")) && HAS_NEXT_ARG) {
+      // Copy it into journal
+      ASSERT_TRUE(replace_string(&target->journal, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-ld" or "--ladder" and if there is a next argument
+    if ((IS_OPTION("-ld") || IS_OPTION("--ladder")) && HAS_NEXT_ARG) {
+      // Parse the steps and store them in ladder
+      ASSERT_TRUE(policy_parse_ladder(argv[++i], target->ladder, &target->ladderSteps), invalid);
+      continue;
+    }
+
+    // Check if the option is "-lt" or "--lazy-temperature"
+    if ((IS_OPTION("-lt") || IS_OPTION("--lazy-temperature"))) {
+      // Enable lazy temperature sampling
+      target->lazyTemperature = true;
+      continue;
+    }
+
+    // Check if the option is "-lw" or "--latency-warning" and if there is a next argument
+    if ((IS_OPTION("-lw") || IS_OPTION("--latency-warning")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in latencyWarning
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->latencyWarning), invalid);
+      continue;
+    }
+
+    // Check if the option is "-mut" or "--memory-utilization-threshold" and if there is a next argument
+    if ((IS_OPTION("-mut") || IS_OPTION("--memory-utilization-threshold")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in memoryUtilizationThreshold
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->memoryUtilizationThreshold), invalid);
+      continue;
+    }
+
+    // Check if the option is "-maxsi" or "--max-sleep-interval" and if there is a next argument
+    if ((IS_OPTION("-maxsi") || IS_OPTION("--max-sleep-interval")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in maxSleepInterval
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->maxSleepInterval), invalid);
+      continue;
+    }
+
+    // Check if the option is "-mf" or "--metrics-file" and if there is a next argument
+    if ((IS_OPTION("-mf") || IS_OPTION("--metrics-file")) && HAS_NEXT_ARG) {
+      // Copy it into metricsFile
+      ASSERT_TRUE(replace_string(&target->metricsFile, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-minsi" or "--min-sleep-interval" and if there is a next argument
+    if ((IS_OPTION("-minsi") || IS_OPTION("--min-sleep-interval")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in minSleepInterval
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->minSleepInterval), invalid);
+      continue;
+    }
+
+    // Check if the option is "-ml" or "--metrics-listen" and if there is a next argument
+    if ((IS_OPTION("-ml") || IS_OPTION("--metrics-listen")) && HAS_NEXT_ARG) {
+      // Copy it into metricsListen
+      ASSERT_TRUE(replace_string(&target->metricsListen, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-p" or "--policy" and if there is a next argument
+    if ((IS_OPTION("-p") || IS_OPTION("--policy")) && HAS_NEXT_ARG) {
+      // Look up the policy and store it in pstatePolicy
+      target->pstatePolicy = policy_find(argv[++i]);
+
+      // Check if the policy exists
+      ASSERT_TRUE(target->pstatePolicy != NULL, invalid);
+      continue;
+    }
+
+    // Check if the option is "-pb" or "--power-budget" and if there is a next argument
+    if ((IS_OPTION("-pb") || IS_OPTION("--power-budget")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in powerBudget
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->powerBudget), invalid);
+      continue;
+    }
+
+    // Check if the option is "-pct" or "--process-count-threshold" and if there is a next argument
+    if ((IS_OPTION("-pct") || IS_OPTION("--process-count-threshold")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in processCountThreshold
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->processCountThreshold), invalid);
+      continue;
+    }
+
+    // Check if the option is "-psh" or "--performance-state-high" and if there is a next argument
+    if ((IS_OPTION("-psh") || IS_OPTION("--performance-state-high")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in performanceStateHigh
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->performanceStateHigh), invalid);
+      continue;
+    }
+
+    // Check if the option is "-psl" or "--performance-state-low" and if there is a next argument
+    if ((IS_OPTION("-psl") || IS_OPTION("--performance-state-low")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in performanceStateLow
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->performanceStateLow), invalid);
+      continue;
+    }
+
+    // Check if the option is "-pt" or "--process-trigger"
+    if ((IS_OPTION("-pt") || IS_OPTION("--process-trigger"))) {
+      // Enable process launch detection
+      target->processTrigger = true;
+      continue;
+    }
+
+    // Check if the option is "-ptt" or "--pcie-throughput-threshold" and if there is a next argument
+    if ((IS_OPTION("-ptt") || IS_OPTION("--pcie-throughput-threshold")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in pcieThroughputThreshold
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->pcieThroughputThreshold), invalid);
+      continue;
+    }
+
+    // Check if the option is "-r" or "--record" and if there is a next argument
+    if ((IS_OPTION("-r") || IS_OPTION("--record")) && HAS_NEXT_ARG) {
+      // Copy it into recordFile
+      ASSERT_TRUE(replace_string(&target->recordFile, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-s" or "--service"
+    if ((IS_OPTION("-s") || IS_OPTION("--service"))) {
+      // Skip option
+      continue;
+    }
+
+    // Check if the option is "-si" or "--sleep-interval" and if there is a next argument
+    if ((IS_OPTION("-si") || IS_OPTION("--sleep-interval")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in sleepInterval
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->sleepInterval), invalid);
+      continue;
+    }
+
+    // Check if the option is "-t" or "--threads"
+    if ((IS_OPTION("-t") || IS_OPTION("--threads"))) {
+      // Enable threaded mode
+      target->threaded = true;
+      continue;
+    }
+
+    // Check if the option is "-tc" or "--topology-cache" and if there is a next argument
+    if ((IS_OPTION("-tc") || IS_OPTION("--topology-cache")) && HAS_NEXT_ARG) {
+      // Copy it into topologyCache
+      ASSERT_TRUE(replace_string(&target->topologyCache, argv[++i]), invalid);
+      continue;
+    }
+
+    // Check if the option is "-tm" or "--temperature-margin" and if there is a next argument
+    if ((IS_OPTION("-tm") || IS_OPTION("--temperature-margin")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in temperatureMargin
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->temperatureMargin), invalid);
+      continue;
+    }
+
+    // Check if the option is "-tri" or "--temperature-reread-interval" and if there is a next argument
+    if ((IS_OPTION("-tri") || IS_OPTION("--temperature-reread-interval")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in temperatureRereadInterval
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->temperatureRereadInterval), invalid);
+      continue;
+    }
+
+    // Check if the option is "-tt" or "--temperature-threshold" and if there is a next argument
+    if ((IS_OPTION("-tt") || IS_OPTION("--temperature-threshold")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in temperatureThreshold
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->temperatureThreshold), invalid);
+      continue;
+    }
+
+    // Check if the option is "-um" or "--utilization-mode" and if there is a next argument
+    if ((IS_OPTION("-um") || IS_OPTION("--utilization-mode")) && HAS_NEXT_ARG) {
+      // Get the mode name
+      const char * mode = argv[++i];
+
+      // Parse the mode and store it in utilizationSampling
+      if (strcmp(mode, "rate") == 0) {
+        target->utilizationSampling = UTILIZATION_MODE_RATE;
+      } else if (strcmp(mode, "max") == 0) {
+        target->utilizationSampling = UTILIZATION_MODE_MAX;
+      } else if (strcmp(mode, "mean") == 0) {
+        target->utilizationSampling = UTILIZATION_MODE_MEAN;
+      } else {
+        goto invalid;
+      }
+
+      continue;
+    }
+
+    // Check if the option is "-ut" or "--utilization-threshold" and if there is a next argument
+    if ((IS_OPTION("-ut") || IS_OPTION("--utilization-threshold")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in utilizationThreshold
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->utilizationThreshold), invalid);
+      continue;
+    }
+
+    // Check if the option is "-utd" or "--utilization-threshold-down" and if there is a next argument
+    if ((IS_OPTION("-utd") || IS_OPTION("--utilization-threshold-down")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in utilizationThresholdDown
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->utilizationThresholdDown), invalid);
+      continue;
+    }
+
+    // Check if the option is "-utu" or "--utilization-threshold-up" and if there is a next argument
+    if ((IS_OPTION("-utu") || IS_OPTION("--utilization-threshold-up")) && HAS_NEXT_ARG) {
+      // Parse the integer option and store it in utilizationThresholdUp
+      ASSERT_TRUE(parse_ulong(argv[++i], &target->utilizationThresholdUp), invalid);
+      continue;
+    }
+
+    // Count the arguments that are not options
+    (*unknown)++;
+  }
+
+  // Return true to indicate success
+  return true;
+
+  invalid:
+  // Return false to indicate an invalid option
+  return false;
+}
+
+static void print_usage(const char * program) {
+  printf("Usage: %s [options]\n", program);
+  printf("\n");
+  printf("Options:\n");
+  printf("  -c, --config <value>                      Read the options from this file, reloaded on SIGHUP (default: none)\n");
+
+  #ifdef __linux__
+    printf("  -cn, --coordinator-node <value>           Name this node reports to the coordinator (default: host name)\n");
+    printf("  -co, --coordinator <value>                Share the power budget through the coordinator at this address: host:port or unix:<path> (default: none)\n");
+  #endif
+
+  printf("  -dfs, --disable-fan-script <value>        Script to run when the GPU fan should be disabled (default: none)\n");
+
+  #ifdef __linux__
+    printf("  -dfu, --disable-fan-url <value>           URL to request instead of running the disable script (default: none)\n");
+  #endif
+
+  printf("  -dut, --decoder-utilization-threshold <value> Treat the GPU as busy while its decoder utilization in percentage is above this value, 0 to disable (default: 0)\n");
+  printf("  -efs, --enable-fan-script <value>         Script to run when the GPU fan should be enabled (default: none)\n");
+
+  #ifdef __linux__
+    printf("  -efu, --enable-fan-url <value>            URL to request instead of running the enable script (default: none)\n");
+  #endif
+
+  printf("  -eut, --encoder-utilization-threshold <value> Treat the GPU as busy while its encoder utilization in percentage is above this value, 0 to disable (default: 0)\n");
+  printf("  -ew, --ewma-weight <value>                Set the weight of the newest sample in percentage for the ewma policy (default: %u)\n", EWMA_WEIGHT);
+
+  #ifdef __linux__
+    printf("  -fct, --fan-connect-timeout <value>       Set the time in milliseconds allowed to connect to a fan URL (default: %u)\n", FAN_CONNECT_TIMEOUT);
+    printf("  -fr, --fan-retries <value>                Set the number of retries of a failed fan URL request (default: %u)\n", FAN_RETRIES);
+    printf("  -frt, --fan-read-timeout <value>          Set the time in milliseconds allowed between two reads of a fan URL response (default: %u)\n", FAN_READ_TIMEOUT);
+  #endif
+
+  printf("  -fst, --fan-script-timeout <value>        Kill a fan script still running after this many milliseconds, 0 to never kill it (default: %u)\n", FAN_SCRIPT_TIMEOUT);
+  printf("  -g, --gangs <value>                       Switch groups of GPUs together, as <id>+<id>[+<id>...][,...] or auto to group linked GPUs (default: none)\n");
+
+  #ifdef __linux__
+    printf("  -hs, --hint-socket <value>                Listen for performance state leases on this UNIX socket (default: none)\n");
+  #endif
+
+  printf("  -ht, --hold-time <value>                  Set the time in milliseconds to stay in high performance state after the GPU was last busy for the ewma policy (default: %u)\n", HOLD_TIME);
+  printf("  -i, --ids <value><,value...>              Set the GPU(s) to control (default: all)\n");
+  printf("  -ibi, --iterations-before-idle <value>    Set the number of iterations to wait before considering disabling the fan (default: %u)\n", ITERATIONS_BEFORE_IDLE);
+  printf("  -ibs, --iterations-before-switch <value>  Set the number of iterations to wait before switching states (default: %u)\n", ITERATIONS_BEFORE_SWITCH);
+  printf("  -j, --journal <value>                     Keep the state of the GPUs in this file, to resume it after a restart (default: none)\n");
+  printf("  -ld, --ladder <value><,value...>          Set the steps of the ladder policy as <pstate> then <pstate>:<utilization>[:<hold time>] (default: none)\n");
+  printf("  -lt, --lazy-temperature                   Skip temperature reads while the GPU can't have come within --temperature-margin of the threshold\n");
+  printf("  -lw, --latency-warning <value>            Warn about driver calls slower than this many milliseconds, 0 to disable (default: %u)\n", LATENCY_WARNING);
+  printf("  -maxsi, --max-sleep-interval <value>      Set the longest sleep interval in milliseconds when all GPUs are idle (default: --sleep-interval)\n");
+  printf("  -mut, --memory-utilization-threshold <value> Treat the GPU as busy while its memory controller utilization in percentage is above this value, 0 to disable (default: 0)\n");
+  printf("  -mf, --metrics-file <value>               Write Prometheus metrics to this file for the textfile collector (default: none)\n");
+  printf("  -minsi, --min-sleep-interval <value>      Set the shortest sleep interval in milliseconds when any GPU is active (default: --sleep-interval)\n");
+
+  #ifdef __linux__
+    printf("  -ml, --metrics-listen <value>             Serve Prometheus metrics over HTTP on this [address:]port (default: none)\n");
+  #endif
+
+  printf("  -p, --policy <value>                      Set the performance state policy: iterations, ewma or ladder (default: iterations)\n");
+  printf("  -pb, --power-budget <value>               Hold GPUs below high performance state to keep the node under this many watts, 0 to disable (default: 0)\n");
+  printf("  -pct, --process-count-threshold <value>   Treat the GPU as busy while at least this many compute processes run on it, 0 to disable (default: 0)\n");
+  printf("  -psh, --performance-state-high <value>    Set the high performance state for the GPU (default: %u)\n", PERFORMANCE_STATE_HIGH);
+  printf("  -psl, --performance-state-low <value>     Set the low performance state for the GPU (default: %u)\n", PERFORMANCE_STATE_LOW);
+  printf("  -pt, --process-trigger                    Switch to high performance state as soon as a new compute process appears on the GPU\n");
+  printf("  -ptt, --pcie-throughput-threshold <value> Treat the GPU as busy while its PCIe throughput in MB/s is above this value, 0 to disable (default: 0)\n");
+  printf("  -r, --record <value>                      Append the samples and decisions to this file for nvidia-pstated-replay (default: none)\n");
+
+  #ifdef _WIN32
+    printf("  -s, --service                             Run as a Windows service\n");
+  #endif
+
+  printf("  -si, --sleep-interval <value>             Set the sleep interval in milliseconds between utilization checks (default: %u)\n", SLEEP_INTERVAL);
+
+  #ifdef __linux__
+    printf("  -t, --threads                             Monitor each GPU on its own thread\n");
+  #endif
+
+  printf("  -tc, --topology-cache <value>             Reuse the GPU matching stored in this file while the driver and GPUs are unchanged (default: none)\n");
+
+  printf("  -tm, --temperature-margin <value>         Set the safety margin in degrees C for --lazy-temperature (default: %u)\n", TEMPERATURE_MARGIN);
+  printf("  -tri, --temperature-reread-interval <value> Set the longest time in milliseconds between temperature reads for --lazy-temperature (default: %u)\n", TEMPERATURE_REREAD_INTERVAL);
+  printf("  -tt, --temperature-threshold <value>      Set the temperature threshold in degrees C (default: %u)\n", TEMPERATURE_THRESHOLD);
+  printf("  -um, --utilization-mode <value>           Set how utilization is sampled: rate, or max/mean of the samples since the previous poll (default: rate)\n");
+  printf("  -ut, --utilization-threshold <value>      Set the utilization threshold in percentage (default: %u)\n", UTILIZATION_THRESHOLD);
+  printf("  -utd, --utilization-threshold-down <value> Set the average utilization in percentage at or below which the ewma policy starts the hold time (default: --utilization-threshold)\n");
+  printf("  -utu, --utilization-threshold-up <value>  Set the average utilization in percentage above which the ewma policy switches to high performance state (default: --utilization-threshold)\n");
+}
+
+static bool resolve_settings(const daemonOptions * source, controlConfig * target) {
+  // Clear the settings
+  memset(target, 0, sizeof(*target));
+
+  // The weight of the newest sample can't exceed 100%
+  if (source->ewmaWeight == 0 || source->ewmaWeight > 100) {
+    fprintf(stderr, "Invalid ewma weight: %lu, expected 1..100\n", source->ewmaWeight);
+    return false;
+  }
+
+  // If the policy is not specified, use the iteration counting policy
+  target->pstatePolicy = source->pstatePolicy != NULL ? source->pstatePolicy : policy_find("iterations");
+
+  // Fill the policy configuration, the up and down thresholds default to the utilization threshold
+  target->policyConfiguration.iterationsBeforeSwitch = source->iterationsBeforeSwitch;
+  target->policyConfiguration.utilizationThreshold = source->utilizationThreshold;
+  target->policyConfiguration.utilizationThresholdUp = source->utilizationThresholdUp == ULONG_MAX ? source->utilizationThreshold : source->utilizationThresholdUp;
+  target->policyConfiguration.utilizationThresholdDown = source->utilizationThresholdDown == ULONG_MAX ? source->utilizationThreshold : source->utilizationThresholdDown;
+  target->policyConfiguration.ewmaWeight = source->ewmaWeight;
+  target->policyConfiguration.holdTime = source->holdTime;
+  target->policyConfiguration.performanceStateHigh = source->performanceStateHigh;
+  target->policyConfiguration.performanceStateLow = source->performanceStateLow;
+
+  // The ladder policy takes its performance states from the ladder
+  if (strcmp(target->pstatePolicy->name, "ladder") == 0) {
+    // Check if the ladder is given
+    if (source->ladderSteps == 0) {
+      fprintf(stderr, "The ladder policy needs --ladder\n");
+      return false;
+    }
+
+    // Fill the steps
+    policy_set_ladder(&target->policyConfiguration, source->ladder, source->ladderSteps);
+  }
+
+  // Store the temperature threshold
+  target->temperatureThreshold = source->temperatureThreshold;
+
+  // Return true to indicate success
+  return true;
+}
+
+static bool apply_config_entry(daemonOptions * target, const configFile * file, const configEntry * entry) {
+  // Options that only make sense on the command line
+  if (strcmp(entry->key, "config") == 0 || strcmp(entry->key, "help") == 0 || strcmp(entry->key, "service") == 0) {
+    fprintf(stderr, "%s:%u: %s can only be given on the command line\n", file->path, entry->line, entry->key);
+    return false;
+  }
+
+  // Build the option as it would be written on the command line
+  char option[CONFIG_LINE_MAX + 2];
+  snprintf(option, sizeof(option), "--%s", entry->key);
+
+  // Arguments holding the option, with the file in place of the program name
+  char * argv[] = { file->path, option, entry->value };
+  int argc = entry->value != NULL ? 3 : 2;
+
+  // Number of arguments that are not options
+  unsigned int unknown = 0;
+
+  // Parse the option
+  if (!parse_options(target, argc, argv, &unknown)) {
+    fprintf(stderr, "%s:%u: invalid value for %s\n", file->path, entry->line, entry->key);
+    return false;
+  }
+
+  // Reject unknown options, flags given a value and options missing one
+  if (unknown != 0) {
+    fprintf(stderr, "%s:%u: unknown option %s%s\n", file->path, entry->line, entry->key, entry->value != NULL ? " or unexpected value" : " or missing value");
+    return false;
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+static bool is_gpu_option(const char * key) {
+  // Look for the key among the options that can be set per GPU
+  for (const char * const * name = gpuOptionNames; *name != NULL; name++) {
+    if (strcmp(*name, key) == 0) {
+      return true;
+    }
+  }
+
+  // The option applies to the whole daemon
+  return false;
+}
+
+static bool load_options(int argc, char * argv[], daemonOptions * target, controlConfig * settings) {
+  // Start from the defaults
+  default_options(target);
+
+  // Parsed configuration file
+  configFile * file = NULL;
+
+  // Arguments that are not options are ignored on the command line
+  unsigned int unknown = 0;
+
+  // Parse the command line, which also finds the configuration file
+  if (!parse_options(target, argc, argv, &unknown)) {
+    // Display usage instructions to the user
+    print_usage(argv[0]);
+
+    // Jump to the failure label
+    goto failure;
+  }
+
+  // If a configuration file is specified
+  if (target->configFile != NULL) {
+    // Read the file
+    file = config_read(target->configFile);
+
+    // Check if the file was read
+    if (file == NULL) {
+      goto failure;
+    }
+
+    // Loop through the settings of the file
+    for (size_t i = 0; i < file->count; i++) {
+      // Get the setting
+      const configEntry * entry = &file->entries[i];
+
+      // Settings of GPUs are applied on top of the global options below
+      if (entry->gpu != CONFIG_GLOBAL) {
+        // Validate the GPU id
+        if (entry->gpu >= NVAPI_MAX_PHYSICAL_GPUS) {
+          fprintf(stderr, "%s:%u: invalid GPU id: %u\n", file->path, entry->line, entry->gpu);
+          goto failure;
+        }
+
+        // Only some options can differ between GPUs
+        if (!is_gpu_option(entry->key)) {
+          fprintf(stderr, "%s:%u: %s can't be set for a single GPU\n", file->path, entry->line, entry->key);
+          goto failure;
+        }
+
+        continue;
+      }
+
+      // Apply the global setting
+      ASSERT_TRUE(apply_config_entry(target, file, entry), failure);
+    }
+
+    // Options given on the command line take precedence over the file
+    ASSERT_TRUE(parse_options(target, argc, argv, &unknown), failure);
+  }
+
+  // Resolve the settings of each GPU
+  for (unsigned int i = 0; i < NVAPI_MAX_PHYSICAL_GPUS; i++) {
+    // Start from the global options, without taking ownership of their strings
+    daemonOptions gpuOptions = *target;
+
+    // Apply the section of the GPU
+    for (size_t j = 0; file != NULL && j < file->count; j++) {
+      if (file->entries[j].gpu == i) {
+        ASSERT_TRUE(apply_config_entry(&gpuOptions, file, &file->entries[j]), failure);
+      }
+    }
+
+    // Resolve the settings
+    ASSERT_TRUE(resolve_settings(&gpuOptions, &settings[i]), failure);
+  }
+
+  // If the shortest sleep interval is not specified, use the sleep interval
+  if (target->minSleepInterval == 0) {
+    target->minSleepInterval = target->sleepInterval;
+  }
+
+  // If the longest sleep interval is not specified, use the sleep interval
+  if (target->maxSleepInterval == 0) {
+    target->maxSleepInterval = target->sleepInterval;
+  }
+
+  // Validate the bounds here, so a reload can reject them before applying anything
+  if (target->minSleepInterval == 0 || target->maxSleepInterval < target->minSleepInterval) {
+    fprintf(stderr, "Invalid sleep interval bounds: %lu..%lu\n", target->minSleepInterval, target->maxSleepInterval);
+    goto failure;
+  }
+
+  // Free the configuration file
+  config_free(file);
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Free the configuration file
+  config_free(file);
+
+  // Return false to indicate failure
+  return false;
+}
+
+static const char * format_ladder(const policyConfig * config, char * buffer, size_t size) {
+  // Only the ladder policy has steps
+  if (config->ladderSteps == 0) {
+    return "N/A";
+  }
+
+  // Number of characters written so far
+  size_t length = 0;
+
+  // Write each step, the first one has no band
+  for (size_t i = 0; i < config->ladderSteps && length < size; i++) {
+    if (i == 0) {
+      length += snprintf(buffer + length, size - length, "%lu", config->ladder[i].pstateId);
+    } else {
+      length += snprintf(buffer + length, size - length, ",%lu:%lu:%lu", config->ladder[i].pstateId, config->ladder[i].utilization, config->ladder[i].holdTime);
+    }
+  }
+
+  // Return the formatted ladder
+  return buffer;
+}
+
+static void print_options(void) {
+  // Print ids
+  {
+    // Print the initial text
+    printf("ids = ");
+
+    // Loop through each element in the array
+    for (size_t i = 0; i < options.idsCount; i++) {
+      // Print the current element with %lu for unsigned long
+      printf("%lu", options.ids[i]);
+
+      // If this is not the last element
+      if (i + 1 < options.idsCount) {
+        // Print a comma
+        printf(",");
+      }
+    }
+
+    // If array is empty
+    if (options.idsCount == 0) {
+      // Print "N/A"
+      printf("N/A");
+    }
+
+    // Print the count of elements in the array and newline character
+    printf(" (%zu)\n", options.idsCount);
+  }
+
+  // Settings of GPUs without their own section
+  controlConfig defaults;
+  resolve_settings(&options, &defaults);
+
+  // Buffer to hold the formatted ladder
+  char ladder[LADDER_STEPS_MAX * 32];
+
+  // Print remaining variables
+  printf("configFile = %s\n", options.configFile ? options.configFile : "N/A");
+  printf("coordinator = %s\n", options.coordinator ? options.coordinator : "N/A");
+  printf("coordinatorNode = %s\n", options.coordinatorNode ? options.coordinatorNode : "N/A");
+  printf("decoderUtilizationThreshold = %lu\n", options.decoderUtilizationThreshold);
+  printf("disableFanScript = %s\n", options.disableFanScript ? options.disableFanScript : "N/A");
+  printf("disableFanUrl = %s\n", options.disableFanUrl ? options.disableFanUrl : "N/A");
+  printf("enableFanScript = %s\n", options.enableFanScript ? options.enableFanScript : "N/A");
+  printf("enableFanUrl = %s\n", options.enableFanUrl ? options.enableFanUrl : "N/A");
+  printf("encoderUtilizationThreshold = %lu\n", options.encoderUtilizationThreshold);
+  printf("ewmaWeight = %lu\n", options.ewmaWeight);
+  printf("fanConnectTimeout = %lu\n", options.fanConnectTimeout);
+  printf("fanReadTimeout = %lu\n", options.fanReadTimeout);
+  printf("fanRetries = %lu\n", options.fanRetries);
+  printf("fanScriptTimeout = %lu\n", options.fanScriptTimeout);
+  printf("gangs = %s\n", options.gangs ? options.gangs : "N/A");
+  printf("hintSocket = %s\n", options.hintSocket ? options.hintSocket : "N/A");
+  printf("holdTime = %lu\n", options.holdTime);
+  printf("iterationsBeforeIdle = %lu\n", options.iterationsBeforeIdle);
+  printf("iterationsBeforeSwitch = %lu\n", options.iterationsBeforeSwitch);
+  printf("journal = %s\n", options.journal ? options.journal : "N/A");
+  printf("ladder = %s\n", format_ladder(&defaults.policyConfiguration, ladder, sizeof(ladder)));
+  printf("latencyWarning = %lu\n", options.latencyWarning);
+  printf("lazyTemperature = %s\n", options.lazyTemperature ? "true" : "false");
+  printf("maxSleepInterval = %lu\n", options.maxSleepInterval);
+  printf("memoryUtilizationThreshold = %lu\n", options.memoryUtilizationThreshold);
+  printf("metricsFile = %s\n", options.metricsFile ? options.metricsFile : "N/A");
+  printf("metricsListen = %s\n", options.metricsListen ? options.metricsListen : "N/A");
+  printf("minSleepInterval = %lu\n", options.minSleepInterval);
+  printf("pcieThroughputThreshold = %lu\n", options.pcieThroughputThreshold);
+  printf("performanceStateHigh = %lu\n", defaults.policyConfiguration.performanceStateHigh);
+  printf("performanceStateLow = %lu\n", defaults.policyConfiguration.performanceStateLow);
+  printf("policy = %s\n", defaults.pstatePolicy->name);
+  printf("powerBudget = %lu\n", options.powerBudget);
+  printf("processCountThreshold = %lu\n", options.processCountThreshold);
+  printf("processTrigger = %s\n", options.processTrigger ? "true" : "false");
+  printf("recordFile = %s\n", options.recordFile ? options.recordFile : "N/A");
+  printf("sleepInterval = %lu\n", options.sleepInterval);
+  printf("temperatureMargin = %lu\n", options.temperatureMargin);
+  printf("temperatureRereadInterval = %lu\n", options.temperatureRereadInterval);
+  printf("temperatureThreshold = %lu\n", options.temperatureThreshold);
+  printf("threaded = %s\n", options.threaded ? "true" : "false");
+  printf("topologyCache = %s\n", options.topologyCache ? options.topologyCache : "N/A");
+  printf("utilizationMode = %s\n", options.utilizationSampling == UTILIZATION_MODE_MAX ? "max" : options.utilizationSampling == UTILIZATION_MODE_MEAN ? "mean" : "rate");
+  printf("utilizationThreshold = %lu\n", options.utilizationThreshold);
+  printf("utilizationThresholdDown = %lu\n", defaults.policyConfiguration.utilizationThresholdDown);
+  printf("utilizationThresholdUp = %lu\n", defaults.policyConfiguration.utilizationThresholdUp);
+
+  // Print the GPUs whose section overrides the global options
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    // Get the settings of the GPU
+    const controlConfig * settings = &gpuStates[i].settings;
+
+    // Skip GPUs using the global options
+    if (memcmp(settings, &defaults, sizeof(defaults)) == 0) {
+      continue;
+    }
+
+    // Print the settings of the GPU
+    printf("GPU %u: policy = %s, ladder = %s, performanceStateHigh = %lu, performanceStateLow = %lu, temperatureThreshold = %lu, utilizationThreshold = %lu, utilizationThresholdDown = %lu, utilizationThresholdUp = %lu\n",
+      i,
+      settings->pstatePolicy->name,
+      format_ladder(&settings->policyConfiguration, ladder, sizeof(ladder)),
+      settings->policyConfiguration.performanceStateHigh,
+      settings->policyConfiguration.performanceStateLow,
+      settings->temperatureThreshold,
+      settings->policyConfiguration.utilizationThreshold,
+      settings->policyConfiguration.utilizationThresholdDown,
+      settings->policyConfiguration.utilizationThresholdUp);
+  }
+}
+
+static bool select_managed(const daemonOptions * source, bool * managed) {
+  // Check if there are specific GPU ids to process
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    managed[i] = source->idsCount == 0;
+  }
+
+  // Iterate over each provided id
+  for (size_t i = 0; i < source->idsCount; i++) {
+    // Get the current id
+    unsigned long id = source->ids[i];
+
+    // Validate the id
+    if (id >= deviceCount) {
+      // Print error message for invalid id
+      printf("Invalid GPU id: %lu\n", id);
+
+      // Skip to the next id
+      continue;
+    }
+
+    // Mark the GPU as managed
+    managed[id] = true;
+  }
+
+  // Look for a managed GPU
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (managed[i]) {
+      return true;
+    }
+  }
+
+  // If no GPUs are managed, report an error
+  printf("Can't find GPUs to manage!\n");
+
+  // Return false to indicate failure
+  return false;
+}
+
+static bool is_policy_pstate(const policyConfig * config, unsigned int pstateId) {
+  // The low and high performance states are always used
+  if (pstateId == config->performanceStateLow || pstateId == config->performanceStateHigh) {
+    return true;
+  }
+
+  // Look for the performance state in the ladder
+  for (size_t j = 0; j < config->ladderSteps; j++) {
+    if (config->ladder[j].pstateId == pstateId) {
+      return true;
+    }
+  }
+
+  // Return false if the policy never switches to the performance state
+  return false;
+}
+
+static bool check_pstates(unsigned int i, const controlConfig * settings) {
+  // Get the configuration of the policy
+  const policyConfig * config = &settings->policyConfiguration;
+
+  // Performance states supported by the GPU
+  nvmlPstates_t supported[NVML_MAX_GPU_PERF_PSTATES];
+
+  // Variable to hold the result
+  nvmlReturn_t result;
+
+  // Attribute the driver call to the GPU
+  latency_set_gpu(i);
+
+  // Retrieve the supported performance states, they can't be checked if the driver doesn't report them
+  LATENCY_CALL(result, nvmlDeviceGetSupportedPerformanceStates(nvmlDevices[i], supported, sizeof(supported)));
+
+  if (result != NVML_SUCCESS) {
+    return true;
+  }
+
+  // Performance states the GPU may be switched to
+  unsigned long pstates[LADDER_STEPS_MAX + 2] = { config->performanceStateLow, config->performanceStateHigh };
+  size_t count = 2;
+
+  for (size_t j = 0; j < config->ladderSteps; j++) {
+    pstates[count++] = config->ladder[j].pstateId;
+  }
+
+  // Check each performance state
+  for (size_t j = 0; j < count; j++) {
+    // Automatic management is always available
+    bool found = pstates[j] == 16;
+
+    // Look for the performance state, the list ends with an unknown state
+    for (size_t k = 0; !found && k < NVML_MAX_GPU_PERF_PSTATES && supported[k] != NVML_PSTATE_UNKNOWN; k++) {
+      found = (unsigned long) supported[k] == pstates[j];
+    }
+
+    // Report an unsupported performance state
+    if (!found) {
+      fprintf(stderr, "GPU %u doesn't support performance state %lu\n", i, pstates[j]);
+      return false;
+    }
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+static unsigned int wanted_metrics(void) {
+  // Only the temperature is needed by default
+  unsigned int metrics = 0;
+
+  // The extra metrics are only read when exported
+  if (options.metricsFile != NULL || options.metricsListen != NULL) {
+    metrics |= TELEMETRY_MASK(TELEMETRY_MEMORY_TEMPERATURE) | TELEMETRY_MASK(TELEMETRY_POWER);
+  }
+
+  // The coordinator and the power budget need the power draw
+  if (options.coordinator != NULL || options.powerBudget != 0) {
+    metrics |= TELEMETRY_MASK(TELEMETRY_POWER);
+  }
+
+  // Each busy signal is only read when enabled, the PCIe throughput takes 40 ms per read on drivers without its byte counters
+  if (options.pcieThroughputThreshold != 0) {
+    metrics |= TELEMETRY_MASK(TELEMETRY_PCIE_THROUGHPUT);
+  }
+
+  if (options.encoderUtilizationThreshold != 0) {
+    metrics |= TELEMETRY_MASK(TELEMETRY_ENCODER_UTILIZATION);
+  }
+
+  if (options.decoderUtilizationThreshold != 0) {
+    metrics |= TELEMETRY_MASK(TELEMETRY_DECODER_UTILIZATION);
+  }
+
+  // Process launch detection counts the processes on its own
+  if (options.processCountThreshold != 0 && !options.processTrigger) {
+    metrics |= TELEMETRY_MASK(TELEMETRY_PROCESSES);
+  }
+
+  // Return the mask of the metrics
+  return metrics;
+}
+
+static void apply_lazy_temperature(void) {
+  // Each GPU skips temperature reads against its own threshold
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    telemetry_set_lazy_temperature(i, options.lazyTemperature, gpuStates[i].settings.temperatureThreshold, options.temperatureMargin, options.temperatureRereadInterval);
+  }
+}
+
+static void save_journal(unsigned int i) {
+  // Get the current state of the GPU
+  gpuState * state = &gpuStates[i];
+
+  // Describe the GPU
+  journalGpu entry = { state->managed, state->pstateId, state->policy.iterations, state->policy.busyTime };
+
+  // Write it, each GPU only from the thread ticking it
+  journal_write_gpu(i, &entry);
+}
+
+static bool tick_leader(unsigned int i) {
+  // Update the GPU, with the rest of its gang
+  ASSERT_TRUE(tick_gang(i), failure);
+
+  // Journal the GPUs just ticked
+  for (unsigned int j = i; j < deviceCount; j++) {
+    if (gpuStates[j].managed && gpuStates[j].gangLeader == i) {
+      save_journal(j);
+    }
+  }
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
+
+static void apply_gangs(const unsigned int * leaders) {
+  // Set the first GPU of the gang of each GPU
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    gpuStates[i].gangLeader = leaders[i];
+    gpuStates[i].ganged = false;
+    gpuStates[i].vote = GANG_NO_VOTE;
+  }
+
+  // Mark the GPUs sharing a gang with another GPU
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    if (leaders[i] != i) {
+      gpuStates[i].ganged = true;
+      gpuStates[leaders[i]].ganged = true;
+    }
+  }
+}
+
+static bool start_workers(void) {
+  // Array of flags indicating which GPUs get a worker
+  bool managed[NVAPI_MAX_PHYSICAL_GPUS];
+
+  // Start a worker for each managed GPU, the first GPU of a gang ticks the whole gang
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    managed[i] = gpuStates[i].managed && gpuStates[i].gangLeader == i;
+  }
+
+  // Start the workers
+  return workers_start(managed, deviceCount, tick_leader);
+}
+
+static bool keep_option(const char * name, char ** staged, const char * current) {
+  // If the option didn't change
+  if (*staged == NULL ? current == NULL : current != NULL && strcmp(*staged, current) == 0) {
+    return true;
+  }
+
+  // Print message indicating the change is ignored
+  printf("Changing %s requires a restart, keeping %s\n", name, current ? current : "N/A");
+
+  // Restore the current value
+  SAFE_FREE(*staged);
+
+  // Return true to indicate success
+  return current == NULL || replace_string(staged, current);
+}
+
+static bool reload_options(int argc, char * argv[]) {
+  // Print message indicating the configuration is being reloaded
+  printf("Reloading the configuration...\n");
+
+  // Options and settings read from the configuration file
+  daemonOptions staged;
+  controlConfig settings[NVAPI_MAX_PHYSICAL_GPUS];
+
+  // Flags indicating which GPUs are managed with the new options
+  bool managed[NVAPI_MAX_PHYSICAL_GPUS];
+
+  // Load the new options
+  bool loaded = load_options(argc, argv, &staged, settings) && select_managed(&staged, managed);
+
+  // Check the performance states of the GPUs to manage
+  for (unsigned int i = 0; loaded && i < deviceCount; i++) {
+    loaded = !managed[i] || check_pstates(i, &settings[i]);
+  }
 
-// Variable to store GPU utilization information
-static nvmlUtilization_t utilization;
+  // First GPU of the gang of each GPU with the new options
+  unsigned int leaders[NVAPI_MAX_PHYSICAL_GPUS];
 
-// Variable to store GPU states
-static gpuState gpuStates[NVAPI_MAX_PHYSICAL_GPUS];
+  // Group the GPUs to manage
+  loaded = loaded && gang_assign(staged.gangs, nvmlDevices, managed, deviceCount, leaders);
 
-// Variable to store fan state
-static int fanEnabled = 0;
+  // Keep the current options if the new ones are invalid
+  if (!loaded) {
+    // Free the new options
+    free_options(&staged);
 
-// Variable to store idle time
-static unsigned int idleTime = 0;
+    // Print message indicating nothing changed
+    printf("Keeping the current configuration\n");
 
-/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+    // Return true, an invalid file is not fatal
+    return true;
+  }
 
-static void handle_exit(int signal) {
-  // Check if the received signal is SIGINT or SIGTERM
-  if (signal == SIGINT || signal == SIGTERM) {
-    // Set the global flag to false to indicate the program should stop running
-    shouldRun = false;
+  // Options bound to resources set up at startup keep their current values
+  ASSERT_TRUE(keep_option("coordinator", &staged.coordinator, options.coordinator), discard);
+  ASSERT_TRUE(keep_option("coordinator-node", &staged.coordinatorNode, options.coordinatorNode), discard);
+  ASSERT_TRUE(keep_option("hint-socket", &staged.hintSocket, options.hintSocket), discard);
+  ASSERT_TRUE(keep_option("journal", &staged.journal, options.journal), discard);
+  ASSERT_TRUE(keep_option("metrics-file", &staged.metricsFile, options.metricsFile), discard);
+  ASSERT_TRUE(keep_option("metrics-listen", &staged.metricsListen, options.metricsListen), discard);
+  ASSERT_TRUE(keep_option("record", &staged.recordFile, options.recordFile), discard);
+  ASSERT_TRUE(keep_option("topology-cache", &staged.topologyCache, options.topologyCache), discard);
+
+  if (staged.threaded != options.threaded) {
+    printf("Changing threads requires a restart, keeping %s\n", options.threaded ? "true" : "false");
+    staged.threaded = options.threaded;
   }
-}
 
-static bool invoke_fan_script(bool isEnableScript, char * script) {
-  // If the fan state is already as desired
-  if (fanEnabled == (isEnableScript ? 1 : 2)) {
-    // Skip invoking the script
-    return true;
+  // A failed worker stops the daemon, don't hide it by restarting the workers
+  if (workers_failed()) {
+    goto discard;
   }
 
-  // If script is provided
-  if (script != NULL) {
-    // Print message indicating the script is being invoked
-    printf("Invoking fan %s script\n", isEnableScript ? "enable" : "disable");
+  // Let the workers finish their current tick, so each tick sees either the old or the new settings
+  workers_stop();
 
-    // Execute the fan enable script
-    int ret = system(script);
+  // Metrics read with the previous options
+  unsigned int previousMetrics = wanted_metrics();
 
-    // Check if the script execution was successful
-    if (ret != 0) {
-      // Print error message if the script failed
-      printf("Fan %s script failed with exit code %d\n", isEnableScript ? "enable" : "disable", ret);
+  // Switch to the new options
+  free_options(&options);
+  options = staged;
+
+  // Apply the new poll bounds, validated when loaded
+  ASSERT_TRUE(scheduler_set_intervals(options.minSleepInterval, options.maxSleepInterval), failure);
+
+  // Flags indicating which GPUs start being managed
+  bool added[NVAPI_MAX_PHYSICAL_GPUS] = { false };
+
+  // Iterate through each GPU
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    // Get the current state of the GPU
+    gpuState * state = &gpuStates[i];
 
-      // It would be better to continue running even if the script fails
-      //return false;
+    // If the GPU is no longer managed
+    if (state->managed && !managed[i]) {
+      // Switch to automatic management of performance state
+      ASSERT_TRUE(set_pstate(i, 16), failure);
+
+      // Stop managing the GPU
+      state->managed = false;
+
+      // Print message indicating the GPU is released
+      printf("GPU %u is no longer managed\n", i);
     }
-  }
 
-  // Update the fan state
-  fanEnabled = isEnableScript ? 1 : 2;
+    // Apply the new settings, the current performance state is kept
+    state->settings = settings[i];
 
-  // Return true to indicate success
-  return true;
-}
+    // If the GPU starts being managed
+    if (!state->managed && managed[i]) {
+      // Start managing the GPU
+      state->managed = true;
+      added[i] = true;
 
-static bool enter_pstate(unsigned int i, unsigned int pstateId) {
-  // Get the current state of the GPU
-  gpuState * state = &gpuStates[i];
+      // Switch to low performance state
+      ASSERT_TRUE(enter_pstate(i, state->settings.policyConfiguration.performanceStateLow), failure);
 
-  // If GPU are unmanaged
-  if (!state->managed) {
-    // Return true to indicate success
-    return true;
+      // Print message indicating the GPU is taken over
+      printf("GPU %u is now managed\n", i);
+    }
   }
 
-  // Set the GPU to the desired performance state
-  NVAPI_CALL(NvAPI_GPU_SetForcePstate(nvapiDevices[i], pstateId, 0), failure);
+  // Apply the new gangs
+  apply_gangs(leaders);
 
-  // Reset the iteration counter
-  state->iterations = 0;
+  // Plan every managed GPU again if the new options read other metrics
+  for (unsigned int i = 0; i < deviceCount; i++) {
+    added[i] = added[i] || (gpuStates[i].managed && wanted_metrics() != previousMetrics);
+  }
 
-  // Update the GPU state with the new performance state
-  state->pstateId = pstateId;
+  // Decide how the telemetry of the newly managed GPUs is read
+  ASSERT_TRUE(telemetry_init(nvmlDevices, added, deviceCount, wanted_metrics()), failure);
 
-  // Print the current GPU state
-  printf("GPU %u entered performance state %u\n", i, state->pstateId);
+  // Apply the new temperature thresholds
+  apply_lazy_temperature();
+
+  // Report slow driver calls against the new threshold
+  latency_set_threshold(options.latencyWarning);
+
+  // Print the options in effect
+  print_options();
+
+  // If running in threaded mode
+  if (options.threaded) {
+    // Restart the workers with the new managed set
+    ASSERT_TRUE(start_workers(), failure);
+  }
 
   // Return true to indicate success
   return true;
 
+  discard:
+  // Free the new options, the current ones stay in effect
+  free_options(&staged);
+
   failure:
   // Return false to indicate failure
   return false;
 }
 
 static int run(int argc, char * argv[]) {
-  /***** OPTIONS *****/
-  char * disableFanScript = NULL;
-  char * enableFanScript = NULL;
-  unsigned long ids[NVAPI_MAX_PHYSICAL_GPUS] = { 0 };
-  size_t idsCount = 0;
-  unsigned long iterationsBeforeIdle = ITERATIONS_BEFORE_IDLE;
-  unsigned long iterationsBeforeSwitch = ITERATIONS_BEFORE_SWITCH;
-  unsigned long performanceStateHigh = PERFORMANCE_STATE_HIGH;
-  unsigned long performanceStateLow = PERFORMANCE_STATE_LOW;
-  unsigned long sleepInterval = SLEEP_INTERVAL;
-  unsigned long temperatureThreshold = TEMPERATURE_THRESHOLD;
-  unsigned long utilizationThreshold = UTILIZATION_THRESHOLD;
-
   /***** OPTION PARSING *****/
   {
-    // Iterate through command-line arguments
-    for (unsigned int i = 1; i < argc; i++) {
-      // Check if the option is "-i" or "--ids" and if there is a next argument
-      if ((IS_OPTION("-i") || IS_OPTION("--ids")) && HAS_NEXT_ARG) {
-        // Parse the integer array option and store it in ids
-        ASSERT_TRUE(parse_ulong_array(argv[++i], ",", NVAPI_MAX_PHYSICAL_GPUS, ids, &idsCount), usage);
-      }
-
-      // Check if the option is "-h" or "--help"
-      if ((IS_OPTION("-h") || IS_OPTION("--help"))) {
-        // Print usage instructions
-        goto usage;
-      }
-
-      // Check if the option is "-dfs" or "("--disable-fan-script" and if there is a next argument
-      if ((IS_OPTION("-dfs") || IS_OPTION("--disable-fan-script")) && HAS_NEXT_ARG) {
-        // Store it in disableFanScript
-        disableFanScript = argv[++i];
-      }
-
-      // Check if the option is "-efs" or --enable-fan-script" and if there is a next argument
-      if ((IS_OPTION("-efs") || IS_OPTION("--enable-fan-script")) && HAS_NEXT_ARG) {
-        // Store it in enableFanScript
-        enableFanScript = argv[++i];
-      }
-
-      // Check if the option is "-ibi" or "--iterations-before-idle" and if there is a next argument
-      if ((IS_OPTION("-ibi") || IS_OPTION("--iterations-before-idle")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in iterationsBeforeIdle
-        ASSERT_TRUE(parse_ulong(argv[++i], &iterationsBeforeIdle), usage);
-      }
-
-      // Check if the option is "-ibs" or "--iterations-before-switch" and if there is a next argument
-      if ((IS_OPTION("-ibs") || IS_OPTION("--iterations-before-switch")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in iterationsBeforeSwitch
-        ASSERT_TRUE(parse_ulong(argv[++i], &iterationsBeforeSwitch), usage);
-      }
-
-      // Check if the option is "-psh" or "--performance-state-high" and if there is a next argument
-      if ((IS_OPTION("-psh") || IS_OPTION("--performance-state-high")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in performanceStateHigh
-        ASSERT_TRUE(parse_ulong(argv[++i], &performanceStateHigh), usage);
-      }
-
-      // Check if the option is "-psl" or "--performance-state-low" and if there is a next argument
-      if ((IS_OPTION("-psl") || IS_OPTION("--performance-state-low")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in performanceStateLow
-        ASSERT_TRUE(parse_ulong(argv[++i], &performanceStateLow), usage);
-      }
-
-      // Check if the option is "-s" or "--service"
-      if ((IS_OPTION("-s") || IS_OPTION("--service"))) {
-        // Skip option
-        continue;
-      }
-
-      // Check if the option is "-si" or "--sleep-interval" and if there is a next argument
-      if ((IS_OPTION("-si") || IS_OPTION("--sleep-interval")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in sleepInterval
-        ASSERT_TRUE(parse_ulong(argv[++i], &sleepInterval), usage);
-      }
+    // Settings of each GPU
+    controlConfig settings[NVAPI_MAX_PHYSICAL_GPUS];
 
-      // Check if the option is "-tt" or "--temperature-threshold" and if there is a next argument
-      if ((IS_OPTION("-tt") || IS_OPTION("--temperature-threshold")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in temperatureThreshold
-        ASSERT_TRUE(parse_ulong(argv[++i], &temperatureThreshold), usage);
-      }
-
-      // Check if the option is "-ut" or "--utilization-threshold" and if there is a next argument
-      if ((IS_OPTION("-ut") || IS_OPTION("--utilization-threshold")) && HAS_NEXT_ARG) {
-        // Parse the integer option and store it in utilizationThreshold
-        ASSERT_TRUE(parse_ulong(argv[++i], &utilizationThreshold), usage);
-      }
-    }
+    // Load the options from the command line and the configuration file
+    ASSERT_TRUE(load_options(argc, argv, &options, settings), errored);
 
-    // Display usage instructions to the user
-    if (false) {
-      // Display usage instructions to the user
-      usage:
-
-      // Print the usage instructions
-      printf("Usage: %s [options]\n", argv[0]);
-      printf("\n");
-      printf("Options:\n");
-      printf("  -dfs, --disable-fan-script <value>        Script to run when the GPU fan should be disabled (default: none)\n");
-      printf("  -efs, --enable-fan-script <value>         Script to run when the GPU fan should be enabled (default: none)\n");
-      printf("  -i, --ids <value><,value...>              Set the GPU(s) to control (default: all)\n");
-      printf("  -ibi, --iterations-before-idle <value>    Set the number of iterations to wait before considering disabling the fan (default: %u)\n", ITERATIONS_BEFORE_IDLE);
-      printf("  -ibs, --iterations-before-switch <value>  Set the number of iterations to wait before switching states (default: %u)\n", ITERATIONS_BEFORE_SWITCH);
-      printf("  -psh, --performance-state-high <value>    Set the high performance state for the GPU (default: %u)\n", PERFORMANCE_STATE_HIGH);
-      printf("  -psl, --performance-state-low <value>     Set the low performance state for the GPU (default: %u)\n", PERFORMANCE_STATE_LOW);
-
-      #ifdef _WIN32
-        printf("  -s, --service                             Run as a Windows service\n");
-      #endif
-
-      printf("  -si, --sleep-interval <value>             Set the sleep interval in milliseconds between utilization checks (default: %u)\n", SLEEP_INTERVAL);
-      printf("  -tt, --temperature-threshold <value>      Set the temperature threshold in degrees C (default: %u)\n", TEMPERATURE_THRESHOLD);
-      printf("  -ut, --utilization-threshold <value>      Set the utilization threshold in percentage (default: %u)\n", UTILIZATION_THRESHOLD);
-
-      // Jump to the error handling code
-      goto errored;
+    // Store the settings of each GPU
+    for (unsigned int i = 0; i < NVAPI_MAX_PHYSICAL_GPUS; i++) {
+      gpuStates[i].settings = settings[i];
     }
   }
 
@@ -286,6 +2390,28 @@ static int run(int argc, char * argv[]) {
     // Set up signal handling
     signal(SIGINT, handle_exit);
     signal(SIGTERM, handle_exit);
+
+    #ifdef SIGUSR1
+      // Print the latency summary on request
+      signal(SIGUSR1, handle_summary);
+    #endif
+
+    #ifdef SIGHUP
+      // Reload the configuration on request
+      signal(SIGHUP, handle_reload);
+    #endif
+
+    // Report slow driver calls
+    latency_set_threshold(options.latencyWarning);
+  }
+
+  /***** RECORD INIT *****/
+  {
+    // If recording is enabled
+    if (options.recordFile != NULL) {
+      // Open the recording
+      ASSERT_TRUE(record_open(options.recordFile), errored);
+    }
   }
 
   /***** NVAPI INIT *****/
@@ -322,127 +2448,43 @@ static int run(int argc, char * argv[]) {
 
   /***** SORT NVAPI HANDLES */
   {
-    // Array to hold NVML device identifiers
-    NvU32 nvmlIdentifiers[NVAPI_MAX_PHYSICAL_GPUS];
-
-    // Array to hold NVAPI device identifiers
-    NvU32 nvapiIdentifiers[NVAPI_MAX_PHYSICAL_GPUS];
-
-    // Step 1: Loop through each device to retrieve and store NVML and NVAPI identifiers
-    for (unsigned int i = 0; i < deviceCount; i++) {
-      // Initialize struct to hold PCI info
-      nvmlPciInfo_t nvmlPciInfo;
-
-      // Get PCI info
-      NVML_CALL(nvmlDeviceGetPciInfo(nvmlDevices[i], &nvmlPciInfo), errored);
-
-      // Store bus id in nvmlIdentifiers array
-      nvmlIdentifiers[i] = nvmlPciInfo.bus;
-
-      // Variable to hold bus id
-      NvU32 nvapiBusId;
-
-      // Get bus id
-      NVAPI_CALL(NvAPI_GPU_GetBusId(nvapiDevices[i], &nvapiBusId), errored);
-
-      // Store in nvapiIdentifiers array
-      nvapiIdentifiers[i] = nvapiBusId;
-    }
-
-    // Array to store NVAPI device handles in sorted order
-    NvPhysicalGpuHandle sortedNvapiDevices[NVAPI_MAX_PHYSICAL_GPUS];
-
-    // Step 2: Match and order NVAPI devices based on serial numbers
-    for (unsigned int i = 0; i < deviceCount; i++) {
-      for (unsigned int j = 0; j < deviceCount; j++) {
-        // Compare NVML and NVAPI identifiers
-        if (nvmlIdentifiers[i] == nvapiIdentifiers[j]) {
-          // Store matched device handle in sorted array
-          sortedNvapiDevices[i] = nvapiDevices[j];
-
-          // Exit the inner loop
-          break;
-        }
-      }
-    }
-
-    // Step 3: Copy sorted handles back to original array
-    memcpy(nvapiDevices, sortedNvapiDevices, sizeof(sortedNvapiDevices));
+    // Order the NVAPI handles like the NVML ones, matching them by PCI location
+    ASSERT_TRUE(topology_match(nvmlDevices, nvapiDevices, deviceCount, options.topologyCache), errored);
   }
 
   /***** INIT *****/
   {
-    // Print ids
-    {
-      // Print the initial text
-      printf("ids = ");
-
-      // Loop through each element in the array
-      for (size_t i = 0; i < idsCount; i++) {
-        // Print the current element with %lu for unsigned long
-        printf("%lu", ids[i]);
-
-        // If this is not the last element
-        if (i + 1 < idsCount) {
-          // Print a comma
-          printf(",");
-        }
-      }
+    // Print the options
+    print_options();
 
-      // If array is empty
-      if (idsCount == 0) {
-        // Print "N/A"
-        printf("N/A");
-      }
+    // Array of flags indicating which GPUs are managed
+    bool managed[NVAPI_MAX_PHYSICAL_GPUS];
 
-      // Print the count of elements in the array and newline character
-      printf(" (%zu)\n", idsCount);
-    }
-
-    // Print remaining variables
-    printf("disableFanScript = %s\n", disableFanScript ? disableFanScript : "N/A");
-    printf("enableFanScript = %s\n", enableFanScript ? enableFanScript : "N/A");
-    printf("iterationsBeforeIdle = %lu\n", iterationsBeforeIdle);
-    printf("iterationsBeforeSwitch = %lu\n", iterationsBeforeSwitch);
-    printf("performanceStateHigh = %lu\n", performanceStateHigh);
-    printf("performanceStateLow = %lu\n", performanceStateLow);
-    printf("sleepInterval = %lu\n", sleepInterval);
-    printf("temperatureThreshold = %lu\n", temperatureThreshold);
-    printf("utilizationThreshold = %lu\n", utilizationThreshold);
-
-    // Check if there are specific GPU ids to process
-    if (idsCount != 0) {
-      // Iterate over each provided id
-      for (size_t i = 0; i < idsCount; i++) {
-        // Get the current id
-        unsigned long id = ids[i];
-
-        // Validate the id
-        if (id < 0 || id > deviceCount) {
-          // Print error message for invalid id
-          printf("Invalid GPU id: %zu\n", i);
-
-          // Skip to the next id
-          continue;
-        }
+    // Select the GPUs to manage
+    ASSERT_TRUE(select_managed(&options, managed), errored);
 
-        // Get the current state of the GPU
-        gpuState * state = &gpuStates[id];
+    // Mark the selected GPUs as managed
+    for (unsigned int i = 0; i < deviceCount; i++) {
+      gpuStates[i].managed = managed[i];
 
-        // Mark the GPU as managed
-        state->managed = true;
+      // Check the performance states the GPU will be switched to
+      if (managed[i]) {
+        ASSERT_TRUE(check_pstates(i, &gpuStates[i].settings), errored);
       }
-    } else {
-      // Iterate through each GPU
-      for (unsigned int i = 0; i < deviceCount; i++) {
-        // Get the current state of the GPU
-        gpuState * state = &gpuStates[i];
 
-        // Mark the GPU as managed
-        state->managed = true;
-      }
+      // Under a power budget, GPUs wait for the first share before going high
+      gpuStates[i].budgetDenied = options.powerBudget != 0;
     }
 
+    // First GPU of the gang of each GPU
+    unsigned int leaders[NVAPI_MAX_PHYSICAL_GPUS];
+
+    // Group the managed GPUs
+    ASSERT_TRUE(gang_assign(options.gangs, nvmlDevices, managed, deviceCount, leaders), errored);
+
+    // Apply the gangs
+    apply_gangs(leaders);
+
     // Initialize the counter for managed GPUs
     unsigned int managedGPUs = 0;
 
@@ -456,6 +2498,9 @@ static int run(int argc, char * argv[]) {
         // Buffer to store the GPU name
         char gpuName[256];
 
+        // Attribute the driver call to the GPU
+        latency_set_gpu(i);
+
         // Retrieve the GPU name
         NVML_CALL(nvmlDeviceGetName(nvmlDevices[i], gpuName, sizeof(gpuName)), errored);
 
@@ -467,27 +2512,132 @@ static int run(int argc, char * argv[]) {
       }
     }
 
-    // If no GPUs are managed, report an error
-    if (managedGPUs == 0) {
-      // Print error message
-      printf("Can't find GPUs to manage!\n");
-
-      // Jump to error handling section
-      goto errored;
-    }
+    // Calls made from now on are attributed by the caller
+    latency_set_gpu(LATENCY_GPU_NONE);
 
     // Print the number of GPUs being managed
     printf("Managing %u GPUs...\n", managedGPUs);
 
+    // State left by the previous run
+    journalState restored;
+
+    // Flag indicating whether the previous run is resumed
+    bool resumed = false;
+
+    // If the journal is enabled
+    if (options.journal != NULL) {
+      // Open the journal and read the state left by the previous run
+      ASSERT_TRUE(journal_open(options.journal, nvmlDevices, deviceCount, &restored, &resumed), errored);
+    }
+
     // Iterate through each GPU
     for (unsigned int i = 0; i < deviceCount; i++) {
-      // Switch to low performance state
-      if (!enter_pstate(i, performanceStateLow)) {
+      // Get the current state of the GPU
+      gpuState * state = &gpuStates[i];
+
+      // Get the configuration of the policy
+      const policyConfig * config = &state->settings.policyConfiguration;
+
+      // Flag indicating whether the previous run managed the GPU as this one does
+      bool resumable = resumed && state->managed && restored.gpus[i].managed && is_policy_pstate(config, restored.gpus[i].pstateId);
+
+      // Start from low performance state, or from where the previous run left the GPU
+      unsigned int pstateId = resumable ? restored.gpus[i].pstateId : config->performanceStateLow;
+
+      // A resumed GPU waits for its slot like the others
+      if (pstateId == config->performanceStateHigh && !may_enter_high(i)) {
+        pstateId = policy_step_down(config, pstateId);
+      }
+
+      // Switch to the performance state
+      if (!enter_pstate(i, pstateId)) {
         goto errored;
       }
 
+      // Resume the policy where the previous run left it
+      if (resumable) {
+        state->policy.iterations = restored.gpus[i].iterations;
+        state->policy.busyTime = restored.gpus[i].busyTime;
+      }
+
+      // Journal the GPU, even before its first tick
+      save_journal(i);
+    }
+
+    // Leave the fan as the previous run did, disable it otherwise
+    if (resumed && restored.fanEnabled) {
+      // Keep counting the idle time from where the previous run was
+      idleTime = restored.idleTime;
+
+      // Enable the fan
+      ASSERT_TRUE(invoke_fan_script(true, options.enableFanScript), errored);
+    } else {
       // Disable the fan
-      ASSERT_TRUE(invoke_fan_script(false, disableFanScript), errored);
+      ASSERT_TRUE(invoke_fan_script(false, options.disableFanScript), errored);
+    }
+
+    // Print message indicating the state is resumed
+    if (resumed) {
+      printf("Resumed the state of the GPUs from %s\n", options.journal);
+    }
+  }
+
+  /***** TELEMETRY INIT *****/
+  {
+    // Array of flags indicating which GPUs are polled
+    bool managed[NVAPI_MAX_PHYSICAL_GPUS];
+
+    // Only managed GPUs are polled
+    for (unsigned int i = 0; i < deviceCount; i++) {
+      managed[i] = gpuStates[i].managed;
+    }
+
+    // Decide how the telemetry of each GPU is read
+    ASSERT_TRUE(telemetry_init(nvmlDevices, managed, deviceCount, wanted_metrics()), errored);
+
+    // Only read the temperature when the GPU could be near the threshold, if enabled
+    apply_lazy_temperature();
+  }
+
+  /***** SCHEDULER INIT *****/
+  {
+    // Initialize the poll scheduler
+    ASSERT_TRUE(scheduler_init(options.minSleepInterval, options.maxSleepInterval), errored);
+  }
+
+  /***** HINTS INIT *****/
+  {
+    // If the hint socket is enabled
+    if (options.hintSocket != NULL) {
+      // Start listening for clients
+      ASSERT_TRUE(hints_init(options.hintSocket), errored);
+
+      // Wake up the control loop when clients send requests
+      ASSERT_TRUE(scheduler_watch(hints_fd()), errored);
+    }
+  }
+
+  /***** CLUSTER INIT *****/
+  {
+    // If the coordinator is enabled
+    if (options.coordinator != NULL) {
+      // Connect to the coordinator, the GPUs are decided locally while it is unreachable
+      ASSERT_TRUE(cluster_init(options.coordinator, options.coordinatorNode, deviceCount), errored);
+    }
+  }
+
+  /***** METRICS INIT *****/
+  {
+    // Start exporting the metrics
+    ASSERT_TRUE(metrics_init(options.metricsListen, options.metricsFile), errored);
+  }
+
+  /***** WORKERS INIT *****/
+  {
+    // If running in threaded mode
+    if (options.threaded) {
+      // Start a worker for each managed GPU
+      ASSERT_TRUE(start_workers(), errored);
     }
   }
 
@@ -495,6 +2645,9 @@ static int run(int argc, char * argv[]) {
   {
     // Infinite loop to continuously monitor GPU temperature and utilization
     while (shouldRun) {
+      // Flag to track if any GPU needs fast polling
+      bool active = false;
+
       /*** TRACK IDLE STATE ***/
       {
         // Flag to track if all GPUs are idle
@@ -515,29 +2668,38 @@ static int run(int argc, char * argv[]) {
           }
 
           // If the GPU is not in low performance state
-          if (state->pstateId != performanceStateLow) {
+          if (ATOMIC_LOAD(&state->pstateId) != state->settings.policyConfiguration.performanceStateLow) {
             // Set the allIdle flag to false
             allIdle = false;
+
+            // Poll at the fastest rate
+            active = true;
           }
 
           // If the GPU is preventing idle ticks
-          if (state->preventIdleTick) {
+          if (ATOMIC_LOAD(&state->preventIdleTick)) {
             // Set the preventIdleTick flag to true
             preventingIdleTick = true;
+
+            // Poll at the fastest rate
+            active = true;
           }
         }
 
         // If all GPUs are idle, increment the idle time counter
         if (allIdle) {
           // If idle time exceeds N iterations
-          if (idleTime >= iterationsBeforeIdle) {
+          if (idleTime >= options.iterationsBeforeIdle) {
             // Disable the fan
-            ASSERT_TRUE(invoke_fan_script(false, disableFanScript), errored);
+            ASSERT_TRUE(invoke_fan_script(false, options.disableFanScript), errored);
           } else {
             // If not preventing idle tick
             if (!preventingIdleTick) {
-              // Increment the idle time counter
-              idleTime += 1;
+              // Get the current interval between polls
+              unsigned long interval = scheduler_stats().interval;
+
+              // Increment the idle time counter by the number of sleep intervals elapsed
+              idleTime += interval > options.sleepInterval ? interval / options.sleepInterval : 1;
             }
           }
         } else {
@@ -546,94 +2708,208 @@ static int run(int argc, char * argv[]) {
         }
       }
 
-      // Loop through all devices
-      for (unsigned int i = 0; i < deviceCount; i++) {
-        // Get the current state of the GPU
-        gpuState * state = &gpuStates[i];
-
-        // Retrieve the current temperature of the GPU
-        NVML_CALL(nvmlDeviceGetTemperature(nvmlDevices[i], NVML_TEMPERATURE_GPU, &temperature), errored);
-
-        // Check if the GPU temperature exceeds the defined threshold
-        if (temperature > temperatureThreshold) {
-          // If the GPU is not already in low performance state
-          if (state->pstateId != performanceStateLow) {
-            // Switch to low performance state
-            if (!enter_pstate(i, performanceStateLow)) {
-              goto errored;
+      /*** UPDATE GPUS ***/
+      {
+        // If running in threaded mode
+        if (options.threaded) {
+          // Stop if any worker has failed
+          if (workers_failed()) {
+            goto errored;
+          }
+
+          // Let the workers update their GPUs, without waiting for them
+          workers_tick();
+        } else {
+          // Loop through all devices
+          for (unsigned int i = 0; i < deviceCount; i++) {
+            // Check if GPU is unmanaged or ticked by the first GPU of its gang
+            if (!gpuStates[i].managed || gpuStates[i].gangLeader != i) {
+              // Skip to the next GPU
+              continue;
             }
 
-            // Enable the fan
-            ASSERT_TRUE(invoke_fan_script(true, enableFanScript), errored);
+            // Update the GPU, with the rest of its gang
+            ASSERT_TRUE(tick_leader(i), errored);
+          }
+        }
+      }
+
+      /*** AGGREGATE GPU STATES ***/
+      {
+        // Flag to track if any GPU requested enabling the fan
+        bool fanRequested = false;
+
+        // Iterate through each GPU
+        for (unsigned int i = 0; i < deviceCount; i++) {
+          // Get the current state of the GPU
+          gpuState * state = &gpuStates[i];
+
+          // Check if GPU is unmanaged
+          if (!state->managed) {
+            // Skip to the next GPU
+            continue;
+          }
 
-            // Prevent idle ticks
-            state->preventIdleTick = true;
+          // Get the number of fan enable requests
+          unsigned int fanRequests = ATOMIC_LOAD(&state->fanRequests);
+
+          // If there are new requests
+          if (fanRequests != state->fanRequestsHandled) {
+            // Mark them as handled
+            state->fanRequestsHandled = fanRequests;
+
+            // Enable the fan once for all GPUs
+            fanRequested = true;
           }
 
-          // Skip further checks for this iteration
-          continue;
-        } else {
-          // Allow idle ticks
-          state->preventIdleTick = false;
+          // If the utilization is rising
+          if (ATOMIC_LOAD(&state->utilizationRising)) {
+            // Poll at the fastest rate
+            active = true;
+          }
+
+          // If the coordinator is enabled
+          if (options.coordinator != NULL) {
+            // Get the utilization of the GPU
+            unsigned int utilization = ATOMIC_LOAD(&state->utilization);
+
+            // Describe the GPU, a GPU held by an application goes before busy ones
+            clusterState report = {
+              .pstateId = ATOMIC_LOAD(&state->pstateId),
+              .utilization = utilization,
+              .temperature = ATOMIC_LOAD(&state->temperature),
+              .power = ATOMIC_LOAD(&state->power),
+              .pressure = utilization + (hints_held(i, get_time_ns()) ? CLUSTER_LEASE_PRESSURE : 0),
+              .wantsHigh = ATOMIC_LOAD(&state->wantsHigh),
+            };
+
+            // Report it, unchanged states are only sent now and then
+            cluster_report(i, &report);
+          }
+        }
+
+        // If any GPU requested enabling the fan
+        if (fanRequested) {
+          // Enable the fan
+          ASSERT_TRUE(invoke_fan_script(true, options.enableFanScript), errored);
         }
+      }
 
-        // Retrieve the current utilization rates of the GPU
-        NVML_CALL(nvmlDeviceGetUtilizationRates(nvmlDevices[i], &utilization), errored);
+      // Decide which GPUs fit in the power budget of the node
+      share_power_budget();
 
-        // Check if the GPU utilization is above the defined threshold
-        if (utilization.gpu > utilizationThreshold) {
-          // If the GPU is not already in high performance state
-          if (state->pstateId != performanceStateHigh) {
-            // Switch to high performance state
-            if (!enter_pstate(i, performanceStateHigh)) {
-              goto errored;
-            }
+      // Collect the finished fan script and start the latest requested one
+      ASSERT_TRUE(fan_process(), errored);
 
-            // Enable the fan
-            ASSERT_TRUE(invoke_fan_script(true, enableFanScript), errored);
-          } else {
-            // Reset the iteration counter
-            state->iterations = 0;
+      // Apply the answers of the coordinator, or reconnect to it when due
+      ASSERT_TRUE(cluster_process(), errored);
+
+      // Adapt the interval between polls to the activity
+      scheduler_update(active);
+
+      // Rewrite the metrics file if due
+      metrics_update();
+
+      // Write the records of this iteration
+      record_flush();
+
+      // Mark the journal as up to date
+      journal_write(fanEnabled, idleTime);
+
+      /*** WAIT ***/
+      {
+        // Wait for the next deadline, reacting to hints as they arrive
+        while (shouldRun) {
+          // If the latency summary was requested
+          if (summaryRequested) {
+            // Clear the request
+            summaryRequested = false;
+
+            // Print the summary
+            latency_print_summary();
           }
-        } else {
-          // If the GPU is not already in low performance state
-          if (state->pstateId != performanceStateLow) {
-            // If the number of iterations exceeds the threshold
-            if (state->iterations > iterationsBeforeSwitch) {
-              // Switch to low performance state
-              if (!enter_pstate(i, performanceStateLow)) {
-                goto errored;
+
+          // If reloading the configuration was requested
+          if (reloadRequested) {
+            // Clear the request
+            reloadRequested = false;
+
+            // Reload the configuration
+            ASSERT_TRUE(reload_options(argc, argv), errored);
+          }
+
+          // Flag indicating whether the wait was interrupted before the deadline
+          bool event;
+
+          // Sleep until the next deadline or an event
+          ASSERT_TRUE(scheduler_wait(&event), errored);
+
+          // If the deadline is reached
+          if (!event) {
+            // Proceed to the next iteration
+            break;
+          }
+
+          // Collect the fan script if it exited
+          ASSERT_TRUE(fan_process(), errored);
+
+          // Apply the answers of the coordinator
+          ASSERT_TRUE(cluster_process(), errored);
+
+          // If the hint socket is enabled
+          if (options.hintSocket != NULL) {
+            // Handle the client requests
+            ASSERT_TRUE(hints_process(), errored);
+
+            // If running in threaded mode
+            if (options.threaded) {
+              // Let the workers apply the leases right away
+              workers_tick();
+            } else {
+              // Apply the leases right away, a GPU failing to switch is quarantined as on its tick
+              for (unsigned int i = 0; i < deviceCount; i++) {
+                if (gpuStates[i].managed && gpuStates[i].failures == 0 && !apply_lease(i)) {
+                  ASSERT_TRUE(isolate_fault(i), errored);
+                }
               }
             }
-
-            // Increment the iteration counter
-            state->iterations++;
           }
         }
       }
-
-      // Sleep for a defined interval before the next check
-      #ifdef _WIN32
-        Sleep(sleepInterval);
-      #elif __linux__
-        usleep(sleepInterval * 1000);
-      #endif
     }
   }
 
   /***** NORMAL EXIT *****/
   {
+    // Wait for the workers to finish their current tick
+    workers_stop();
+
+    // Print the worker statistics
+    workers_print_stats();
+
+    // Flag indicating whether every GPU was handed back to the driver
+    bool released = true;
+
     // Iterate through each GPU
     for (unsigned int i = 0; i < deviceCount; i++) {
-      // Switch to automatic management of performance state
-      if (!enter_pstate(i, 16)) {
-        goto errored;
-      }
+      // Switch to automatic management of performance state, even for GPUs held back by the budget, a failing GPU doesn't keep the others forced
+      released = set_pstate(i, 16) && released;
 
       // Enable the fan
-      ASSERT_TRUE(invoke_fan_script(true, enableFanScript), errored);
+      ASSERT_TRUE(invoke_fan_script(true, options.enableFanScript), errored);
+    }
+
+    // Report the GPUs that couldn't be released
+    if (!released) {
+      goto errored;
     }
 
+    // Print the scheduler statistics
+    scheduler_print_stats();
+
+    // Print the driver call latencies
+    latency_print_summary();
+
     // Notify about the exit
     printf("Exiting...\n");
 
@@ -645,11 +2921,60 @@ static int run(int argc, char * argv[]) {
   /***** APPLICATION ERROR OCCURRED *****/
   {
     errorOccurred = true;
+
+    // Wait for the workers, so no tick switches a GPU after it is released
+    workers_stop();
+
+    // Hand the GPUs back to the driver rather than leaving them forced, as far as they still respond
+    for (unsigned int i = 0; i < deviceCount && nvapiInitialized; i++) {
+      if (gpuStates[i].managed && gpuStates[i].pstateId != 16) {
+        set_pstate(i, 16);
+      }
+    }
   }
 
   cleanup:
+  /***** WORKERS DEINIT *****/
+  {
+    // Stop the workers if still running
+    workers_stop();
+  }
+
+  /***** FAN DEINIT *****/
+  {
+    // Wait for the fan scripts still running or requested
+    fan_deinit();
+  }
+
+  /***** METRICS DEINIT *****/
+  {
+    // Stop the HTTP server and write the final metrics
+    metrics_deinit();
+  }
+
+  /***** CLUSTER DEINIT *****/
+  {
+    // Disconnect from the coordinator, which releases the slots of the node
+    cluster_deinit();
+  }
+
+  /***** HINTS DEINIT *****/
+  {
+    // Disconnect the clients and remove the socket
+    hints_deinit();
+  }
+
+  /***** SCHEDULER DEINIT *****/
+  {
+    // Release the poll scheduler
+    scheduler_deinit();
+  }
+
   /***** NVAPI DEINIT *****/
   {
+    // The remaining driver calls are not made for a specific GPU
+    latency_set_gpu(LATENCY_GPU_NONE);
+
     // Unload NVAPI library if it was initialized
     if (nvapiInitialized) {
       // Set NVAPI initialization flag to false
@@ -672,6 +2997,18 @@ static int run(int argc, char * argv[]) {
     }
   }
 
+  /***** RECORD DEINIT *****/
+  {
+    // Close the recording
+    record_close();
+  }
+
+  /***** JOURNAL DEINIT *****/
+  {
+    // Unmap the journal, its state stays on disk for the next run
+    journal_close();
+  }
+
   /***** RETURN *****/
   {
     return errorOccurred;
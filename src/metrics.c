@@ -0,0 +1,785 @@
+#ifdef __linux__
+  // Required for accept4()
+  #define _GNU_SOURCE
+#endif
+
+#include "metrics.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#elif __linux__
+  #include <netdb.h>
+  #include <pthread.h>
+  #include <signal.h>
+  #include <sys/socket.h>
+  #include <sys/time.h>
+  #include <unistd.h>
+#endif
+
+#include "utils.h"
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the counters of each GPU
+typedef struct {
+  // Flag indicating whether the GPU reported anything yet
+  bool seen;
+
+  // Current performance state
+  unsigned int pstateId;
+
+  // Time the current performance state was entered (in nanoseconds)
+  unsigned long long since;
+
+  // Time spent in each performance state (in nanoseconds)
+  unsigned long long residency[METRICS_PSTATES];
+
+  // Number of transitions to a higher and to a lower performance state
+  unsigned long long transitionsUp;
+  unsigned long long transitionsDown;
+
+  // Number of times the temperature threshold forced the low performance state
+  unsigned long long thermalOverrides;
+
+  // Number of failed ticks of the GPU
+  unsigned long long faults;
+
+  // Flag indicating whether the GPU is left alone until its next attempt
+  bool quarantined;
+
+  // Flags indicating whether the temperature and utilization were sampled yet
+  bool temperatureSampled;
+  bool utilizationSampled;
+
+  // Last sampled temperature (in degrees C)
+  unsigned int temperature;
+
+  // Last sampled utilization (in percentage)
+  unsigned int utilization;
+
+  // Flags indicating whether the memory temperature and power were sampled yet
+  bool memoryTemperatureSampled;
+  bool powerSampled;
+
+  // Last sampled memory temperature (in degrees C)
+  unsigned int memoryTemperature;
+
+  // Last sampled power draw (in milliwatts)
+  unsigned int power;
+} metricsGpu;
+
+// Structure to hold a consistent copy of all counters
+typedef struct {
+  // Counters of each GPU
+  metricsGpu gpus[METRICS_GPUS_MAX];
+
+  // Number of fan disable and enable script invocations
+  unsigned long long fanScripts[2];
+
+  // Flags indicating whether a fan disable and enable script has finished
+  bool fanScriptsFinished[2];
+
+  // Exit code of the last finished fan disable and enable script
+  int fanScriptResults[2];
+} metricsSnapshot;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Live counters
+static metricsSnapshot counters;
+
+// Path of the metrics file and of its temporary copy
+static char * filePath = NULL;
+static char * tempPath = NULL;
+
+// Time of the last write of the metrics file (in nanoseconds)
+static unsigned long long lastWrite = 0;
+
+#ifdef __linux__
+  // Lock protecting the counters, GPUs may be updated from worker threads
+  static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+  // Listening socket of the HTTP server
+  static int listenFd = -1;
+
+  // HTTP server thread
+  static pthread_t serverThread;
+
+  // Flag indicating whether the HTTP server thread is running
+  static bool serverRunning = false;
+
+  // Flag indicating whether the HTTP server should stop
+  static bool stopping = false;
+#endif
+
+/***** ***** ***** ***** ***** MACROS ***** ***** ***** ***** *****/
+
+#ifdef __linux__
+  #define METRICS_LOCK() pthread_mutex_lock(&mutex)
+  #define METRICS_UNLOCK() pthread_mutex_unlock(&mutex)
+#else
+  // Without worker threads there is nothing to synchronize
+  #define METRICS_LOCK()
+  #define METRICS_UNLOCK()
+#endif
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static int pstate_rank(unsigned int pstateId) {
+  // Automatic management allows the highest performance, otherwise P0 is the fastest
+  return pstateId == METRICS_PSTATES - 1 ? -1 : (int) pstateId;
+}
+
+static void take_snapshot(metricsSnapshot * snapshot) {
+  // Get the current time
+  unsigned long long now = get_time_ns();
+
+  // Copy the counters
+  METRICS_LOCK();
+  *snapshot = counters;
+  METRICS_UNLOCK();
+
+  // Account for the time spent in the current performance states so far
+  for (unsigned int i = 0; i < METRICS_GPUS_MAX; i++) {
+    // Get the counters of the GPU
+    metricsGpu * gpu = &snapshot->gpus[i];
+
+    // If the performance state is known
+    if (gpu->seen && now > gpu->since) {
+      gpu->residency[gpu->pstateId] += now - gpu->since;
+    }
+  }
+}
+
+static void format_metrics(FILE * stream, const metricsSnapshot * snapshot) {
+  // Current performance state
+  fprintf(stream, "# HELP nvidia_pstated_pstate Current performance state of the GPU (16 is automatic management).\n");
+  fprintf(stream, "# TYPE nvidia_pstated_pstate gauge\n");
+
+  for (unsigned int i = 0; i < METRICS_GPUS_MAX; i++) {
+    if (snapshot->gpus[i].seen) {
+      fprintf(stream, "nvidia_pstated_pstate{gpu=\"%u\"} %u\n", i, snapshot->gpus[i].pstateId);
+    }
+  }
+
+  // Performance state residency
+  fprintf(stream, "# HELP nvidia_pstated_pstate_seconds_total Time spent in each performance state.\n");
+  fprintf(stream, "# TYPE nvidia_pstated_pstate_seconds_total counter\n");
+
+  for (unsigned int i = 0; i < METRICS_GPUS_MAX; i++) {
+    for (unsigned int p = 0; p < METRICS_PSTATES; p++) {
+      // Skip the performance states the GPU never entered
+      if (snapshot->gpus[i].residency[p] == 0 && !(snapshot->gpus[i].seen && snapshot->gpus[i].pstateId == p)) {
+        continue;
+      }
+
+      fprintf(stream, "nvidia_pstated_pstate_seconds_total{gpu=\"%u\",pstate=\"%u\"} %.3f\n", i, p, snapshot->gpus[i].residency[p] / 1e9);
+    }
+  }
+
+  // Performance state transitions
+  fprintf(stream, "# HELP nvidia_pstated_transitions_total Performance state transitions.\n");
+  fprintf(stream, "# TYPE nvidia_pstated_transitions_total counter\n");
+
+  for (unsigned int i = 0; i < METRICS_GPUS_MAX; i++) {
+    if (snapshot->gpus[i].seen) {
+      fprintf(stream, "nvidia_pstated_transitions_total{gpu=\"%u\",direction=\"up\"} %llu\n", i, snapshot->gpus[i].transitionsUp);
+      fprintf(stream, "nvidia_pstated_transitions_total{gpu=\"%u\",direction=\"down\"} %llu\n", i, snapshot->gpus[i].transitionsDown);
+    }
+  }
+
+  // Thermal overrides
+  fprintf(stream, "# HELP nvidia_pstated_thermal_overrides_total Times the temperature threshold forced the low performance state.\n");
+  fprintf(stream, "# TYPE nvidia_pstated_thermal_overrides_total counter\n");
+
+  for (unsigned int i = 0; i < METRICS_GPUS_MAX; i++) {
+    if (snapshot->gpus[i].seen) {
+      fprintf(stream, "nvidia_pstated_thermal_overrides_total{gpu=\"%u\"} %llu\n", i, snapshot->gpus[i].thermalOverrides);
+    }
+  }
+
+  // Failed ticks
+  fprintf(stream, "# HELP nvidia_pstated_faults_total Ticks of the GPU that failed with a driver error.\n");
+  fprintf(stream, "# TYPE nvidia_pstated_faults_total counter\n");
+
+  for (unsigned int i = 0; i < METRICS_GPUS_MAX; i++) {
+    if (snapshot->gpus[i].seen) {
+      fprintf(stream, "nvidia_pstated_faults_total{gpu=\"%u\"} %llu\n", i, snapshot->gpus[i].faults);
+    }
+  }
+
+  // Quarantine
+  fprintf(stream, "# HELP nvidia_pstated_quarantined Whether the GPU is left alone after driver errors until its next attempt.\n");
+  fprintf(stream, "# TYPE nvidia_pstated_quarantined gauge\n");
+
+  for (unsigned int i = 0; i < METRICS_GPUS_MAX; i++) {
+    if (snapshot->gpus[i].seen) {
+      fprintf(stream, "nvidia_pstated_quarantined{gpu=\"%u\"} %u\n", i, snapshot->gpus[i].quarantined ? 1 : 0);
+    }
+  }
+
+  // Last sampled temperature
+  fprintf(stream, "# HELP nvidia_pstated_temperature_celsius Last sampled GPU temperature.\n");
+  fprintf(stream, "# TYPE nvidia_pstated_temperature_celsius gauge\n");
+
+  for (unsigned int i = 0; i < METRICS_GPUS_MAX; i++) {
+    if (snapshot->gpus[i].temperatureSampled) {
+      fprintf(stream, "nvidia_pstated_temperature_celsius{gpu=\"%u\"} %u\n", i, snapshot->gpus[i].temperature);
+    }
+  }
+
+  // Last sampled utilization
+  fprintf(stream, "# HELP nvidia_pstated_utilization_percent Last sampled GPU utilization.\n");
+  fprintf(stream, "# TYPE nvidia_pstated_utilization_percent gauge\n");
+
+  for (unsigned int i = 0; i < METRICS_GPUS_MAX; i++) {
+    if (snapshot->gpus[i].utilizationSampled) {
+      fprintf(stream, "nvidia_pstated_utilization_percent{gpu=\"%u\"} %u\n", i, snapshot->gpus[i].utilization);
+    }
+  }
+
+  // Last sampled memory temperature
+  fprintf(stream, "# HELP nvidia_pstated_memory_temperature_celsius Last sampled GPU memory temperature.\n");
+  fprintf(stream, "# TYPE nvidia_pstated_memory_temperature_celsius gauge\n");
+
+  for (unsigned int i = 0; i < METRICS_GPUS_MAX; i++) {
+    if (snapshot->gpus[i].memoryTemperatureSampled) {
+      fprintf(stream, "nvidia_pstated_memory_temperature_celsius{gpu=\"%u\"} %u\n", i, snapshot->gpus[i].memoryTemperature);
+    }
+  }
+
+  // Last sampled power draw
+  fprintf(stream, "# HELP nvidia_pstated_power_watts Last sampled GPU power draw.\n");
+  fprintf(stream, "# TYPE nvidia_pstated_power_watts gauge\n");
+
+  for (unsigned int i = 0; i < METRICS_GPUS_MAX; i++) {
+    if (snapshot->gpus[i].powerSampled) {
+      fprintf(stream, "nvidia_pstated_power_watts{gpu=\"%u\"} %.3f\n", i, snapshot->gpus[i].power / 1e3);
+    }
+  }
+
+  // Fan script invocations
+  fprintf(stream, "# HELP nvidia_pstated_fan_script_invocations_total Fan script invocations.\n");
+  fprintf(stream, "# TYPE nvidia_pstated_fan_script_invocations_total counter\n");
+  fprintf(stream, "nvidia_pstated_fan_script_invocations_total{script=\"enable\"} %llu\n", snapshot->fanScripts[1]);
+  fprintf(stream, "nvidia_pstated_fan_script_invocations_total{script=\"disable\"} %llu\n", snapshot->fanScripts[0]);
+
+  // Fan script results
+  fprintf(stream, "# HELP nvidia_pstated_fan_script_last_exit_code Exit code of the last finished fan script or HTTP status of a failed fan URL, -1 on timeout, -2 on other request errors.\n");
+  fprintf(stream, "# TYPE nvidia_pstated_fan_script_last_exit_code gauge\n");
+
+  if (snapshot->fanScriptsFinished[1]) {
+    fprintf(stream, "nvidia_pstated_fan_script_last_exit_code{script=\"enable\"} %d\n", snapshot->fanScriptResults[1]);
+  }
+
+  if (snapshot->fanScriptsFinished[0]) {
+    fprintf(stream, "nvidia_pstated_fan_script_last_exit_code{script=\"disable\"} %d\n", snapshot->fanScriptResults[0]);
+  }
+}
+
+static void write_file(void) {
+  // Copy the counters, so the file is written without holding the lock
+  static metricsSnapshot snapshot;
+  take_snapshot(&snapshot);
+
+  // Write a temporary copy, so collectors never read a partial file
+  FILE * stream = fopen(tempPath, "w");
+
+  // Check if the file was opened
+  if (stream == NULL) {
+    fprintf(stderr, "Unable to write %s: %s\n", tempPath, strerror(errno));
+    return;
+  }
+
+  // Write the metrics
+  format_metrics(stream, &snapshot);
+
+  // Check if the file was written
+  if (fclose(stream) != 0) {
+    fprintf(stderr, "Unable to write %s: %s\n", tempPath, strerror(errno));
+    return;
+  }
+
+  // Replace the metrics file
+  #ifdef _WIN32
+    if (!MoveFileExA(tempPath, filePath, MOVEFILE_REPLACE_EXISTING)) {
+      fprintf(stderr, "Unable to replace %s: error %lu\n", filePath, GetLastError());
+    }
+  #elif __linux__
+    if (rename(tempPath, filePath) == -1) {
+      fprintf(stderr, "Unable to replace %s: %s\n", filePath, strerror(errno));
+    }
+  #endif
+}
+
+#ifdef __linux__
+  static bool send_all(int fd, const char * data, size_t length) {
+    // Send until everything is written
+    while (length > 0) {
+      // Send the remaining data
+      ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+
+      // If the send failed
+      if (sent == -1) {
+        // Retry if interrupted by a signal
+        if (errno == EINTR) {
+          continue;
+        }
+
+        // Give up on any other error, including the send timeout
+        return false;
+      }
+
+      // Advance past the sent data
+      data += sent;
+      length -= sent;
+    }
+
+    // Return true to indicate success
+    return true;
+  }
+
+  static void serve_client(int fd) {
+    // Slow clients can only stall the HTTP server thread, and only for a while
+    struct timeval timeout = { .tv_sec = 1 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // Buffer holding the request head
+    char request[METRICS_REQUEST_MAX];
+
+    // Number of bytes in the buffer
+    size_t length = 0;
+
+    // Read until the end of the request head
+    while (true) {
+      // Read into the free part of the buffer, keeping room for the terminator
+      ssize_t received = recv(fd, request + length, sizeof(request) - length - 1, 0);
+
+      // If the client disconnected or timed out
+      if (received == 0 || (received == -1 && errno != EINTR)) {
+        return;
+      }
+
+      // Retry if interrupted by a signal
+      if (received == -1) {
+        continue;
+      }
+
+      // Account for the received bytes
+      length += received;
+      request[length] = '\0';
+
+      // Stop at the end of the request head
+      if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL) {
+        break;
+      }
+
+      // Drop clients sending overlong requests
+      if (length == sizeof(request) - 1) {
+        return;
+      }
+    }
+
+    // Only the metrics are served
+    if (strncmp(request, "GET /metrics ", 13) != 0 && strncmp(request, "GET / ", 6) != 0) {
+      const char * response = "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 10\r\nConnection: close\r\n\r\nNot Found\n";
+      send_all(fd, response, strlen(response));
+      return;
+    }
+
+    // Buffer holding the body
+    char * body = NULL;
+    size_t bodyLength = 0;
+
+    // Open a stream writing into the buffer
+    FILE * stream = open_memstream(&body, &bodyLength);
+
+    // Check if the stream was opened
+    if (stream == NULL) {
+      return;
+    }
+
+    // Format the metrics from a copy of the counters
+    static metricsSnapshot snapshot;
+    take_snapshot(&snapshot);
+    format_metrics(stream, &snapshot);
+
+    // Finish the body
+    fclose(stream);
+
+    // Format the response head
+    char head[256];
+    int headLength = snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", bodyLength);
+
+    // Send the response
+    if (send_all(fd, head, headLength)) {
+      send_all(fd, body, bodyLength);
+    }
+
+    // Free the body
+    free(body);
+  }
+
+  static void * server_main(void * argument) {
+    // Serve clients one at a time until stopped
+    while (!ATOMIC_LOAD(&stopping)) {
+      // Wait for a connection
+      int fd = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC);
+
+      // If no connection was accepted
+      if (fd == -1) {
+        // Retry if interrupted or if the client gave up already
+        if (errno == EINTR || errno == ECONNABORTED) {
+          continue;
+        }
+
+        // Shutting down the listening socket ends the wait
+        if (!ATOMIC_LOAD(&stopping)) {
+          fprintf(stderr, "accept(): %s\n", strerror(errno));
+        }
+
+        break;
+      }
+
+      // Serve the client
+      serve_client(fd);
+
+      // Close the connection
+      close(fd);
+    }
+
+    // Return nothing
+    return NULL;
+  }
+
+  static bool start_server(const char * endpoint) {
+    // Copy the address, as it is split in place
+    char address[256];
+
+    if (strlen(endpoint) >= sizeof(address)) {
+      fprintf(stderr, "Metrics address is too long: %s\n", endpoint);
+      return false;
+    }
+
+    strcpy(address, endpoint);
+
+    // The address is either "port" or "host:port", IPv6 hosts are enclosed in brackets
+    char * host = NULL;
+    char * port = address;
+    char * separator = strrchr(address, ':');
+
+    if (separator != NULL) {
+      *separator = '\0';
+      host = address;
+      port = separator + 1;
+
+      // Strip the brackets of an IPv6 host
+      size_t hostLength = strlen(host);
+
+      if (hostLength >= 2 && host[0] == '[' && host[hostLength - 1] == ']') {
+        host[hostLength - 1] = '\0';
+        host++;
+      }
+    }
+
+    // Resolve the address
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = AI_PASSIVE };
+    struct addrinfo * result;
+
+    int ret = getaddrinfo(host, port, &hints, &result);
+
+    // Check if the address was resolved
+    if (ret != 0) {
+      fprintf(stderr, "Unable to resolve %s: %s\n", endpoint, gai_strerror(ret));
+      return false;
+    }
+
+    // Create the listening socket
+    listenFd = socket(result->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    // Check if the socket was created
+    if (listenFd == -1) {
+      fprintf(stderr, "socket(): %s\n", strerror(errno));
+      freeaddrinfo(result);
+      return false;
+    }
+
+    // Allow restarting the daemon while old connections linger
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    // Bind and listen
+    if (bind(listenFd, result->ai_addr, result->ai_addrlen) == -1 || listen(listenFd, SOMAXCONN) == -1) {
+      fprintf(stderr, "Unable to listen on %s: %s\n", endpoint, strerror(errno));
+      freeaddrinfo(result);
+      return false;
+    }
+
+    // Free the resolved address
+    freeaddrinfo(result);
+
+    // Keep signals on the main thread, so they interrupt its wait
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+
+    // Create the HTTP server thread, which inherits the blocked signals
+    stopping = false;
+    ret = pthread_create(&serverThread, NULL, server_main, NULL);
+
+    // Restore the signal mask of the main thread
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    // Check if the thread was created
+    if (ret != 0) {
+      fprintf(stderr, "pthread_create(): %s\n", strerror(ret));
+      return false;
+    }
+
+    // Mark the thread as running
+    serverRunning = true;
+
+    // Return true to indicate success
+    return true;
+  }
+#endif
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+bool metrics_init(const char * endpoint, const char * file) {
+  // If the metrics file is enabled
+  if (file != NULL) {
+    // Store the paths
+    filePath = strdup(file);
+    tempPath = malloc(strlen(file) + sizeof(".tmp"));
+
+    // Check if the paths were allocated
+    if (filePath == NULL || tempPath == NULL) {
+      fprintf(stderr, "Unable to allocate the metrics file path\n");
+      metrics_deinit();
+      return false;
+    }
+
+    // The temporary copy lives next to the file, so it can be renamed over it
+    sprintf(tempPath, "%s.tmp", file);
+
+    // Write the file right away
+    lastWrite = get_time_ns();
+    write_file();
+  }
+
+  // If the HTTP server is enabled
+  if (endpoint != NULL) {
+    #ifdef __linux__
+      // Start the HTTP server
+      if (!start_server(endpoint)) {
+        metrics_deinit();
+        return false;
+      }
+    #else
+      // The HTTP server is not available on this platform
+      fprintf(stderr, "The metrics HTTP server is only supported on Linux\n");
+      metrics_deinit();
+      return false;
+    #endif
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+void metrics_deinit(void) {
+  #ifdef __linux__
+    // If the HTTP server thread is running
+    if (serverRunning) {
+      // Ask the thread to stop and wake it up from accept()
+      ATOMIC_STORE(&stopping, true);
+      shutdown(listenFd, SHUT_RDWR);
+
+      // Wait for the thread to finish the current client
+      pthread_join(serverThread, NULL);
+
+      // Mark the thread as stopped
+      serverRunning = false;
+    }
+
+    // Close the listening socket
+    if (listenFd != -1) {
+      close(listenFd);
+      listenFd = -1;
+    }
+  #endif
+
+  // If the metrics file is enabled
+  if (filePath != NULL && tempPath != NULL) {
+    // Write the final counters
+    write_file();
+  }
+
+  // Free the paths
+  SAFE_FREE(filePath);
+  SAFE_FREE(tempPath);
+}
+
+void metrics_update(void) {
+  // If the metrics file is disabled
+  if (filePath == NULL) {
+    return;
+  }
+
+  // Get the current time
+  unsigned long long now = get_time_ns();
+
+  // Rewrite the file at most once per interval
+  if (now - lastWrite >= (unsigned long long) METRICS_FILE_INTERVAL * 1000000ULL) {
+    lastWrite = now;
+    write_file();
+  }
+}
+
+void metrics_pstate(unsigned int gpu, unsigned int pstateId) {
+  // Validate the arguments
+  if (gpu >= METRICS_GPUS_MAX || pstateId >= METRICS_PSTATES) {
+    return;
+  }
+
+  // Get the current time
+  unsigned long long now = get_time_ns();
+
+  // Update the counters of the GPU
+  METRICS_LOCK();
+
+  metricsGpu * state = &counters.gpus[gpu];
+
+  // If the previous performance state is known
+  if (state->seen) {
+    // Account for the time spent in it
+    state->residency[state->pstateId] += now - state->since;
+
+    // Count real transitions only
+    if (pstateId != state->pstateId) {
+      if (pstate_rank(pstateId) < pstate_rank(state->pstateId)) {
+        state->transitionsUp++;
+      } else {
+        state->transitionsDown++;
+      }
+    }
+  }
+
+  // Store the new performance state
+  state->seen = true;
+  state->pstateId = pstateId;
+  state->since = now;
+
+  METRICS_UNLOCK();
+}
+
+void metrics_thermal_override(unsigned int gpu) {
+  // Validate the arguments
+  if (gpu >= METRICS_GPUS_MAX) {
+    return;
+  }
+
+  // Count the override
+  METRICS_LOCK();
+  counters.gpus[gpu].thermalOverrides++;
+  METRICS_UNLOCK();
+}
+
+void metrics_fault(unsigned int gpu) {
+  // Validate the arguments
+  if (gpu >= METRICS_GPUS_MAX) {
+    return;
+  }
+
+  // Count the fault and mark the GPU as quarantined
+  METRICS_LOCK();
+  counters.gpus[gpu].faults++;
+  counters.gpus[gpu].quarantined = true;
+  METRICS_UNLOCK();
+}
+
+void metrics_recovered(unsigned int gpu) {
+  // Validate the arguments
+  if (gpu >= METRICS_GPUS_MAX) {
+    return;
+  }
+
+  // Release the GPU from quarantine
+  METRICS_LOCK();
+  counters.gpus[gpu].quarantined = false;
+  METRICS_UNLOCK();
+}
+
+void metrics_temperature(unsigned int gpu, unsigned int temperature) {
+  // Validate the arguments
+  if (gpu >= METRICS_GPUS_MAX) {
+    return;
+  }
+
+  // Store the temperature
+  METRICS_LOCK();
+  counters.gpus[gpu].temperature = temperature;
+  counters.gpus[gpu].temperatureSampled = true;
+  METRICS_UNLOCK();
+}
+
+void metrics_utilization(unsigned int gpu, unsigned int utilization) {
+  // Validate the arguments
+  if (gpu >= METRICS_GPUS_MAX) {
+    return;
+  }
+
+  // Store the utilization
+  METRICS_LOCK();
+  counters.gpus[gpu].utilization = utilization;
+  counters.gpus[gpu].utilizationSampled = true;
+  METRICS_UNLOCK();
+}
+
+void metrics_memory_temperature(unsigned int gpu, unsigned int temperature) {
+  // Validate the arguments
+  if (gpu >= METRICS_GPUS_MAX) {
+    return;
+  }
+
+  // Store the memory temperature
+  METRICS_LOCK();
+  counters.gpus[gpu].memoryTemperature = temperature;
+  counters.gpus[gpu].memoryTemperatureSampled = true;
+  METRICS_UNLOCK();
+}
+
+void metrics_power(unsigned int gpu, unsigned int milliwatts) {
+  // Validate the arguments
+  if (gpu >= METRICS_GPUS_MAX) {
+    return;
+  }
+
+  // Store the power draw
+  METRICS_LOCK();
+  counters.gpus[gpu].power = milliwatts;
+  counters.gpus[gpu].powerSampled = true;
+  METRICS_UNLOCK();
+}
+
+void metrics_fan_script(bool isEnableScript) {
+  // Count the invocation
+  METRICS_LOCK();
+  counters.fanScripts[isEnableScript ? 1 : 0]++;
+  METRICS_UNLOCK();
+}
+
+void metrics_fan_script_result(bool isEnableScript, int exitCode) {
+  // Store the result
+  METRICS_LOCK();
+  counters.fanScriptResults[isEnableScript ? 1 : 0] = exitCode;
+  counters.fanScriptsFinished[isEnableScript ? 1 : 0] = true;
+  METRICS_UNLOCK();
+}
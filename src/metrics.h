@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs tracked (matches NVAPI_MAX_PHYSICAL_GPUS)
+#define METRICS_GPUS_MAX 64
+
+// Number of performance states tracked, P0 to P15 and 16 for automatic management
+#define METRICS_PSTATES 17
+
+// Interval between writes of the metrics file (in milliseconds)
+#define METRICS_FILE_INTERVAL 1000
+
+// Maximum length of an HTTP request head
+#define METRICS_REQUEST_MAX 4096
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool metrics_init(const char * endpoint, const char * file);
+void metrics_deinit(void);
+void metrics_update(void);
+void metrics_pstate(unsigned int gpu, unsigned int pstateId);
+void metrics_thermal_override(unsigned int gpu);
+void metrics_fault(unsigned int gpu);
+void metrics_recovered(unsigned int gpu);
+void metrics_temperature(unsigned int gpu, unsigned int temperature);
+void metrics_utilization(unsigned int gpu, unsigned int utilization);
+void metrics_memory_temperature(unsigned int gpu, unsigned int temperature);
+void metrics_power(unsigned int gpu, unsigned int milliwatts);
+void metrics_fan_script(bool isEnableScript);
+void metrics_fan_script_result(bool isEnableScript, int exitCode);
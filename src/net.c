@@ -0,0 +1,262 @@
+#include "net.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+  #include <netdb.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <poll.h>
+  #include <sys/socket.h>
+  #include <sys/un.h>
+  #include <unistd.h>
+#endif
+
+#include "utils.h"
+
+#ifdef __linux__
+  /***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+  static bool unix_address(const char * path, struct sockaddr_un * address) {
+    // Initialize the address
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+
+    // Validate the path length
+    if (strlen(path) >= sizeof(address->sun_path)) {
+      fprintf(stderr, "Socket path is too long: %s\n", path);
+      return false;
+    }
+
+    // Copy the path
+    strcpy(address->sun_path, path);
+
+    // Return true to indicate success
+    return true;
+  }
+
+  static struct addrinfo * resolve(const char * endpoint, bool passive) {
+    // Copy the address, as it is split in place
+    char address[256];
+
+    if (strlen(endpoint) >= sizeof(address)) {
+      fprintf(stderr, "Address is too long: %s\n", endpoint);
+      return NULL;
+    }
+
+    strcpy(address, endpoint);
+
+    // The address is either "port" or "host:port", IPv6 hosts are enclosed in brackets
+    char * host = NULL;
+    char * port = address;
+    char * separator = strrchr(address, ':');
+
+    if (separator != NULL) {
+      *separator = '\0';
+      host = address;
+      port = separator + 1;
+
+      // Strip the brackets of an IPv6 host
+      size_t hostLength = strlen(host);
+
+      if (hostLength >= 2 && host[0] == '[' && host[hostLength - 1] == ']') {
+        host[hostLength - 1] = '\0';
+        host++;
+      }
+    }
+
+    // Resolve the address, a name lookup is not covered by any timeout
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = passive ? AI_PASSIVE : 0 };
+    struct addrinfo * result;
+
+    int ret = getaddrinfo(host, port, &hints, &result);
+
+    // Check if the address was resolved
+    if (ret != 0) {
+      fprintf(stderr, "Unable to resolve %s: %s\n", endpoint, gai_strerror(ret));
+      return NULL;
+    }
+
+    // Return the resolved addresses
+    return result;
+  }
+
+  static bool finish_connect(int fd, unsigned long timeout) {
+    // Wait for the connection, retrying if interrupted by a signal
+    struct pollfd pfd = { fd, POLLOUT, 0 };
+    int ret;
+
+    while ((ret = poll(&pfd, 1, (int) timeout)) == -1 && errno == EINTR);
+
+    // Variable to hold the connection error
+    int error = 0;
+    socklen_t length = sizeof(error);
+
+    // Check if the connection was established
+    return ret == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+  }
+
+  /***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+  int net_listen(const char * address) {
+    // Listening socket
+    int fd;
+
+    // Get the path of a UNIX socket
+    const char * path = net_unix_path(address);
+
+    // If listening on a UNIX socket
+    if (path != NULL) {
+      // Build the address
+      struct sockaddr_un local;
+
+      if (!unix_address(path, &local)) {
+        return -1;
+      }
+
+      // Create the listening socket
+      fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+      if (fd == -1) {
+        fprintf(stderr, "socket(): %s\n", strerror(errno));
+        return -1;
+      }
+
+      // Remove a stale socket left by a previous instance
+      unlink(path);
+
+      // Bind and listen
+      if (bind(fd, (struct sockaddr *) &local, sizeof(local)) == -1 || listen(fd, SOMAXCONN) == -1) {
+        fprintf(stderr, "Unable to listen on %s: %s\n", address, strerror(errno));
+        close(fd);
+        return -1;
+      }
+
+      // Return the listening socket
+      return fd;
+    }
+
+    // Resolve the address
+    struct addrinfo * result = resolve(address, true);
+
+    if (result == NULL) {
+      return -1;
+    }
+
+    // Create the listening socket
+    fd = socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd == -1) {
+      fprintf(stderr, "socket(): %s\n", strerror(errno));
+      freeaddrinfo(result);
+      return -1;
+    }
+
+    // Allow restarting while old connections linger
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    // Bind and listen
+    if (bind(fd, result->ai_addr, result->ai_addrlen) == -1 || listen(fd, SOMAXCONN) == -1) {
+      fprintf(stderr, "Unable to listen on %s: %s\n", address, strerror(errno));
+      freeaddrinfo(result);
+      close(fd);
+      return -1;
+    }
+
+    // Free the resolved address
+    freeaddrinfo(result);
+
+    // Return the listening socket
+    return fd;
+  }
+
+  int net_connect(const char * address, unsigned long timeout) {
+    // Get the path of a UNIX socket
+    const char * path = net_unix_path(address);
+
+    // If connecting to a UNIX socket
+    if (path != NULL) {
+      // Build the address
+      struct sockaddr_un remote;
+
+      if (!unix_address(path, &remote)) {
+        return -1;
+      }
+
+      // Create the socket
+      int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+      if (fd == -1) {
+        return -1;
+      }
+
+      // Connect, a local peer accepts or refuses right away
+      if (connect(fd, (struct sockaddr *) &remote, sizeof(remote)) == -1) {
+        close(fd);
+        return -1;
+      }
+
+      // Return the connected socket
+      return fd;
+    }
+
+    // Resolve the address
+    struct addrinfo * addresses = resolve(address, false);
+
+    if (addresses == NULL) {
+      return -1;
+    }
+
+    // Try each address in turn
+    for (struct addrinfo * remote = addresses; remote != NULL; remote = remote->ai_next) {
+      // Create a non-blocking socket, so the connection can time out
+      int fd = socket(remote->ai_family, remote->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, remote->ai_protocol);
+
+      if (fd == -1) {
+        continue;
+      }
+
+      // Connect
+      if (connect(fd, remote->ai_addr, remote->ai_addrlen) == -1 && (errno != EINPROGRESS || !finish_connect(fd, timeout))) {
+        close(fd);
+        continue;
+      }
+
+      // Send small messages without waiting for more data
+      int enable = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+      // Return the connected socket
+      freeaddrinfo(addresses);
+      return fd;
+    }
+
+    // Free the addresses
+    freeaddrinfo(addresses);
+
+    // Return -1 to indicate failure
+    return -1;
+  }
+#else
+  /***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+  int net_listen(const char * address) {
+    // Print an error message
+    fprintf(stderr, "Sockets are not supported on this platform\n");
+
+    // Return -1 to indicate failure
+    return -1;
+  }
+
+  int net_connect(const char * address, unsigned long timeout) {
+    return -1;
+  }
+#endif
+
+const char * net_unix_path(const char * address) {
+  // Return the path following the prefix, NULL for network addresses
+  return strncmp(address, NET_UNIX_PREFIX, strlen(NET_UNIX_PREFIX)) == 0 ? address + strlen(NET_UNIX_PREFIX) : NULL;
+}
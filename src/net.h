@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Prefix of addresses naming a UNIX socket
+#define NET_UNIX_PREFIX "unix:"
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+int net_listen(const char * address);
+int net_connect(const char * address, unsigned long timeout);
+const char * net_unix_path(const char * address);
@@ -16,6 +16,7 @@ typedef void * (*nvapi_QueryInterface_t)(int);
 
 typedef NvAPI_Status (*NvAPI_EnumPhysicalGPUs_t)(NvPhysicalGpuHandle[NVAPI_MAX_PHYSICAL_GPUS], NvU32 *);
 typedef NvAPI_Status (*NvAPI_GPU_GetBusId_t)(NvPhysicalGpuHandle, NvU32 *);
+typedef NvAPI_Status (*NvAPI_GPU_GetBusSlotId_t)(NvPhysicalGpuHandle, NvU32 *);
 typedef NvAPI_Status (*NvAPI_GPU_SetForcePstate_t)(NvPhysicalGpuHandle, NvU32, NvU32);
 typedef NvAPI_Status (*NvAPI_GetErrorMessage_t)(NvAPI_Status, NvAPI_ShortString);
 typedef NvAPI_Status (*NvAPI_Initialize_t)();
@@ -27,6 +28,7 @@ static void * lib;
 
 static NvAPI_EnumPhysicalGPUs_t   _NvAPI_EnumPhysicalGPUs;
 static NvAPI_GPU_GetBusId_t       _NvAPI_GPU_GetBusId;
+static NvAPI_GPU_GetBusSlotId_t   _NvAPI_GPU_GetBusSlotId;
 static NvAPI_GPU_SetForcePstate_t _NvAPI_GPU_SetForcePstate;
 static NvAPI_GetErrorMessage_t    _NvAPI_GetErrorMessage;
 static NvAPI_Initialize_t         _NvAPI_Initialize;
@@ -58,6 +60,14 @@ NvAPI_Status NvAPI_GPU_GetBusId(NvPhysicalGpuHandle hPhysicalGpu, NvU32 * pBusId
   return _NvAPI_GPU_GetBusId(hPhysicalGpu, pBusId);
 }
 
+NvAPI_Status NvAPI_GPU_GetBusSlotId(NvPhysicalGpuHandle hPhysicalGpu, NvU32 * pBusSlotId) {
+  // Ensure the function pointer is valid
+  NVAPI_POINTER(_NvAPI_GPU_GetBusSlotId);
+
+  // Invoke the function using the provided parameters
+  return _NvAPI_GPU_GetBusSlotId(hPhysicalGpu, pBusSlotId);
+}
+
 NvAPI_Status NvAPI_GPU_SetForcePstate(NvPhysicalGpuHandle hPhysicalGpu, NvU32 pstateId, NvU32 fallbackState) {
   // Ensure the function pointer is valid
   NVAPI_POINTER(_NvAPI_GPU_SetForcePstate);
@@ -125,6 +135,7 @@ NvAPI_Status NvAPI_Initialize() {
   // Retrieve the addresses of specific NvAPI functions using nvapi_QueryInterface
   _NvAPI_EnumPhysicalGPUs = (NvAPI_EnumPhysicalGPUs_t) nvapi_QueryInterface(0xe5ac921f);
   _NvAPI_GPU_GetBusId = (NvAPI_GPU_GetBusId_t) nvapi_QueryInterface(0x1be0b8e5);
+  _NvAPI_GPU_GetBusSlotId = (NvAPI_GPU_GetBusSlotId_t) nvapi_QueryInterface(0x2a0a350f);
   _NvAPI_GPU_SetForcePstate = (NvAPI_GPU_SetForcePstate_t) nvapi_QueryInterface(0x025bfb10);
   _NvAPI_GetErrorMessage = (NvAPI_GetErrorMessage_t) nvapi_QueryInterface(0x6c2d048c);
   _NvAPI_Initialize = (NvAPI_Initialize_t) nvapi_QueryInterface(0x0150e828);
@@ -150,6 +161,8 @@ NvAPI_Status NvAPI_Unload() {
     if (lib) {
       // Nullify all the function pointers to prevent further use
       _NvAPI_EnumPhysicalGPUs = NULL;
+      _NvAPI_GPU_GetBusId = NULL;
+      _NvAPI_GPU_GetBusSlotId = NULL;
       _NvAPI_GPU_SetForcePstate = NULL;
       _NvAPI_GetErrorMessage = NULL;
       _NvAPI_Initialize = NULL;
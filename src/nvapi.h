@@ -5,12 +5,18 @@
 
 #include <nvapi.h>
 
+#include "fault.h"
+#include "latency.h"
+
 /***** ***** ***** ***** ***** MACROS ***** ***** ***** ***** *****/
 
 // Macro to simplify NVAPI function calls and handle errors
 #define NVAPI_CALL(call, label) do {                                 \
-  /* Evaluate the NVAPI function call and store the result */        \
-  NvAPI_Status result = (call);                                      \
+  /* Variable to hold the result */                                  \
+  NvAPI_Status result;                                               \
+                                                                     \
+  /* Evaluate the NVAPI function call, timing it */                  \
+  LATENCY_CALL(result, call);                                        \
                                                                      \
   /* Check if the result indicates an error */                       \
   if (result != NVAPI_OK) {                                          \
@@ -25,6 +31,9 @@
     /* Print the error message to standard error */                  \
     fprintf(stderr, "%s: %s\n", #call, error);                       \
                                                                      \
+    /* Keep the kind of the error for the fault isolation */         \
+    fault_nvapi(result);                                             \
+                                                                     \
     /* Jump to the specified label */                                \
     goto label;                                                      \
   }                                                                  \
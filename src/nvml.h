@@ -4,18 +4,27 @@
 
 #include <nvml.h>
 
+#include "fault.h"
+#include "latency.h"
+
 /***** ***** ***** ***** ***** MACROS ***** ***** ***** ***** *****/
 
 // Macro to simplify NVML function calls and handle errors
 #define NVML_CALL(call, label) do {                              \
-  /* Evaluate the NVML function call and store the result */     \
-  nvmlReturn_t result = (call);                                  \
+  /* Variable to hold the result */                              \
+  nvmlReturn_t result;                                           \
+                                                                 \
+  /* Evaluate the NVML function call, timing it */               \
+  LATENCY_CALL(result, call);                                    \
                                                                  \
   /* Check if the result indicates an error */                   \
   if (result != NVML_SUCCESS) {                                  \
     /* Print the error message to standard error */              \
     fprintf(stderr, "%s: %s\n", #call, nvmlErrorString(result)); \
                                                                  \
+    /* Keep the kind of the error for the fault isolation */     \
+    fault_nvml(result);                                          \
+                                                                 \
     /* Jump to the specified label */                            \
     goto label;                                                  \
   }                                                              \
@@ -0,0 +1,290 @@
+#include "policy.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static size_t ladder_index(const policyConfig * config, unsigned int pstateId) {
+  // Find the fastest step that is not faster than the performance state, a state off the ladder counts as the step below it
+  size_t index = 0;
+
+  for (size_t i = 1; i < config->ladderSteps; i++) {
+    if (policy_rank(config->ladder[i].pstateId) >= policy_rank(pstateId)) {
+      index = i;
+    }
+  }
+
+  // Return the index of the step
+  return index;
+}
+
+static void update_average(const policyConfig * config, policyState * state, const policySample * sample) {
+  // Move the average towards the newest sample
+  state->average += (sample->utilization - state->average) * config->ewmaWeight / 100.0;
+
+  // The decay never reaches zero on its own, it stalls at the smallest denormal and stays above a threshold of 0; a light load still builds up
+  if (sample->utilization == 0 && state->average < 0.5) {
+    state->average = 0;
+  }
+}
+
+/***** ***** ***** ***** ***** POLICIES ***** ***** ***** ***** *****/
+
+static unsigned int decide_iterations(const policyConfig * config, policyState * state, const policySample * sample, unsigned int pstateId) {
+  // Check if the GPU utilization is above the defined threshold
+  if (sample->utilization > config->utilizationThreshold) {
+    // Reset the iteration counter
+    state->iterations = 0;
+
+    // Switch to high performance state
+    return config->performanceStateHigh;
+  }
+
+  // If the GPU is already in low performance state
+  if (pstateId == config->performanceStateLow) {
+    // Stay there
+    return pstateId;
+  }
+
+  // If the number of iterations exceeds the threshold
+  if (state->iterations > config->iterationsBeforeSwitch) {
+    // Switch to low performance state
+    return config->performanceStateLow;
+  }
+
+  // Increment the iteration counter
+  state->iterations++;
+
+  // Stay in the current performance state
+  return pstateId;
+}
+
+static unsigned int decide_ewma(const policyConfig * config, policyState * state, const policySample * sample, unsigned int pstateId) {
+  // Update the moving average with the newest sample
+  update_average(config, state, sample);
+
+  // Check if the average utilization is above the up threshold
+  if (state->average > config->utilizationThresholdUp) {
+    // Remember the GPU as busy
+    state->busyTime = sample->time;
+
+    // Switch to high performance state
+    return config->performanceStateHigh;
+  }
+
+  // If the GPU is already in low performance state
+  if (pstateId == config->performanceStateLow) {
+    // Stay there
+    return pstateId;
+  }
+
+  // Between the thresholds the GPU keeps counting as busy
+  if (state->average > config->utilizationThresholdDown) {
+    // Remember the GPU as busy
+    state->busyTime = sample->time;
+
+    // Stay in the current performance state
+    return pstateId;
+  }
+
+  // If the GPU has been idle for longer than the hold time
+  if (sample->time - state->busyTime >= (unsigned long long) config->holdTime * 1000000ULL) {
+    // Switch to low performance state
+    return config->performanceStateLow;
+  }
+
+  // Stay in the current performance state
+  return pstateId;
+}
+
+static unsigned int decide_ladder(const policyConfig * config, policyState * state, const policySample * sample, unsigned int pstateId) {
+  // Update the moving average with the newest sample
+  update_average(config, state, sample);
+
+  // Get the step the GPU is on
+  size_t current = ladder_index(config, pstateId);
+
+  // Find the highest step whose band the average reaches
+  size_t target = 0;
+
+  for (size_t i = 1; i < config->ladderSteps; i++) {
+    if (state->average > config->ladder[i].utilization) {
+      target = i;
+    }
+  }
+
+  // If the average reaches the band of the current step or above
+  if (target >= current) {
+    // Remember the GPU as busy on this step
+    state->busyTime = sample->time;
+
+    // Climb straight to the band of the average
+    return config->ladder[target].pstateId;
+  }
+
+  // If the average has stayed below the band for longer than the hold time of the step
+  if (sample->time - state->busyTime >= (unsigned long long) config->ladder[current].holdTime * 1000000ULL) {
+    // Step down once, the next step starts its own hold time
+    return config->ladder[current - 1].pstateId;
+  }
+
+  // Stay in the current performance state
+  return pstateId;
+}
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Available policies
+static const policy policies[] = {
+  // Switch up on any sample above the threshold, down after a number of idle iterations
+  { "iterations", decide_iterations },
+
+  // Switch on the moving average with separate thresholds, down after a hold time
+  { "ewma", decide_ewma },
+
+  // Climb to the step whose band holds the moving average, down one step at a time after the hold time of each step
+  { "ladder", decide_ladder },
+};
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+const policy * policy_find(const char * name) {
+  // Look up the policy by name
+  for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+    if (strcmp(policies[i].name, name) == 0) {
+      return &policies[i];
+    }
+  }
+
+  // Return NULL if there is no such policy
+  return NULL;
+}
+
+void policy_reset(policyState * state, unsigned long long time) {
+  // Reset the iteration counter
+  state->iterations = 0;
+
+  // Treat the GPU as busy as of now
+  state->busyTime = time;
+}
+
+int policy_rank(unsigned int pstateId) {
+  // Automatic management allows the highest performance, otherwise P0 is the fastest
+  return pstateId == 16 ? -1 : (int) pstateId;
+}
+
+bool policy_parse_ladder(const char * value, policyStep * steps, size_t * count) {
+  // Duplicate the value, as it is split in place
+  char * string = strdup(value);
+
+  // Check if string duplication failed
+  if (string == NULL) {
+    return false;
+  }
+
+  // Split the value into steps, "<pstate>" for the first and "<pstate>:<utilization>[:<hold time>]" for the others
+  char * tokens[LADDER_STEPS_MAX + 1];
+  size_t tokenCount = 0;
+
+  for (char * token = strtok(string, ","); token != NULL && tokenCount <= LADDER_STEPS_MAX; token = strtok(NULL, ",")) {
+    tokens[tokenCount++] = token;
+  }
+
+  // A ladder has at least two steps
+  bool valid = tokenCount >= 2 && tokenCount <= LADDER_STEPS_MAX;
+
+  // Parse each step
+  for (size_t i = 0; valid && i < tokenCount; i++) {
+    // Fields of the step
+    unsigned long fields[3];
+    size_t fieldCount;
+
+    // Parse the fields, the first step has no band as the GPU falls back to it
+    if (!parse_ulong_array(tokens[i], ":", 3, fields, &fieldCount) || (i == 0 ? fieldCount != 1 : fieldCount < 2)) {
+      valid = false;
+      break;
+    }
+
+    // Fill the step, the hold time defaults to --hold-time
+    steps[i].pstateId = fields[0];
+    steps[i].utilization = i == 0 ? 0 : fields[1];
+    steps[i].holdTime = fieldCount == 3 ? fields[2] : ULONG_MAX;
+
+    // Steps are performance states from P15 to automatic management
+    if (steps[i].pstateId > 16) {
+      valid = false;
+    }
+
+    // Each step is faster than the previous one and starts at a higher utilization, below 100%
+    if (i != 0 && (policy_rank(steps[i].pstateId) >= policy_rank(steps[i - 1].pstateId) || (i > 1 && steps[i].utilization <= steps[i - 1].utilization) || steps[i].utilization >= 100)) {
+      valid = false;
+    }
+  }
+
+  // Free the duplicated string
+  SAFE_FREE(string);
+
+  // Store the number of steps
+  if (valid) {
+    *count = tokenCount;
+  }
+
+  // Return whether the ladder is valid
+  return valid;
+}
+
+void policy_set_ladder(policyConfig * config, const policyStep * steps, size_t count) {
+  // Copy the steps
+  for (size_t i = 0; i < count; i++) {
+    config->ladder[i] = steps[i];
+
+    // Steps without their own hold time use the hold time of the policy
+    if (config->ladder[i].holdTime == ULONG_MAX) {
+      config->ladder[i].holdTime = config->holdTime;
+    }
+  }
+
+  // Store the number of steps
+  config->ladderSteps = count;
+
+  // The ends of the ladder are the low and the high performance states
+  config->performanceStateLow = steps[0].pstateId;
+  config->performanceStateHigh = steps[count - 1].pstateId;
+}
+
+unsigned int policy_step_down(const policyConfig * config, unsigned int pstateId) {
+  // Without a ladder, the GPU falls back to the low performance state
+  if (config->ladderSteps == 0) {
+    return config->performanceStateLow;
+  }
+
+  // Get the step the GPU is on
+  size_t index = ladder_index(config, pstateId);
+
+  // Return the step below, a state off the ladder falls to the step below it
+  if (config->ladder[index].pstateId != pstateId) {
+    return config->ladder[index].pstateId;
+  }
+
+  return config->ladder[index > 0 ? index - 1 : 0].pstateId;
+}
+
+unsigned int policy_overheated(const policyConfig * config, policyState * state, unsigned long long time, unsigned int pstateId) {
+  // Step down as soon as the GPU overheats, then again while it stays overheated
+  if (state->thermalTime == 0 || time - state->thermalTime >= (unsigned long long) THERMAL_STEP_TIME * 1000000ULL) {
+    state->thermalTime = time;
+    return policy_step_down(config, pstateId);
+  }
+
+  // Give the previous step time to cool the GPU
+  return pstateId;
+}
+
+void policy_cooled(policyState * state) {
+  // The next overheat steps down right away
+  state->thermalTime = 0;
+}
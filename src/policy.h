@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Weight of the newest sample in the moving average (in percentage)
+#define EWMA_WEIGHT 30
+
+// Time to stay in high performance state after the GPU was last busy (in milliseconds)
+#define HOLD_TIME 3000
+
+// Number of iterations to wait before switching states
+#define ITERATIONS_BEFORE_SWITCH 30
+
+// Maximum number of steps of the ladder policy
+#define LADDER_STEPS_MAX 8
+
+// High performance state for the GPU
+#define PERFORMANCE_STATE_HIGH 16
+
+// Low performance state for the GPU
+#define PERFORMANCE_STATE_LOW 8
+
+// Temperature threshold (in degrees C)
+#define TEMPERATURE_THRESHOLD 80
+
+// Time between two steps down while the GPU stays above the temperature threshold (in milliseconds)
+#define THERMAL_STEP_TIME 1000
+
+// Utilization threshold (in percentage)
+#define UTILIZATION_THRESHOLD 0
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold a step of the ladder policy
+typedef struct {
+  // Performance state of the step
+  unsigned long pstateId;
+
+  // Average utilization above which the GPU climbs to the step (in percentage)
+  unsigned long utilization;
+
+  // Time to stay on the step after the average utilization fell to the threshold (in milliseconds)
+  unsigned long holdTime;
+} policyStep;
+
+// Structure to hold the configuration shared by all policies
+typedef struct {
+  // Number of iterations to wait before switching to low performance state
+  unsigned long iterationsBeforeSwitch;
+
+  // Utilization threshold (in percentage)
+  unsigned long utilizationThreshold;
+
+  // Utilization above which the GPU switches to high performance state (in percentage)
+  unsigned long utilizationThresholdUp;
+
+  // Utilization at or below which the GPU may switch to low performance state (in percentage)
+  unsigned long utilizationThresholdDown;
+
+  // Weight of the newest sample in the moving average (in percentage)
+  unsigned long ewmaWeight;
+
+  // Time to stay in high performance state after the GPU was last busy (in milliseconds)
+  unsigned long holdTime;
+
+  // High performance state for the GPU
+  unsigned long performanceStateHigh;
+
+  // Low performance state for the GPU
+  unsigned long performanceStateLow;
+
+  // Steps of the ladder policy, from the low to the high performance state
+  policyStep ladder[LADDER_STEPS_MAX];
+
+  // Number of steps of the ladder policy, zero for the other policies
+  size_t ladderSteps;
+} policyConfig;
+
+// Structure to hold the per GPU state of a policy
+typedef struct {
+  // Counter for iterations since the GPU was last busy
+  unsigned int iterations;
+
+  // Moving average of the utilization (in percentage)
+  double average;
+
+  // Time the GPU was last busy (in nanoseconds)
+  unsigned long long busyTime;
+
+  // Time of the latest step down while overheated (in nanoseconds), zero if not overheated
+  unsigned long long thermalTime;
+} policyState;
+
+// Structure to hold a sample passed to a policy
+typedef struct {
+  // Time of the sample (in nanoseconds)
+  unsigned long long time;
+
+  // GPU utilization (in percentage)
+  unsigned int utilization;
+} policySample;
+
+// Structure describing a policy
+typedef struct {
+  // Name of the policy
+  const char * name;
+
+  // Function returning the desired performance state for the sample
+  unsigned int (*decide)(const policyConfig * config, policyState * state, const policySample * sample, unsigned int pstateId);
+} policy;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+const policy * policy_find(const char * name);
+void policy_reset(policyState * state, unsigned long long time);
+int policy_rank(unsigned int pstateId);
+bool policy_parse_ladder(const char * value, policyStep * steps, size_t * count);
+void policy_set_ladder(policyConfig * config, const policyStep * steps, size_t count);
+unsigned int policy_step_down(const policyConfig * config, unsigned int pstateId);
+unsigned int policy_overheated(const policyConfig * config, policyState * state, unsigned long long time, unsigned int pstateId);
+void policy_cooled(policyState * state);
@@ -0,0 +1,146 @@
+#include "record.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "utils.h"
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Recording being written
+static FILE * recording = NULL;
+
+// Difference between the wall clock and the monotonic clock when the recording was opened (in nanoseconds)
+static unsigned long long wallOffset = 0;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static void append(uint8_t type, unsigned int gpu, uint32_t value1, uint32_t value2) {
+  // If not recording
+  if (recording == NULL) {
+    return;
+  }
+
+  // Build the record; the monotonic clock keeps the times ordered within a run
+  recordEntry entry = { 0 };
+  entry.time = get_time_ns() + wallOffset;
+  entry.type = type;
+  entry.gpu = (uint8_t) gpu;
+  entry.value1 = value1;
+  entry.value2 = value2;
+
+  // Append the record, stdio locks the stream, so workers can record concurrently
+  fwrite(&entry, sizeof(entry), 1, recording);
+}
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+bool record_open(const char * path) {
+  // Open the recording for appending
+  recording = fopen(path, "ab");
+
+  // Check if the recording was opened
+  if (recording == NULL) {
+    fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+    return false;
+  }
+
+  // Move to the end, as the position of a stream opened for appending is unspecified
+  fseek(recording, 0, SEEK_END);
+
+  // If the recording is new
+  if (ftell(recording) == 0) {
+    // Write the header
+    recordHeader header = { 0 };
+    memcpy(header.magic, RECORD_MAGIC, sizeof(header.magic));
+    header.version = RECORD_VERSION;
+    header.recordSize = sizeof(recordEntry);
+
+    if (fwrite(&header, sizeof(header), 1, recording) != 1) {
+      fprintf(stderr, "Unable to write %s: %s\n", path, strerror(errno));
+      record_close();
+      return false;
+    }
+  } else {
+    // Check that the existing recording has a compatible header
+    FILE * stream = record_open_read(path);
+
+    if (stream == NULL) {
+      record_close();
+      return false;
+    }
+
+    fclose(stream);
+  }
+
+  // Get the wall clock time
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+
+  // Align the monotonic clock with the wall clock, so runs appended to the same recording line up
+  wallOffset = (unsigned long long) ts.tv_sec * 1000000000ULL + (unsigned long long) ts.tv_nsec - get_time_ns();
+
+  // Return true to indicate success
+  return true;
+}
+
+void record_close(void) {
+  // Close the recording
+  if (recording != NULL) {
+    fclose(recording);
+    recording = NULL;
+  }
+}
+
+void record_flush(void) {
+  // Push the buffered records to the file
+  if (recording != NULL) {
+    fflush(recording);
+  }
+}
+
+void record_sample(unsigned int gpu, unsigned int temperature, unsigned int utilization) {
+  // Append a sample record
+  append(RECORD_TYPE_SAMPLE, gpu, temperature, utilization);
+}
+
+void record_pstate(unsigned int gpu, unsigned int pstateId) {
+  // Append a decision record
+  append(RECORD_TYPE_PSTATE, gpu, pstateId, 0);
+}
+
+FILE * record_open_read(const char * path) {
+  // Open the recording for reading
+  FILE * stream = fopen(path, "rb");
+
+  // Check if the recording was opened
+  if (stream == NULL) {
+    fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+    return NULL;
+  }
+
+  // Read the header
+  recordHeader header;
+
+  if (fread(&header, sizeof(header), 1, stream) != 1) {
+    fprintf(stderr, "%s: missing header\n", path);
+    fclose(stream);
+    return NULL;
+  }
+
+  // Validate the header
+  if (memcmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) != 0 || header.version != RECORD_VERSION || header.recordSize != sizeof(recordEntry)) {
+    fprintf(stderr, "%s: not a recording of this version\n", path);
+    fclose(stream);
+    return NULL;
+  }
+
+  // Return the stream positioned at the first record
+  return stream;
+}
+
+bool record_read(FILE * stream, recordEntry * entry) {
+  // Read the next record, a truncated last record ends the recording
+  return fread(entry, sizeof(*entry), 1, stream) == 1;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Magic bytes at the start of a recording
+#define RECORD_MAGIC "NVPSTREC"
+
+// Version of the recording format
+#define RECORD_VERSION 1
+
+// Utilization value of samples taken without reading the utilization
+#define RECORD_NO_UTILIZATION UINT32_MAX
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Types of records
+typedef enum {
+  // Telemetry sample, value1 is the temperature and value2 the utilization
+  RECORD_TYPE_SAMPLE = 1,
+
+  // Performance state decision, value1 is the performance state
+  RECORD_TYPE_PSTATE = 2,
+} recordType;
+
+// Header at the start of a recording, all fields are in host byte order
+typedef struct {
+  // Magic bytes, RECORD_MAGIC without the terminator
+  char magic[8];
+
+  // Version of the format
+  uint32_t version;
+
+  // Size of each record (in bytes)
+  uint32_t recordSize;
+} recordHeader;
+
+// Fixed-size record
+typedef struct {
+  // Wall clock time of the record (in nanoseconds since the Unix epoch)
+  uint64_t time;
+
+  // Type of the record
+  uint8_t type;
+
+  // Index of the GPU
+  uint8_t gpu;
+
+  // Reserved, zero
+  uint16_t reserved;
+
+  // Values of the record, depending on the type
+  uint32_t value1;
+  uint32_t value2;
+
+  // Reserved, zero
+  uint32_t reserved2;
+} recordEntry;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool record_open(const char * path);
+void record_close(void);
+void record_flush(void);
+void record_sample(unsigned int gpu, unsigned int temperature, unsigned int utilization);
+void record_pstate(unsigned int gpu, unsigned int pstateId);
+FILE * record_open_read(const char * path);
+bool record_read(FILE * stream, recordEntry * entry);
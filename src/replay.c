@@ -0,0 +1,348 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "record.h"
+#include "simulate.h"
+#include "utils.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs in a recording (matches NVAPI_MAX_PHYSICAL_GPUS)
+#define REPLAY_GPUS_MAX 64
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the replay state of each GPU
+typedef struct {
+  // Simulated state and results
+  simulateGpu simulation;
+
+  // Last recorded performance state, SIMULATE_PSTATES if none yet
+  unsigned int recordedPstateId;
+
+  // Number of recorded transitions
+  unsigned long long recordedTransitions;
+} replayGpu;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Options
+static unsigned long ewmaWeight = EWMA_WEIGHT;
+static unsigned long holdTime = HOLD_TIME;
+static unsigned long iterationsBeforeSwitch = ITERATIONS_BEFORE_SWITCH;
+static policyStep ladder[LADDER_STEPS_MAX];
+static size_t ladderSteps = 0;
+static unsigned long performanceStateHigh = PERFORMANCE_STATE_HIGH;
+static unsigned long performanceStateLow = PERFORMANCE_STATE_LOW;
+static const policy * pstatePolicy = NULL;
+static unsigned long sleepInterval = 0;
+static unsigned long temperatureThreshold = TEMPERATURE_THRESHOLD;
+static unsigned long utilizationThreshold = UTILIZATION_THRESHOLD;
+static unsigned long utilizationThresholdDown = ULONG_MAX;
+static unsigned long utilizationThresholdUp = ULONG_MAX;
+
+// Configuration of the simulation
+static simulateConfig simulation;
+
+// Replay state of each GPU
+static replayGpu gpus[REPLAY_GPUS_MAX];
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static void replay_sample(replayGpu * gpu, const recordEntry * entry) {
+  // Run the sample through the simulated daemon
+  simulate_sample(&simulation, &gpu->simulation, entry->time, entry->value1, entry->value2, entry->value2 != RECORD_NO_UTILIZATION);
+}
+
+static void replay_pstate(replayGpu * gpu, const recordEntry * entry) {
+  // Count the recorded transitions
+  if (gpu->recordedPstateId != SIMULATE_PSTATES && gpu->recordedPstateId != entry->value1) {
+    gpu->recordedTransitions++;
+  }
+
+  // Store the recorded performance state
+  gpu->recordedPstateId = entry->value1;
+}
+
+static void print_report(void) {
+  // Loop through the GPUs
+  for (unsigned int i = 0; i < REPLAY_GPUS_MAX; i++) {
+    // Get the simulated state of the GPU
+    simulateGpu * gpu = &gpus[i].simulation;
+
+    // Skip GPUs without samples
+    if (!gpu->seen) {
+      continue;
+    }
+
+    // Total simulated time
+    unsigned long long total = simulate_total_time(gpu);
+
+    // Print the report
+    printf("GPU %u: %llu samples, %llu polls over %.1f s\n", i, gpu->samples, gpu->polls, total / 1e9);
+    printf("  recorded transitions: %llu\n", gpus[i].recordedTransitions);
+    printf("  replayed transitions: %llu (%llu up, %llu down, %llu thermal)\n", gpu->transitionsUp + gpu->transitionsDown, gpu->transitionsUp, gpu->transitionsDown, gpu->thermalOverrides);
+
+    for (unsigned int p = 0; p < SIMULATE_PSTATES; p++) {
+      if (gpu->residency[p] != 0) {
+        printf("  time in performance state %u: %.1f s (%.1f%%)\n", p, gpu->residency[p] / 1e9, total ? 100.0 * gpu->residency[p] / total : 0.0);
+      }
+    }
+
+    printf("  bursts started in low performance state: %llu of %llu\n", gpu->burstsLow, gpu->bursts);
+    printf("  busy time in low performance state: %.3f s\n", gpu->busyLow / 1e9);
+  }
+}
+
+/***** ***** ***** ***** ***** MAIN ***** ***** ***** ***** *****/
+
+int main(int argc, char * argv[]) {
+  // Path of the recording
+  const char * path = NULL;
+
+  /***** OPTION PARSING *****/
+  {
+    // Iterate through command-line arguments
+    for (unsigned int i = 1; i < argc; i++) {
+      // Check if the option is "-h" or "--help"
+      if ((IS_OPTION("-h") || IS_OPTION("--help"))) {
+        // Print usage instructions
+        goto usage;
+      }
+
+      // Check if the option is "-ew" or "--ewma-weight" and if there is a next argument
+      if ((IS_OPTION("-ew") || IS_OPTION("--ewma-weight")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in ewmaWeight
+        ASSERT_TRUE(parse_ulong(argv[++i], &ewmaWeight), usage);
+        continue;
+      }
+
+      // Check if the option is "-ht" or "--hold-time" and if there is a next argument
+      if ((IS_OPTION("-ht") || IS_OPTION("--hold-time")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in holdTime
+        ASSERT_TRUE(parse_ulong(argv[++i], &holdTime), usage);
+        continue;
+      }
+
+      // Check if the option is "-ibs" or "--iterations-before-switch" and if there is a next argument
+      if ((IS_OPTION("-ibs") || IS_OPTION("--iterations-before-switch")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in iterationsBeforeSwitch
+        ASSERT_TRUE(parse_ulong(argv[++i], &iterationsBeforeSwitch), usage);
+        continue;
+      }
+
+      // Check if the option is "-ld" or "--ladder" and if there is a next argument
+      if ((IS_OPTION("-ld") || IS_OPTION("--ladder")) && HAS_NEXT_ARG) {
+        // Parse the steps and store them in ladder
+        ASSERT_TRUE(policy_parse_ladder(argv[++i], ladder, &ladderSteps), usage);
+        continue;
+      }
+
+      // Check if the option is "-p" or "--policy" and if there is a next argument
+      if ((IS_OPTION("-p") || IS_OPTION("--policy")) && HAS_NEXT_ARG) {
+        // Look up the policy and store it in pstatePolicy
+        pstatePolicy = policy_find(argv[++i]);
+
+        // Check if the policy exists
+        ASSERT_TRUE(pstatePolicy != NULL, usage);
+        continue;
+      }
+
+      // Check if the option is "-psh" or "--performance-state-high" and if there is a next argument
+      if ((IS_OPTION("-psh") || IS_OPTION("--performance-state-high")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in performanceStateHigh
+        ASSERT_TRUE(parse_ulong(argv[++i], &performanceStateHigh), usage);
+        continue;
+      }
+
+      // Check if the option is "-psl" or "--performance-state-low" and if there is a next argument
+      if ((IS_OPTION("-psl") || IS_OPTION("--performance-state-low")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in performanceStateLow
+        ASSERT_TRUE(parse_ulong(argv[++i], &performanceStateLow), usage);
+        continue;
+      }
+
+      // Check if the option is "-si" or "--sleep-interval" and if there is a next argument
+      if ((IS_OPTION("-si") || IS_OPTION("--sleep-interval")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in sleepInterval
+        ASSERT_TRUE(parse_ulong(argv[++i], &sleepInterval), usage);
+        continue;
+      }
+
+      // Check if the option is "-tt" or "--temperature-threshold" and if there is a next argument
+      if ((IS_OPTION("-tt") || IS_OPTION("--temperature-threshold")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in temperatureThreshold
+        ASSERT_TRUE(parse_ulong(argv[++i], &temperatureThreshold), usage);
+        continue;
+      }
+
+      // Check if the option is "-ut" or "--utilization-threshold" and if there is a next argument
+      if ((IS_OPTION("-ut") || IS_OPTION("--utilization-threshold")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in utilizationThreshold
+        ASSERT_TRUE(parse_ulong(argv[++i], &utilizationThreshold), usage);
+        continue;
+      }
+
+      // Check if the option is "-utd" or "--utilization-threshold-down" and if there is a next argument
+      if ((IS_OPTION("-utd") || IS_OPTION("--utilization-threshold-down")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in utilizationThresholdDown
+        ASSERT_TRUE(parse_ulong(argv[++i], &utilizationThresholdDown), usage);
+        continue;
+      }
+
+      // Check if the option is "-utu" or "--utilization-threshold-up" and if there is a next argument
+      if ((IS_OPTION("-utu") || IS_OPTION("--utilization-threshold-up")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in utilizationThresholdUp
+        ASSERT_TRUE(parse_ulong(argv[++i], &utilizationThresholdUp), usage);
+        continue;
+      }
+
+      // The remaining argument is the recording
+      if (path == NULL && argv[i][0] != '-') {
+        path = argv[i];
+        continue;
+      }
+
+      // Reject unknown options
+      goto usage;
+    }
+
+    // The recording is required
+    if (path == NULL) {
+      goto usage;
+    }
+
+    // If the policy is not specified, use the iteration counting policy
+    if (pstatePolicy == NULL) {
+      pstatePolicy = policy_find("iterations");
+    }
+
+    // If the thresholds are not specified, use the utilization threshold
+    if (utilizationThresholdUp == ULONG_MAX) {
+      utilizationThresholdUp = utilizationThreshold;
+    }
+
+    if (utilizationThresholdDown == ULONG_MAX) {
+      utilizationThresholdDown = utilizationThreshold;
+    }
+
+    // The ladder policy needs a ladder
+    if (strcmp(pstatePolicy->name, "ladder") == 0 && ladderSteps == 0) {
+      goto usage;
+    }
+
+    // The weight of the newest sample can't exceed 100%
+    if (ewmaWeight == 0 || ewmaWeight > 100) {
+      goto usage;
+    }
+
+    // The performance states must be within range
+    if (performanceStateHigh >= SIMULATE_PSTATES || performanceStateLow >= SIMULATE_PSTATES) {
+      goto usage;
+    }
+
+    // Fill the simulation configuration
+    simulation.control.pstatePolicy = pstatePolicy;
+    simulation.control.policyConfiguration.iterationsBeforeSwitch = iterationsBeforeSwitch;
+    simulation.control.policyConfiguration.utilizationThreshold = utilizationThreshold;
+    simulation.control.policyConfiguration.utilizationThresholdUp = utilizationThresholdUp;
+    simulation.control.policyConfiguration.utilizationThresholdDown = utilizationThresholdDown;
+    simulation.control.policyConfiguration.ewmaWeight = ewmaWeight;
+    simulation.control.policyConfiguration.holdTime = holdTime;
+    simulation.control.policyConfiguration.performanceStateHigh = performanceStateHigh;
+    simulation.control.policyConfiguration.performanceStateLow = performanceStateLow;
+    simulation.control.temperatureThreshold = temperatureThreshold;
+    simulation.sleepInterval = sleepInterval;
+
+    // The ladder policy takes its performance states from the ladder
+    if (strcmp(pstatePolicy->name, "ladder") == 0) {
+      policy_set_ladder(&simulation.control.policyConfiguration, ladder, ladderSteps);
+    }
+
+    // Display usage instructions to the user
+    if (false) {
+      // Display usage instructions to the user
+      usage:
+
+      // Print the usage instructions
+      printf("Usage: %s [options] <recording>\n", argv[0]);
+      printf("\n");
+      printf("Replays a recording made with nvidia-pstated --record through the performance state policy.\n");
+      printf("\n");
+      printf("Options:\n");
+      printf("  -ew, --ewma-weight <value>                Set the weight of the newest sample in percentage for the ewma policy (default: %u)\n", EWMA_WEIGHT);
+      printf("  -ht, --hold-time <value>                  Set the time in milliseconds to stay in high performance state after the GPU was last busy for the ewma policy (default: %u)\n", HOLD_TIME);
+      printf("  -ibs, --iterations-before-switch <value>  Set the number of iterations to wait before switching states (default: %u)\n", ITERATIONS_BEFORE_SWITCH);
+      printf("  -ld, --ladder <value><,value...>          Set the steps of the ladder policy as <pstate> then <pstate>:<utilization>[:<hold time>] (default: none)\n");
+      printf("  -p, --policy <value>                      Set the performance state policy: iterations, ewma or ladder (default: iterations)\n");
+      printf("  -psh, --performance-state-high <value>    Set the high performance state for the GPU (default: %u)\n", PERFORMANCE_STATE_HIGH);
+      printf("  -psl, --performance-state-low <value>     Set the low performance state for the GPU (default: %u)\n", PERFORMANCE_STATE_LOW);
+      printf("  -si, --sleep-interval <value>             Simulate polls this many milliseconds apart, longer than the recorded interval (default: every recorded sample)\n");
+      printf("  -tt, --temperature-threshold <value>      Set the temperature threshold in degrees C (default: %u)\n", TEMPERATURE_THRESHOLD);
+      printf("  -ut, --utilization-threshold <value>      Set the utilization threshold in percentage (default: %u)\n", UTILIZATION_THRESHOLD);
+      printf("  -utd, --utilization-threshold-down <value> Set the average utilization in percentage at or below which the ewma policy starts the hold time (default: --utilization-threshold)\n");
+      printf("  -utu, --utilization-threshold-up <value>  Set the average utilization in percentage above which the ewma policy switches to high performance state (default: --utilization-threshold)\n");
+
+      // Return an error
+      return 1;
+    }
+  }
+
+  /***** REPLAY *****/
+  {
+    // Open the recording
+    FILE * stream = record_open_read(path);
+
+    // Check if the recording was opened
+    if (stream == NULL) {
+      return 1;
+    }
+
+    // No performance state was recorded yet
+    for (unsigned int i = 0; i < REPLAY_GPUS_MAX; i++) {
+      gpus[i].recordedPstateId = SIMULATE_PSTATES;
+    }
+
+    // Measure the replay itself
+    unsigned long long start = get_time_ns();
+
+    // Number of replayed records
+    unsigned long long records = 0;
+
+    // Record being replayed
+    recordEntry entry;
+
+    // Replay the records in order
+    while (record_read(stream, &entry)) {
+      // Skip records of GPUs out of range
+      if (entry.gpu >= REPLAY_GPUS_MAX) {
+        continue;
+      }
+
+      // Replay the record
+      switch (entry.type) {
+        case RECORD_TYPE_SAMPLE:
+          replay_sample(&gpus[entry.gpu], &entry);
+          break;
+
+        case RECORD_TYPE_PSTATE:
+          replay_pstate(&gpus[entry.gpu], &entry);
+          break;
+      }
+
+      // Count the record
+      records++;
+    }
+
+    // Close the recording
+    fclose(stream);
+
+    // Print the results
+    printf("Replayed %llu records with policy %s in %.3f s\n", records, pstatePolicy->name, (get_time_ns() - start) / 1e9);
+    print_report();
+  }
+
+  // Return 0 to indicate success
+  return 0;
+}
@@ -0,0 +1,273 @@
+#include "scheduler.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#elif __linux__
+  #include <poll.h>
+  #include <sys/timerfd.h>
+  #include <unistd.h>
+#endif
+
+#include "utils.h"
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Bounds of the interval between polls (in milliseconds)
+static unsigned long minInterval;
+static unsigned long maxInterval;
+
+// Current interval between polls (in milliseconds)
+static unsigned long interval;
+
+// Absolute deadline of the next poll (CLOCK_MONOTONIC, in nanoseconds)
+static unsigned long long deadline;
+
+// Flag indicating whether the deadline is scheduled but not reached yet
+static bool pending = false;
+
+// Scheduler statistics
+static schedulerStats stats;
+
+#ifdef __linux__
+  // Timer file descriptor
+  static int timerFd = -1;
+
+  // File descriptors that interrupt the wait when readable
+  static int watchFds[SCHEDULER_WATCH_MAX];
+
+  // Number of watched file descriptors
+  static unsigned int watchCount = 0;
+#endif
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+bool scheduler_init(unsigned long min, unsigned long max) {
+  // Validate the bounds
+  if (min == 0 || max < min) {
+    fprintf(stderr, "Invalid sleep interval bounds: %lu..%lu\n", min, max);
+    return false;
+  }
+
+  // Store the bounds
+  minInterval = min;
+  maxInterval = max;
+
+  // Start at the fastest rate
+  interval = min;
+
+  // The first deadline is relative to now
+  deadline = get_time_ns();
+  pending = false;
+
+  // Reset the statistics
+  memset(&stats, 0, sizeof(stats));
+
+  #ifdef __linux__
+    // Create the timer
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+    // Check if the timer was created
+    if (timerFd == -1) {
+      fprintf(stderr, "timerfd_create(): %s\n", strerror(errno));
+      return false;
+    }
+  #endif
+
+  // Return true to indicate success
+  return true;
+}
+
+void scheduler_deinit(void) {
+  #ifdef __linux__
+    // Close the timer
+    if (timerFd != -1) {
+      close(timerFd);
+      timerFd = -1;
+    }
+
+    // Forget the watched file descriptors
+    watchCount = 0;
+  #endif
+}
+
+bool scheduler_watch(int fd) {
+  #ifdef __linux__
+    // Check if there is room for the file descriptor
+    if (watchCount == SCHEDULER_WATCH_MAX) {
+      fprintf(stderr, "Too many file descriptors to watch\n");
+      return false;
+    }
+
+    // Store the file descriptor
+    watchFds[watchCount++] = fd;
+  #endif
+
+  // Return true to indicate success
+  return true;
+}
+
+void scheduler_unwatch(int fd) {
+  #ifdef __linux__
+    // Look for the file descriptor
+    for (unsigned int i = 0; i < watchCount; i++) {
+      if (watchFds[i] == fd) {
+        // Move the last one into its place
+        watchFds[i] = watchFds[--watchCount];
+        break;
+      }
+    }
+  #endif
+}
+
+bool scheduler_set_intervals(unsigned long min, unsigned long max) {
+  // Validate the bounds
+  if (min == 0 || max < min) {
+    fprintf(stderr, "Invalid sleep interval bounds: %lu..%lu\n", min, max);
+    return false;
+  }
+
+  // Store the bounds
+  minInterval = min;
+  maxInterval = max;
+
+  // Keep the current interval within the new bounds, the deadline already scheduled is kept
+  interval = interval < min ? min : interval > max ? max : interval;
+
+  // Return true to indicate success
+  return true;
+}
+
+void scheduler_update(bool active) {
+  // If any GPU is active
+  if (active) {
+    // Poll at the fastest rate
+    interval = minInterval;
+  } else {
+    // Back off exponentially
+    interval = interval * 2 > maxInterval ? maxInterval : interval * 2;
+  }
+}
+
+bool scheduler_wait(bool * event) {
+  // Assume the deadline will be reached
+  *event = false;
+
+  // Get the current time
+  unsigned long long now = get_time_ns();
+
+  // If the previous wait reached its deadline, schedule the next one
+  if (!pending) {
+    // Advance the deadline by the interval, so the loop period does not drift
+    deadline += (unsigned long long) interval * 1000000ULL;
+
+    // If the loop fell behind by more than an interval, don't try to catch up
+    if (deadline + (unsigned long long) interval * 1000000ULL < now) {
+      deadline = now + (unsigned long long) interval * 1000000ULL;
+    }
+
+    #ifdef __linux__
+      // Arm the timer with the absolute deadline
+      struct itimerspec spec = { 0 };
+      spec.it_value.tv_sec = deadline / 1000000000ULL;
+      spec.it_value.tv_nsec = deadline % 1000000000ULL;
+
+      // Check if the timer was armed
+      if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, NULL) == -1) {
+        fprintf(stderr, "timerfd_settime(): %s\n", strerror(errno));
+        return false;
+      }
+    #endif
+
+    // Mark the deadline as pending
+    pending = true;
+  }
+
+  #ifdef _WIN32
+    // Sleep until the deadline
+    if (deadline > now) {
+      Sleep((DWORD) ((deadline - now) / 1000000ULL));
+    }
+  #elif __linux__
+    // Wait for the timer and the watched file descriptors
+    struct pollfd fds[SCHEDULER_WATCH_MAX + 1] = { { timerFd, POLLIN, 0 } };
+
+    for (unsigned int i = 0; i < watchCount; i++) {
+      fds[i + 1].fd = watchFds[i];
+      fds[i + 1].events = POLLIN;
+    }
+
+    // Check if the wait failed
+    if (poll(fds, watchCount + 1, -1) == -1) {
+      // A signal interrupts the wait like an event, so the caller can react to it
+      if (errno == EINTR) {
+        *event = true;
+        return true;
+      }
+
+      // Print the error message
+      fprintf(stderr, "poll(): %s\n", strerror(errno));
+      return false;
+    }
+
+    // If the timer has not expired, a watched file descriptor is readable
+    if (!(fds[0].revents & POLLIN)) {
+      *event = true;
+      return true;
+    }
+
+    // Variable to hold the number of expirations
+    unsigned long long expirations;
+
+    // Acknowledge the expiration
+    if (read(timerFd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+      fprintf(stderr, "read(timerfd): %s\n", strerror(errno));
+      return false;
+    }
+  #endif
+
+  // The deadline is reached
+  pending = false;
+
+  // Get the wakeup time
+  unsigned long long woken = get_time_ns();
+
+  // Compute the delay relative to the deadline
+  unsigned long long jitter = woken > deadline ? woken - deadline : 0;
+
+  // Update the statistics
+  stats.wakeups++;
+  stats.jitterTotal += jitter;
+
+  if (jitter > stats.jitterMax) {
+    stats.jitterMax = jitter;
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+schedulerStats scheduler_stats(void) {
+  // Copy the statistics
+  schedulerStats result = stats;
+
+  // Include the current interval
+  result.interval = interval;
+
+  // Return the statistics
+  return result;
+}
+
+void scheduler_print_stats(void) {
+  // Get the statistics
+  schedulerStats result = scheduler_stats();
+
+  // Compute the mean jitter
+  unsigned long long jitterMean = result.wakeups ? result.jitterTotal / result.wakeups : 0;
+
+  // Print the statistics
+  printf("Scheduler: %llu wakeups, interval %lu ms, jitter mean %llu us, max %llu us\n", result.wakeups, result.interval, jitterMean / 1000, result.jitterMax / 1000);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of file descriptors that interrupt the wait
+#define SCHEDULER_WATCH_MAX 8
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the scheduler statistics
+typedef struct {
+  // Number of wakeups
+  unsigned long long wakeups;
+
+  // Sum of the wakeup delays relative to the deadlines (in nanoseconds)
+  unsigned long long jitterTotal;
+
+  // Largest wakeup delay relative to the deadline (in nanoseconds)
+  unsigned long long jitterMax;
+
+  // Current interval between polls (in milliseconds)
+  unsigned long interval;
+} schedulerStats;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool scheduler_init(unsigned long minInterval, unsigned long maxInterval);
+void scheduler_deinit(void);
+bool scheduler_set_intervals(unsigned long minInterval, unsigned long maxInterval);
+void scheduler_update(bool active);
+bool scheduler_watch(int fd);
+void scheduler_unwatch(int fd);
+bool scheduler_wait(bool * event);
+schedulerStats scheduler_stats(void);
+void scheduler_print_stats(void);
@@ -0,0 +1,171 @@
+#include "simulate.h"
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold a recorded sample, the source of a simulated control step
+typedef struct {
+  // Time of the sample (in nanoseconds)
+  unsigned long long time;
+
+  // Temperature (in degrees C) and utilization (in percentage) of the GPU
+  unsigned int temperature;
+  unsigned int utilization;
+
+  // Flag indicating whether the sample has a utilization
+  bool hasUtilization;
+} simulateSample;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static unsigned long long sample_time(void * context) {
+  // The clock is the time of the sample
+  return ((const simulateSample *) context)->time;
+}
+
+static bool sample_temperature(void * context, unsigned int * value) {
+  // Return the recorded temperature
+  *value = ((const simulateSample *) context)->temperature;
+
+  // Return true to indicate success
+  return true;
+}
+
+static bool sample_utilization(void * context, unsigned int * value, bool * available) {
+  // Get the sample
+  const simulateSample * sample = context;
+
+  // Return the recorded utilization, if any
+  *value = sample->utilization;
+  *available = sample->hasUtilization;
+
+  // Return true to indicate success
+  return true;
+}
+
+static void enter_pstate(simulateGpu * gpu, unsigned int pstateId, unsigned long long time) {
+  // Count the transition
+  if (policy_rank(pstateId) < policy_rank(gpu->pstateId)) {
+    gpu->transitionsUp++;
+  } else {
+    gpu->transitionsDown++;
+  }
+
+  // Store the new performance state
+  gpu->pstateId = pstateId;
+
+  // Restart the policy from the new performance state, as the daemon does
+  policy_reset(&gpu->policy, time);
+}
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+void simulate_sample(const simulateConfig * config, simulateGpu * gpu, unsigned long long time, unsigned int temperature, unsigned int utilization, bool hasUtilization) {
+  // Get the performance states
+  unsigned int performanceStateLow = config->control.policyConfiguration.performanceStateLow;
+
+  // If this is the first sample of the GPU
+  if (!gpu->seen) {
+    // The daemon starts in low performance state
+    gpu->seen = true;
+    gpu->pstateId = performanceStateLow;
+    gpu->lastTime = time;
+    gpu->polled = false;
+
+    // Start the policy
+    policy_reset(&gpu->policy, time);
+  }
+
+  // Time since the previous sample
+  unsigned long long elapsed = time > gpu->lastTime ? time - gpu->lastTime : 0;
+
+  // If the daemon was not running in between
+  if (elapsed > (unsigned long long) SIMULATE_GAP * 1000000ULL) {
+    // Don't account for the gap and start over, as the restarted daemon did
+    elapsed = 0;
+    gpu->pstateId = performanceStateLow;
+    gpu->polled = false;
+    gpu->busy = false;
+    policy_reset(&gpu->policy, time);
+  }
+
+  // Account for the time spent in the performance state since the previous sample
+  gpu->residency[gpu->pstateId] += elapsed;
+  gpu->samples++;
+  gpu->lastTime = time;
+
+  // If the sample shows whether there is work on the GPU
+  if (hasUtilization) {
+    // Flag indicating whether the GPU is busy
+    bool busy = utilization > 0;
+
+    // If the GPU is busy
+    if (busy) {
+      // Work that showed up since the previous sample ran in the current performance state
+      if (gpu->pstateId == performanceStateLow) {
+        gpu->busyLow += elapsed;
+      }
+
+      // Work starting on an idle GPU is a burst
+      if (!gpu->busy) {
+        gpu->bursts++;
+
+        if (gpu->pstateId == performanceStateLow) {
+          gpu->burstsLow++;
+        }
+      }
+    }
+
+    // Remember the state for the next sample
+    gpu->busy = busy;
+  }
+
+  // A longer sleep interval than the recorded one skips samples; a quarter of the interval absorbs jitter
+  if (config->sleepInterval != 0 && gpu->polled) {
+    // Interval between polls (in nanoseconds)
+    unsigned long long interval = (unsigned long long) config->sleepInterval * 1000000ULL;
+
+    // Skip the sample if the simulated daemon is still sleeping
+    if (time + interval / 4 < gpu->lastPoll + interval) {
+      return;
+    }
+  }
+
+  // Count the poll
+  gpu->polls++;
+  gpu->lastPoll = time;
+  gpu->polled = true;
+
+  // Take the time and the telemetry from the sample
+  simulateSample recorded = { time, temperature, utilization, hasUtilization };
+  controlSource source = { &recorded, sample_time, sample_temperature, sample_utilization };
+
+  // Run the control step of the daemon, which can't fail on a recorded sample
+  controlStep step;
+  control_step(&config->control, &gpu->policy, &source, &gpu->pstateId, &step);
+
+  // Samples without utilization were taken while a lease held the GPU, which is not simulated
+  if (step.outcome == CONTROL_SKIPPED || step.pstateId == gpu->pstateId) {
+    return;
+  }
+
+  // Switch to the desired performance state
+  enter_pstate(gpu, step.pstateId, time);
+
+  // Count the thermal override
+  if (step.outcome == CONTROL_OVERHEATED) {
+    gpu->thermalOverrides++;
+  }
+}
+
+unsigned long long simulate_total_time(const simulateGpu * gpu) {
+  // Total simulated time
+  unsigned long long total = 0;
+
+  // Sum the time spent in each performance state
+  for (unsigned int p = 0; p < SIMULATE_PSTATES; p++) {
+    total += gpu->residency[p];
+  }
+
+  // Return the total
+  return total;
+}
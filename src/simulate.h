@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "control.h"
+#include "policy.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Number of performance states, P0 to P15 and 16 for automatic management
+#define SIMULATE_PSTATES 17
+
+// Time between two samples of a GPU above which the daemon is assumed to have been stopped (in milliseconds)
+#define SIMULATE_GAP 60000
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the configuration of a simulation
+typedef struct {
+  // Settings of the control step, the same as in the daemon
+  controlConfig control;
+
+  // Interval between simulated polls (in milliseconds), zero to poll on every sample
+  unsigned long sleepInterval;
+} simulateConfig;
+
+// Structure to hold the simulated state and the results of a GPU
+typedef struct {
+  // Flag indicating whether the GPU has any samples
+  bool seen;
+
+  // Simulated performance state
+  unsigned int pstateId;
+
+  // State of the simulated policy
+  policyState policy;
+
+  // Time of the previous sample and of the previous simulated poll (in nanoseconds)
+  unsigned long long lastTime;
+  unsigned long long lastPoll;
+
+  // Flag indicating whether the simulated daemon polled since it started
+  bool polled;
+
+  // Flag indicating whether the previous sample showed work on the GPU
+  bool busy;
+
+  // Number of samples and of simulated polls
+  unsigned long long samples;
+  unsigned long long polls;
+
+  // Simulated time spent in each performance state (in nanoseconds)
+  unsigned long long residency[SIMULATE_PSTATES];
+
+  // Number of simulated transitions to a higher and to a lower performance state
+  unsigned long long transitionsUp;
+  unsigned long long transitionsDown;
+
+  // Number of simulated thermal overrides
+  unsigned long long thermalOverrides;
+
+  // Time the GPU was busy while in low performance state (in nanoseconds)
+  unsigned long long busyLow;
+
+  // Number of bursts, work starting on an idle GPU, and of those that started in low performance state
+  unsigned long long bursts;
+  unsigned long long burstsLow;
+} simulateGpu;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+void simulate_sample(const simulateConfig * config, simulateGpu * gpu, unsigned long long time, unsigned int temperature, unsigned int utilization, bool hasUtilization);
+unsigned long long simulate_total_time(const simulateGpu * gpu);
@@ -0,0 +1,554 @@
+#include "telemetry.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "latency.h"
+#include "nvml.h"
+#include "utils.h"
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure describing how a metric is read
+typedef struct {
+  // Name of the metric
+  const char * name;
+
+  // Field id for nvmlDeviceGetFieldValues, TELEMETRY_NO_FIELD if there is none
+  unsigned int fieldId;
+
+  // Field id added to the first one, TELEMETRY_NO_FIELD if there is none
+  unsigned int secondFieldId;
+
+  // Flag indicating whether the fields count bytes, the metric is then their rate (in megabytes per second)
+  bool counter;
+
+  // Flag indicating whether the GPU can't be managed without the metric
+  bool required;
+
+  // Flag indicating whether the metric can be read with a dedicated call
+  bool dedicated;
+} telemetrySource;
+
+// Structure to hold how the metrics of a GPU are read
+typedef struct {
+  // Device handle
+  nvmlDevice_t device;
+
+  // Fields requested with a single nvmlDeviceGetFieldValues call
+  nvmlFieldValue_t fields[TELEMETRY_FIELDS_MAX];
+
+  // Metric of each requested field
+  telemetryMetric fieldMetrics[TELEMETRY_FIELDS_MAX];
+
+  // Number of requested fields
+  unsigned int fieldCount;
+
+  // Mask of the metrics read with dedicated calls
+  unsigned int dedicated;
+
+  // Byte counts of the counter metrics at their previous read
+  unsigned long long counters[TELEMETRY_METRICS];
+
+  // Time of the previous read of each counter metric (in nanoseconds), 0 if there is none
+  unsigned long long counterTimes[TELEMETRY_METRICS];
+
+  // Time of the last temperature read (in nanoseconds)
+  unsigned long long temperatureTime;
+
+  // Steepest temperature rise observed (in degrees C per second)
+  double temperatureSlope;
+
+  // Flag indicating whether temperature reads are skipped while the GPU can't reach the threshold
+  bool lazyTemperature;
+
+  // Temperature threshold and safety margin of the lazy sampling (in degrees C)
+  unsigned long temperatureThreshold;
+  unsigned long temperatureMargin;
+
+  // Longest time between two temperature reads (in nanoseconds)
+  unsigned long long temperatureInterval;
+} telemetryGpu;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// How each metric is read; NVML has no field ids for the GPU temperature and utilization, so the default path always takes dedicated calls
+static const telemetrySource sources[TELEMETRY_METRICS] = {
+  [TELEMETRY_TEMPERATURE] = { "temperature", TELEMETRY_NO_FIELD, TELEMETRY_NO_FIELD, false, true, true },
+  #ifdef NVML_FI_DEV_MEMORY_TEMP
+    [TELEMETRY_MEMORY_TEMPERATURE] = { "memory temperature", NVML_FI_DEV_MEMORY_TEMP, TELEMETRY_NO_FIELD, false, false, false },
+  #else
+    [TELEMETRY_MEMORY_TEMPERATURE] = { "memory temperature", TELEMETRY_NO_FIELD, TELEMETRY_NO_FIELD, false, false, false },
+  #endif
+  #ifdef NVML_FI_DEV_POWER_INSTANT
+    [TELEMETRY_POWER] = { "power", NVML_FI_DEV_POWER_INSTANT, TELEMETRY_NO_FIELD, false, false, true },
+  #else
+    [TELEMETRY_POWER] = { "power", TELEMETRY_NO_FIELD, TELEMETRY_NO_FIELD, false, false, true },
+  #endif
+  // The byte counters spare the two dedicated calls, which block for 20 ms each
+  #if defined(NVML_FI_DEV_PCIE_COUNT_TX_BYTES) && defined(NVML_FI_DEV_PCIE_COUNT_RX_BYTES)
+    [TELEMETRY_PCIE_THROUGHPUT] = { "PCIe throughput", NVML_FI_DEV_PCIE_COUNT_TX_BYTES, NVML_FI_DEV_PCIE_COUNT_RX_BYTES, true, false, true },
+  #else
+    [TELEMETRY_PCIE_THROUGHPUT] = { "PCIe throughput", TELEMETRY_NO_FIELD, TELEMETRY_NO_FIELD, false, false, true },
+  #endif
+  [TELEMETRY_ENCODER_UTILIZATION] = { "encoder utilization", TELEMETRY_NO_FIELD, TELEMETRY_NO_FIELD, false, false, true },
+  [TELEMETRY_DECODER_UTILIZATION] = { "decoder utilization", TELEMETRY_NO_FIELD, TELEMETRY_NO_FIELD, false, false, true },
+  [TELEMETRY_PROCESSES] = { "compute processes", TELEMETRY_NO_FIELD, TELEMETRY_NO_FIELD, false, false, true },
+};
+
+// How the metrics of each GPU are read
+static telemetryGpu gpus[TELEMETRY_GPUS_MAX];
+
+// Latest values of each metric, one array per metric, so a metric of all GPUs is contiguous
+static unsigned int values[TELEMETRY_METRICS][TELEMETRY_GPUS_MAX];
+
+// Flags indicating whether the latest read of each metric succeeded
+static bool valid[TELEMETRY_METRICS][TELEMETRY_GPUS_MAX];
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static nvmlReturn_t read_pcie_throughput(nvmlDevice_t device, unsigned int * value) {
+  // Variables to hold the throughput in each direction (in kilobytes per second)
+  unsigned int tx;
+  unsigned int rx;
+
+  // Variable to hold the result
+  nvmlReturn_t result;
+
+  // The driver measures each direction over its own 20 ms window
+  LATENCY_CALL(result, nvmlDeviceGetPcieThroughput(device, NVML_PCIE_UTIL_TX_BYTES, &tx));
+
+  if (result == NVML_SUCCESS) {
+    LATENCY_CALL(result, nvmlDeviceGetPcieThroughput(device, NVML_PCIE_UTIL_RX_BYTES, &rx));
+  }
+
+  // Add both directions up, a copy in either direction keeps the GPU busy
+  if (result == NVML_SUCCESS) {
+    *value = (unsigned int) (((unsigned long long) tx + rx) / 1000);
+  }
+
+  // Return the result
+  return result;
+}
+
+static nvmlReturn_t read_dedicated(nvmlDevice_t device, telemetryMetric metric, unsigned int * value) {
+  // Variable to hold the result
+  nvmlReturn_t result = NVML_ERROR_NOT_SUPPORTED;
+
+  // Sampling period of the codec utilization, not used
+  unsigned int period;
+
+  // Read the metric with its own call
+  switch (metric) {
+    case TELEMETRY_TEMPERATURE:
+      LATENCY_CALL(result, nvmlDeviceGetTemperature(device, NVML_TEMPERATURE_GPU, value));
+      break;
+
+    case TELEMETRY_POWER:
+      LATENCY_CALL(result, nvmlDeviceGetPowerUsage(device, value));
+      break;
+
+    case TELEMETRY_PCIE_THROUGHPUT:
+      result = read_pcie_throughput(device, value);
+      break;
+
+    case TELEMETRY_ENCODER_UTILIZATION:
+      LATENCY_CALL(result, nvmlDeviceGetEncoderUtilization(device, value, &period));
+      break;
+
+    case TELEMETRY_DECODER_UTILIZATION:
+      LATENCY_CALL(result, nvmlDeviceGetDecoderUtilization(device, value, &period));
+      break;
+
+    case TELEMETRY_PROCESSES:
+      // Only count the processes, a full buffer still reports how many there are
+      *value = 0;
+      LATENCY_CALL(result, nvmlDeviceGetComputeRunningProcesses(device, value, NULL));
+      result = result == NVML_ERROR_INSUFFICIENT_SIZE ? NVML_SUCCESS : result;
+      break;
+
+    default:
+      break;
+  }
+
+  // Return the result
+  return result;
+}
+
+static bool temperature_due(telemetryGpu * state, unsigned int gpu, unsigned long long now) {
+  // Without lazy sampling or a previous value, the temperature is read on every tick
+  if (!state->lazyTemperature || !valid[TELEMETRY_TEMPERATURE][gpu]) {
+    return true;
+  }
+
+  // Time since the last read
+  unsigned long long elapsed = now - state->temperatureTime;
+
+  // Reread at least once per interval, so a missed slope can't hide a hot GPU for long
+  if (elapsed >= state->temperatureInterval) {
+    return true;
+  }
+
+  // Highest temperature the GPU could have reached since the last read
+  double bound = values[TELEMETRY_TEMPERATURE][gpu] + state->temperatureSlope * (elapsed / 1e9) + state->temperatureMargin;
+
+  // Read the temperature once the GPU could be within the margin of the threshold
+  return bound >= state->temperatureThreshold;
+}
+
+static void track_slope(telemetryGpu * state, unsigned int previous, unsigned int temperature, unsigned long long now) {
+  // Time since the previous read (in seconds)
+  double elapsed = (now - state->temperatureTime) / 1e9;
+
+  // Discount one degree of sensor rounding, so a single step over a short tick doesn't look like a steep rise
+  if (elapsed > 0 && temperature > previous + 1) {
+    double slope = (temperature - previous - 1) / elapsed;
+
+    // Keep the steepest rise
+    if (slope > state->temperatureSlope) {
+      state->temperatureSlope = slope;
+    }
+  }
+
+  // Remember the time of the read
+  state->temperatureTime = now;
+}
+
+static unsigned long long field_value(const nvmlFieldValue_t * field) {
+  // Convert the value, negative values are clamped to zero; byte counters need all 64 bits
+  switch (field->valueType) {
+    case NVML_VALUE_TYPE_DOUBLE:
+      return field->value.dVal > 0 ? (unsigned long long) field->value.dVal : 0;
+
+    case NVML_VALUE_TYPE_UNSIGNED_LONG:
+      return field->value.ulVal;
+
+    case NVML_VALUE_TYPE_UNSIGNED_LONG_LONG:
+      return field->value.ullVal;
+
+    case NVML_VALUE_TYPE_SIGNED_LONG_LONG:
+      return field->value.sllVal > 0 ? (unsigned long long) field->value.sllVal : 0;
+
+    case NVML_VALUE_TYPE_SIGNED_INT:
+      return field->value.siVal > 0 ? (unsigned long long) field->value.siVal : 0;
+
+    default:
+      return field->value.uiVal;
+  }
+}
+
+static void plan_gpu(unsigned int i, unsigned int metrics) {
+  // Get the GPU
+  telemetryGpu * gpu = &gpus[i];
+
+  // Forget the previous plan, the GPU may be planned again when it is managed anew
+  gpu->fieldCount = 0;
+  gpu->dedicated = 0;
+
+  // Fields supported by the driver for the GPU
+  nvmlFieldValue_t probe[TELEMETRY_FIELDS_MAX];
+  telemetryMetric probeMetrics[TELEMETRY_FIELDS_MAX];
+  unsigned int probeCount = 0;
+
+  // Collect the fields of the wanted metrics that have a field id
+  for (unsigned int m = 0; m < TELEMETRY_METRICS; m++) {
+    if (!(metrics & TELEMETRY_MASK(m)) || sources[m].fieldId == TELEMETRY_NO_FIELD) {
+      continue;
+    }
+
+    // Request the field, and the second one if the metric adds two up
+    unsigned int fieldIds[2] = { sources[m].fieldId, sources[m].secondFieldId };
+
+    for (unsigned int k = 0; k < 2 && fieldIds[k] != TELEMETRY_NO_FIELD; k++) {
+      memset(&probe[probeCount], 0, sizeof(probe[probeCount]));
+      probe[probeCount].fieldId = fieldIds[k];
+      probeMetrics[probeCount] = m;
+      probeCount++;
+    }
+  }
+
+  // Mask and number of the metrics the driver returns in the batch
+  unsigned int batched = 0;
+  unsigned int batchedCount = 0;
+
+  // If any metric could be batched
+  if (probeCount != 0) {
+    // Variable to hold the result
+    nvmlReturn_t result;
+
+    // Ask the driver for all of them once; older drivers fail the call or the unknown fields
+    LATENCY_CALL(result, nvmlDeviceGetFieldValues(gpu->device, (int) probeCount, probe));
+
+    // Mask of the metrics with a field the driver didn't return
+    unsigned int missing = 0;
+
+    for (unsigned int j = 0; j < probeCount; j++) {
+      if (result != NVML_SUCCESS || probe[j].nvmlReturn != NVML_SUCCESS) {
+        missing |= TELEMETRY_MASK(probeMetrics[j]);
+      }
+    }
+
+    // Keep the fields of the metrics the driver returned whole
+    for (unsigned int j = 0; j < probeCount; j++) {
+      if (!(missing & TELEMETRY_MASK(probeMetrics[j]))) {
+        memset(&gpu->fields[gpu->fieldCount], 0, sizeof(gpu->fields[gpu->fieldCount]));
+        gpu->fields[gpu->fieldCount].fieldId = probe[j].fieldId;
+        gpu->fieldMetrics[gpu->fieldCount] = probeMetrics[j];
+        gpu->fieldCount++;
+
+        batchedCount += (batched & TELEMETRY_MASK(probeMetrics[j])) ? 0 : 1;
+        batched |= TELEMETRY_MASK(probeMetrics[j]);
+      }
+    }
+  }
+
+  // Number of metrics read with dedicated calls
+  unsigned int dedicatedCount = 0;
+
+  // Fall back to dedicated calls for the remaining metrics
+  for (unsigned int m = 0; m < TELEMETRY_METRICS; m++) {
+    // Skip the metrics that are not wanted or already batched
+    if (!(metrics & TELEMETRY_MASK(m)) || (batched & TELEMETRY_MASK(m))) {
+      continue;
+    }
+
+    // Required metrics are always read with dedicated calls, failures show up on the first tick
+    if (sources[m].required) {
+      gpu->dedicated |= TELEMETRY_MASK(m);
+      dedicatedCount++;
+      continue;
+    }
+
+    // Check once whether the driver can read the optional metric with a dedicated call
+    unsigned int value;
+
+    if (sources[m].dedicated && read_dedicated(gpu->device, m, &value) == NVML_SUCCESS) {
+      gpu->dedicated |= TELEMETRY_MASK(m);
+      dedicatedCount++;
+      continue;
+    }
+
+    // Print message indicating the metric is unavailable
+    printf("GPU %u doesn't report its %s\n", i, sources[m].name);
+  }
+
+  // Print how the metrics are read
+  printf("GPU %u telemetry: %u metrics in one batched call, %u with dedicated calls\n", i, batchedCount, dedicatedCount);
+}
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+bool telemetry_init(const nvmlDevice_t * devices, const bool * enabled, unsigned int count, unsigned int metrics) {
+  // Validate the arguments
+  if (count > TELEMETRY_GPUS_MAX) {
+    fprintf(stderr, "Too many GPUs for telemetry: %u\n", count);
+    return false;
+  }
+
+  // The thermal protection always needs the temperature
+  metrics |= TELEMETRY_MASK(TELEMETRY_TEMPERATURE);
+
+  // Decide once how each metric of each GPU is read
+  for (unsigned int i = 0; i < count; i++) {
+    // Store the device handle
+    gpus[i].device = devices[i];
+
+    // Skip GPUs that are not polled
+    if (!enabled[i]) {
+      continue;
+    }
+
+    // Attribute the driver calls to the GPU
+    latency_set_gpu(i);
+
+    // Plan the reads of the GPU
+    plan_gpu(i, metrics);
+
+    // Assume a steep rise until a steeper one is observed
+    gpus[i].temperatureSlope = TELEMETRY_TEMPERATURE_SLOPE;
+
+    // Values and counters read before the GPU was planned again are stale
+    for (unsigned int m = 0; m < TELEMETRY_METRICS; m++) {
+      valid[m][i] = false;
+      gpus[i].counterTimes[m] = 0;
+    }
+  }
+
+  // Calls made from now on are attributed by the caller
+  latency_set_gpu(LATENCY_GPU_NONE);
+
+  // Return true to indicate success
+  return true;
+}
+
+void telemetry_set_device(unsigned int gpu, nvmlDevice_t device) {
+  // Validate the arguments
+  if (gpu >= TELEMETRY_GPUS_MAX) {
+    return;
+  }
+
+  // Store the new handle, the reads planned for the GPU are kept
+  gpus[gpu].device = device;
+
+  // Values and counters read through the previous handle are stale
+  for (unsigned int m = 0; m < TELEMETRY_METRICS; m++) {
+    valid[m][gpu] = false;
+    gpus[gpu].counterTimes[m] = 0;
+  }
+}
+
+void telemetry_set_lazy_temperature(unsigned int gpu, bool enabled, unsigned long threshold, unsigned long margin, unsigned long interval) {
+  // Validate the arguments
+  if (gpu >= TELEMETRY_GPUS_MAX) {
+    return;
+  }
+
+  // Get the GPU
+  telemetryGpu * state = &gpus[gpu];
+
+  // Store the configuration, each GPU may have its own threshold
+  state->lazyTemperature = enabled;
+  state->temperatureThreshold = threshold;
+  state->temperatureMargin = margin;
+  state->temperatureInterval = (unsigned long long) interval * 1000000ULL;
+}
+
+bool telemetry_update(unsigned int gpu) {
+  // Validate the arguments
+  if (gpu >= TELEMETRY_GPUS_MAX) {
+    return false;
+  }
+
+  // Get the GPU
+  telemetryGpu * state = &gpus[gpu];
+
+  // Get the current time
+  unsigned long long now = get_time_ns();
+
+  // If some metrics are batched
+  if (state->fieldCount != 0) {
+    // Variable to hold the result
+    nvmlReturn_t result;
+
+    // Read all batched metrics with one call
+    LATENCY_CALL(result, nvmlDeviceGetFieldValues(state->device, (int) state->fieldCount, state->fields));
+
+    // Sums of the fields of each metric, and the mask of the metrics with a failed field
+    unsigned long long sums[TELEMETRY_METRICS] = { 0 };
+    unsigned int batched = 0;
+    unsigned int failed = 0;
+
+    // Add the fields up
+    for (unsigned int j = 0; j < state->fieldCount; j++) {
+      // Get the metric of the field
+      telemetryMetric metric = state->fieldMetrics[j];
+
+      // Result of the field
+      nvmlReturn_t fieldResult = result != NVML_SUCCESS ? result : state->fields[j].nvmlReturn;
+
+      batched |= TELEMETRY_MASK(metric);
+
+      if (fieldResult == NVML_SUCCESS) {
+        sums[metric] += field_value(&state->fields[j]);
+      } else if (sources[metric].required) {
+        fprintf(stderr, "Unable to read the %s of GPU %u: %s\n", sources[metric].name, gpu, nvmlErrorString(fieldResult));
+        fault_nvml(fieldResult);
+        return false;
+      } else {
+        failed |= TELEMETRY_MASK(metric);
+      }
+    }
+
+    // Store the values
+    for (unsigned int m = 0; m < TELEMETRY_METRICS; m++) {
+      // Skip the metrics that are not batched
+      if (!(batched & TELEMETRY_MASK(m))) {
+        continue;
+      }
+
+      // A failed call or field leaves the metric without a value for this tick, and a counter without a start
+      if (failed & TELEMETRY_MASK(m)) {
+        valid[m][gpu] = false;
+        state->counterTimes[m] = 0;
+        continue;
+      }
+
+      // Plain metrics are the value of their fields
+      if (!sources[m].counter) {
+        values[m][gpu] = (unsigned int) sums[m];
+        valid[m][gpu] = true;
+        continue;
+      }
+
+      // Counters need a previous read, and a smaller count means the counter wrapped
+      valid[m][gpu] = state->counterTimes[m] != 0 && now > state->counterTimes[m] && sums[m] >= state->counters[m];
+
+      // Convert the bytes counted since the previous read to megabytes per second
+      if (valid[m][gpu]) {
+        values[m][gpu] = (unsigned int) ((sums[m] - state->counters[m]) * 1e3 / (now - state->counterTimes[m]));
+      }
+
+      // Start the next interval
+      state->counters[m] = sums[m];
+      state->counterTimes[m] = now;
+    }
+  }
+
+  // Temperature before this tick
+  unsigned int previousTemperature = values[TELEMETRY_TEMPERATURE][gpu];
+
+  // Read the remaining metrics one by one
+  for (unsigned int m = 0; m < TELEMETRY_METRICS; m++) {
+    // Skip the metrics that are not read with dedicated calls
+    if (!(state->dedicated & TELEMETRY_MASK(m))) {
+      continue;
+    }
+
+    // Keep the previous temperature while the GPU can't have reached the threshold
+    if (m == TELEMETRY_TEMPERATURE && !temperature_due(state, gpu, now)) {
+      continue;
+    }
+
+    // Flag indicating whether the metric had a value before this read
+    bool hadValue = valid[m][gpu];
+
+    // Read the metric
+    nvmlReturn_t result = read_dedicated(state->device, m, &values[m][gpu]);
+
+    // Store whether the read succeeded
+    valid[m][gpu] = result == NVML_SUCCESS;
+
+    // The GPU can't be managed without the required metrics
+    if (!valid[m][gpu] && sources[m].required) {
+      fprintf(stderr, "Unable to read the %s of GPU %u: %s\n", sources[m].name, gpu, nvmlErrorString(result));
+      fault_nvml(result);
+      return false;
+    }
+
+    // Learn how fast the temperature of the GPU rises
+    if (m == TELEMETRY_TEMPERATURE) {
+      track_slope(state, hadValue ? previousTemperature : values[m][gpu], values[m][gpu], now);
+    }
+  }
+
+  // Return true to indicate success
+  return true;
+}
+
+bool telemetry_get(unsigned int gpu, telemetryMetric metric, unsigned int * value) {
+  // Validate the arguments
+  if (gpu >= TELEMETRY_GPUS_MAX || metric >= TELEMETRY_METRICS) {
+    return false;
+  }
+
+  // Check if the latest read succeeded
+  if (!valid[metric][gpu]) {
+    return false;
+  }
+
+  // Return the latest value
+  *value = values[metric][gpu];
+
+  // Return true to indicate success
+  return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include <nvml.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs tracked (matches NVAPI_MAX_PHYSICAL_GPUS)
+#define TELEMETRY_GPUS_MAX 64
+
+// Field id of metrics NVML can't return through nvmlDeviceGetFieldValues
+#define TELEMETRY_NO_FIELD 0
+
+// Maximum number of fields requested for a GPU, each metric takes up to two
+#define TELEMETRY_FIELDS_MAX (2 * TELEMETRY_METRICS)
+
+// Slope assumed for the temperature until a steeper one is observed (in degrees C per second)
+#define TELEMETRY_TEMPERATURE_SLOPE 5
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Metrics collected for each GPU
+typedef enum {
+  // GPU temperature (in degrees C)
+  TELEMETRY_TEMPERATURE,
+
+  // Memory temperature (in degrees C)
+  TELEMETRY_MEMORY_TEMPERATURE,
+
+  // Power draw (in milliwatts)
+  TELEMETRY_POWER,
+
+  // PCIe throughput, both directions together (in megabytes per second)
+  TELEMETRY_PCIE_THROUGHPUT,
+
+  // Encoder utilization (in percent)
+  TELEMETRY_ENCODER_UTILIZATION,
+
+  // Decoder utilization (in percent)
+  TELEMETRY_DECODER_UTILIZATION,
+
+  // Number of compute processes
+  TELEMETRY_PROCESSES,
+
+  // Number of metrics
+  TELEMETRY_METRICS,
+} telemetryMetric;
+
+/***** ***** ***** ***** ***** MACROS ***** ***** ***** ***** *****/
+
+// Macro to build the mask of a metric
+#define TELEMETRY_MASK(metric) (1U << (metric))
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool telemetry_init(const nvmlDevice_t * devices, const bool * enabled, unsigned int count, unsigned int metrics);
+void telemetry_set_device(unsigned int gpu, nvmlDevice_t device);
+void telemetry_set_lazy_temperature(unsigned int gpu, bool enabled, unsigned long threshold, unsigned long margin, unsigned long interval);
+bool telemetry_update(unsigned int gpu);
+bool telemetry_get(unsigned int gpu, telemetryMetric metric, unsigned int * value);
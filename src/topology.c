@@ -0,0 +1,335 @@
+#include "topology.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#endif
+
+#include "nvapi.h"
+#include "nvml.h"
+#include "utils.h"
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure to hold the PCI location of a GPU
+typedef struct {
+  // PCI domain, zero for NvAPI which doesn't report it
+  unsigned int domain;
+
+  // PCI bus
+  unsigned int bus;
+
+  // PCI device
+  unsigned int device;
+
+  // Index of the GPU in the enumeration of its library
+  unsigned int index;
+} topologyKey;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Driver version the cache is valid for
+static char driverVersion[NVML_SYSTEM_DRIVER_VERSION_BUFFER_SIZE];
+
+// UUID of each NVML device
+static char uuids[TOPOLOGY_GPUS_MAX][NVML_DEVICE_UUID_V2_BUFFER_SIZE];
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static int compare_keys(const void * a, const void * b) {
+  // Get the keys
+  const topologyKey * x = a;
+  const topologyKey * y = b;
+
+  // Order by bus, device and domain
+  if (x->bus != y->bus) {
+    return x->bus < y->bus ? -1 : 1;
+  }
+
+  if (x->device != y->device) {
+    return x->device < y->device ? -1 : 1;
+  }
+
+  return x->domain < y->domain ? -1 : x->domain > y->domain;
+}
+
+static bool read_identity(const nvmlDevice_t * nvmlDevices, unsigned int count) {
+  // Get the driver version
+  NVML_CALL(nvmlSystemGetDriverVersion(driverVersion, sizeof(driverVersion)), failure);
+
+  // Get the UUID of each device
+  for (unsigned int i = 0; i < count; i++) {
+    NVML_CALL(nvmlDeviceGetUUID(nvmlDevices[i], uuids[i], sizeof(uuids[i])), failure);
+  }
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
+
+static bool load_cache(const char * path, unsigned int count, unsigned int * order) {
+  // Open the cache
+  FILE * stream = fopen(path, "r");
+
+  // A missing cache is not an error, it is written after probing
+  if (stream == NULL) {
+    if (errno != ENOENT) {
+      fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+    }
+
+    return false;
+  }
+
+  // Flags indicating which NvAPI indices are taken
+  bool taken[TOPOLOGY_GPUS_MAX] = { false };
+
+  // Buffer holding the current line
+  char line[NVML_SYSTEM_DRIVER_VERSION_BUFFER_SIZE + NVML_DEVICE_UUID_V2_BUFFER_SIZE + 32];
+
+  // Number of devices read
+  unsigned int read = 0;
+
+  // Flag indicating whether the cache matches the devices
+  bool valid = false;
+
+  // The first line holds the driver version
+  if (fgets(line, sizeof(line), stream) == NULL || strncmp(line, "driver ", 7) != 0) {
+    goto done;
+  }
+
+  line[strcspn(line, "\n")] = '\0';
+
+  if (strcmp(line + 7, driverVersion) != 0) {
+    goto done;
+  }
+
+  // Each following line maps an NVML index to an NvAPI index
+  while (fgets(line, sizeof(line), stream) != NULL) {
+    // Fields of the line
+    unsigned int nvmlIndex;
+    unsigned int nvapiIndex;
+    char uuid[NVML_DEVICE_UUID_V2_BUFFER_SIZE];
+
+    // Parse the line
+    if (sscanf(line, "gpu %u %u %95s", &nvmlIndex, &nvapiIndex, uuid) != 3) {
+      goto done;
+    }
+
+    // The devices are listed in NVML order, and must still be the same ones
+    if (nvmlIndex != read || read >= count || nvapiIndex >= count || taken[nvapiIndex] || strcmp(uuid, uuids[nvmlIndex]) != 0) {
+      goto done;
+    }
+
+    // Store the mapping
+    order[nvmlIndex] = nvapiIndex;
+    taken[nvapiIndex] = true;
+    read++;
+  }
+
+  // The cache must cover every device
+  valid = read == count;
+
+  done:
+  // Close the cache
+  fclose(stream);
+
+  // Print message indicating the cache is outdated
+  if (!valid) {
+    printf("Topology cache %s doesn't match the GPUs, probing them\n", path);
+  }
+
+  // Return whether the cache can be used
+  return valid;
+}
+
+static void save_cache(const char * path, unsigned int count, const unsigned int * order) {
+  // Write a temporary file first, so an interrupted write never leaves a partial cache
+  char temp[4096];
+
+  if (snprintf(temp, sizeof(temp), "%s.tmp", path) >= (int) sizeof(temp)) {
+    fprintf(stderr, "Topology cache path is too long: %s\n", path);
+    return;
+  }
+
+  // Open the temporary file
+  FILE * stream = fopen(temp, "w");
+
+  if (stream == NULL) {
+    fprintf(stderr, "Unable to write %s: %s\n", temp, strerror(errno));
+    return;
+  }
+
+  // Write the driver version and the mapping of each device
+  fprintf(stream, "driver %s\n", driverVersion);
+
+  for (unsigned int i = 0; i < count; i++) {
+    fprintf(stream, "gpu %u %u %s\n", i, order[i], uuids[i]);
+  }
+
+  // Check if the file was written
+  if (fclose(stream) != 0) {
+    fprintf(stderr, "Unable to write %s: %s\n", temp, strerror(errno));
+    remove(temp);
+    return;
+  }
+
+  // Replace the cache, rename() on Windows fails when the cache already exists
+  #ifdef _WIN32
+    if (!MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING)) {
+      fprintf(stderr, "Unable to replace %s: error %lu\n", path, GetLastError());
+      remove(temp);
+    }
+  #else
+    if (rename(temp, path) != 0) {
+      fprintf(stderr, "Unable to replace %s: %s\n", path, strerror(errno));
+      remove(temp);
+    }
+  #endif
+}
+
+static bool probe(const nvmlDevice_t * nvmlDevices, NvPhysicalGpuHandle * nvapiDevices, unsigned int count, unsigned int * order) {
+  // PCI locations reported by each library
+  topologyKey nvmlKeys[TOPOLOGY_GPUS_MAX];
+  topologyKey nvapiKeys[TOPOLOGY_GPUS_MAX];
+
+  // Flag indicating whether NvAPI reports the PCI device of every GPU
+  bool slots = true;
+
+  // Get the location of each device
+  for (unsigned int i = 0; i < count; i++) {
+    // Initialize struct to hold PCI info
+    nvmlPciInfo_t pci;
+
+    // Get PCI info
+    NVML_CALL(nvmlDeviceGetPciInfo(nvmlDevices[i], &pci), failure);
+
+    // Store the location
+    nvmlKeys[i] = (topologyKey) { pci.domain, pci.bus, pci.device, i };
+
+    // Variables to hold the bus and the slot
+    NvU32 bus;
+    NvU32 slot = 0;
+
+    // Get the bus
+    NVAPI_CALL(NvAPI_GPU_GetBusId(nvapiDevices[i], &bus), failure);
+
+    // Get the slot, which older drivers may not report
+    if (slots) {
+      // Variable to hold the result
+      NvAPI_Status result;
+
+      // Retrieve the slot
+      LATENCY_CALL(result, NvAPI_GPU_GetBusSlotId(nvapiDevices[i], &slot));
+
+      // Fall back to matching by bus alone
+      if (result != NVAPI_OK) {
+        printf("NvAPI doesn't report PCI devices, matching GPUs by bus only\n");
+        slots = false;
+      }
+    }
+
+    // Store the location
+    nvapiKeys[i] = (topologyKey) { 0, bus, slot, i };
+  }
+
+  // Without slots, the device can't take part in the match
+  for (unsigned int i = 0; i < count && !slots; i++) {
+    nvmlKeys[i].device = 0;
+    nvapiKeys[i].device = 0;
+  }
+
+  // Sort both lists by location
+  qsort(nvmlKeys, count, sizeof(topologyKey), compare_keys);
+  qsort(nvapiKeys, count, sizeof(topologyKey), compare_keys);
+
+  // NvAPI doesn't report the domain, so GPUs that only differ in it can't be told apart
+  for (unsigned int i = 1; i < count; i++) {
+    if (nvmlKeys[i].bus == nvmlKeys[i - 1].bus && nvmlKeys[i].device == nvmlKeys[i - 1].device) {
+      fprintf(stderr, "GPUs %04x:%02x:%02x and %04x:%02x:%02x only differ in the PCI domain, which NvAPI doesn't report\n", nvmlKeys[i - 1].domain, nvmlKeys[i - 1].bus, nvmlKeys[i - 1].device, nvmlKeys[i].domain, nvmlKeys[i].bus, nvmlKeys[i].device);
+      goto failure;
+    }
+  }
+
+  // Merge the sorted lists, every NVML device must have its NvAPI counterpart at the same position
+  for (unsigned int i = 0; i < count; i++) {
+    if (nvmlKeys[i].bus != nvapiKeys[i].bus || nvmlKeys[i].device != nvapiKeys[i].device) {
+      fprintf(stderr, "No NvAPI GPU found at %04x:%02x:%02x\n", nvmlKeys[i].domain, nvmlKeys[i].bus, nvmlKeys[i].device);
+      goto failure;
+    }
+
+    // Store the mapping
+    order[nvmlKeys[i].index] = nvapiKeys[i].index;
+  }
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
+
+/***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+bool topology_match(const nvmlDevice_t * nvmlDevices, NvPhysicalGpuHandle * nvapiDevices, unsigned int count, const char * cachePath) {
+  // Validate the arguments
+  if (count > TOPOLOGY_GPUS_MAX) {
+    fprintf(stderr, "Too many GPUs to match: %u\n", count);
+    return false;
+  }
+
+  // NvAPI index of each NVML device
+  unsigned int order[TOPOLOGY_GPUS_MAX];
+
+  // Flag indicating whether the mapping was taken from the cache
+  bool cached = false;
+
+  // If the cache is enabled
+  if (cachePath != NULL) {
+    // Identify the driver and the devices, to validate the cache
+    ASSERT_TRUE(read_identity(nvmlDevices, count), failure);
+
+    // Load the mapping
+    cached = load_cache(cachePath, count, order);
+
+    // Print message indicating the cache is used
+    if (cached) {
+      printf("Using GPU topology from %s\n", cachePath);
+    }
+  }
+
+  // If there is no usable cache
+  if (!cached) {
+    // Match the devices by their PCI location
+    ASSERT_TRUE(probe(nvmlDevices, nvapiDevices, count, order), failure);
+
+    // Store the mapping for the next start
+    if (cachePath != NULL) {
+      save_cache(cachePath, count, order);
+    }
+  }
+
+  // Array to store NVAPI device handles in NVML order
+  NvPhysicalGpuHandle sorted[TOPOLOGY_GPUS_MAX];
+
+  for (unsigned int i = 0; i < count; i++) {
+    sorted[i] = nvapiDevices[order[i]];
+  }
+
+  // Copy sorted handles back to original array
+  memcpy(nvapiDevices, sorted, count * sizeof(NvPhysicalGpuHandle));
+
+  // Return true to indicate success
+  return true;
+
+  failure:
+  // Return false to indicate failure
+  return false;
+}
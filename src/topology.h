@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include <nvapi.h>
+#include <nvml.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs matched (matches NVAPI_MAX_PHYSICAL_GPUS)
+#define TOPOLOGY_GPUS_MAX 64
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool topology_match(const nvmlDevice_t * nvmlDevices, NvPhysicalGpuHandle * nvapiDevices, unsigned int count, const char * cachePath);
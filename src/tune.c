@@ -0,0 +1,597 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "record.h"
+#include "simulate.h"
+#include "utils.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of GPUs in a recording (matches NVAPI_MAX_PHYSICAL_GPUS)
+#define TUNE_GPUS_MAX 64
+
+// Maximum number of values per swept option
+#define TUNE_VALUES_MAX 64
+
+// Maximum number of worker threads
+#define TUNE_THREADS_MAX 256
+
+// Utilization of samples taken without reading the utilization
+#define TUNE_NO_UTILIZATION UINT8_MAX
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Compact sample kept in memory, a week of samples of 8 GPUs at 100 ms fits in a few hundred megabytes
+typedef struct {
+  // Time since the start of the recording (in milliseconds)
+  uint32_t time;
+
+  // GPU temperature (in degrees C, saturated)
+  uint8_t temperature;
+
+  // GPU utilization (in percentage), TUNE_NO_UTILIZATION if not read
+  uint8_t utilization;
+} tuneSample;
+
+// Structure to hold the samples of a GPU
+typedef struct {
+  // Samples in recording order
+  tuneSample * samples;
+
+  // Number of samples
+  size_t count;
+
+  // Number of allocated samples
+  size_t capacity;
+} tuneTrace;
+
+// Structure describing a swept option
+typedef struct {
+  // Short and long names of the option
+  const char * shortName;
+  const char * longName;
+
+  // Values to sweep
+  unsigned long values[TUNE_VALUES_MAX];
+
+  // Number of values
+  size_t count;
+} tuneDimension;
+
+// Swept options
+typedef enum {
+  TUNE_EWMA_WEIGHT,
+  TUNE_HOLD_TIME,
+  TUNE_ITERATIONS_BEFORE_SWITCH,
+  TUNE_SLEEP_INTERVAL,
+  TUNE_UTILIZATION_THRESHOLD,
+  TUNE_UTILIZATION_THRESHOLD_DOWN,
+  TUNE_UTILIZATION_THRESHOLD_UP,
+  TUNE_DIMENSIONS,
+} tuneOption;
+
+// Structure to hold the result of a configuration
+typedef struct {
+  // Index of the configuration
+  size_t index;
+
+  // Total time and time spent in low performance state over all GPUs (in nanoseconds)
+  unsigned long long total;
+  unsigned long long residencyLow;
+
+  // Number of bursts and of bursts that started in low performance state over all GPUs
+  unsigned long long bursts;
+  unsigned long long burstsLow;
+
+  // Number of transitions over all GPUs
+  unsigned long long transitions;
+} tuneResult;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Options
+static bool printAll = false;
+static policyStep ladder[LADDER_STEPS_MAX];
+static size_t ladderSteps = 0;
+static unsigned long performanceStateHigh = PERFORMANCE_STATE_HIGH;
+static unsigned long performanceStateLow = PERFORMANCE_STATE_LOW;
+static const policy * pstatePolicy = NULL;
+static unsigned long temperatureThreshold = TEMPERATURE_THRESHOLD;
+static unsigned long threadCount = 0;
+
+// Swept options, a single value unless given as a comma separated list
+static tuneDimension dimensions[TUNE_DIMENSIONS] = {
+  [TUNE_EWMA_WEIGHT] = { "-ew", "--ewma-weight", { EWMA_WEIGHT }, 1 },
+  [TUNE_HOLD_TIME] = { "-ht", "--hold-time", { HOLD_TIME }, 1 },
+  [TUNE_ITERATIONS_BEFORE_SWITCH] = { "-ibs", "--iterations-before-switch", { ITERATIONS_BEFORE_SWITCH }, 1 },
+  [TUNE_SLEEP_INTERVAL] = { "-si", "--sleep-interval", { 0 }, 1 },
+  [TUNE_UTILIZATION_THRESHOLD] = { "-ut", "--utilization-threshold", { UTILIZATION_THRESHOLD }, 1 },
+  [TUNE_UTILIZATION_THRESHOLD_DOWN] = { "-utd", "--utilization-threshold-down", { ULONG_MAX }, 1 },
+  [TUNE_UTILIZATION_THRESHOLD_UP] = { "-utu", "--utilization-threshold-up", { ULONG_MAX }, 1 },
+};
+
+// Samples of each GPU
+static tuneTrace traces[TUNE_GPUS_MAX];
+
+// Number of configurations and results
+static size_t configCount = 1;
+static tuneResult * results = NULL;
+
+// Index of the next configuration to simulate
+static size_t nextConfig = 0;
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static bool load_recording(const char * path) {
+  // Open the recording
+  FILE * stream = record_open_read(path);
+
+  // Check if the recording was opened
+  if (stream == NULL) {
+    return false;
+  }
+
+  // Time of the first record (in nanoseconds)
+  unsigned long long start = 0;
+  bool started = false;
+
+  // Record being read
+  recordEntry entry;
+
+  // Read the samples
+  while (record_read(stream, &entry)) {
+    // Only samples of GPUs in range are simulated
+    if (entry.type != RECORD_TYPE_SAMPLE || entry.gpu >= TUNE_GPUS_MAX) {
+      continue;
+    }
+
+    // Times are kept relative to the first sample
+    if (!started) {
+      start = entry.time;
+      started = true;
+    }
+
+    // Time since the first sample (in milliseconds)
+    unsigned long long time = entry.time > start ? (entry.time - start) / 1000000ULL : 0;
+
+    // Check if the time fits
+    if (time > UINT32_MAX) {
+      fprintf(stderr, "%s: recordings longer than %u days are not supported\n", path, UINT32_MAX / 86400000U);
+      fclose(stream);
+      return false;
+    }
+
+    // Get the trace of the GPU
+    tuneTrace * trace = &traces[entry.gpu];
+
+    // Grow the trace if needed
+    if (trace->count == trace->capacity) {
+      size_t capacity = trace->capacity ? trace->capacity * 2 : 4096;
+      tuneSample * samples = realloc(trace->samples, capacity * sizeof(tuneSample));
+
+      if (samples == NULL) {
+        fprintf(stderr, "Unable to allocate memory for the samples\n");
+        fclose(stream);
+        return false;
+      }
+
+      trace->samples = samples;
+      trace->capacity = capacity;
+    }
+
+    // Store the sample
+    tuneSample * sample = &trace->samples[trace->count++];
+    sample->time = (uint32_t) time;
+    sample->temperature = entry.value1 > UINT8_MAX ? UINT8_MAX : (uint8_t) entry.value1;
+    sample->utilization = entry.value2 == RECORD_NO_UTILIZATION ? TUNE_NO_UTILIZATION : entry.value2 > 100 ? 100 : (uint8_t) entry.value2;
+  }
+
+  // Close the recording
+  fclose(stream);
+
+  // Return true to indicate success
+  return true;
+}
+
+static void decode_config(size_t index, unsigned long * values) {
+  // The index is a mixed radix number with a digit per swept option
+  for (unsigned int d = 0; d < TUNE_DIMENSIONS; d++) {
+    values[d] = dimensions[d].values[index % dimensions[d].count];
+    index /= dimensions[d].count;
+  }
+}
+
+static void simulate_config(size_t index) {
+  // Get the values of the swept options
+  unsigned long values[TUNE_DIMENSIONS];
+  decode_config(index, values);
+
+  // Fill the simulation configuration
+  simulateConfig config = { 0 };
+  config.control.pstatePolicy = pstatePolicy;
+  config.control.policyConfiguration.iterationsBeforeSwitch = values[TUNE_ITERATIONS_BEFORE_SWITCH];
+  config.control.policyConfiguration.utilizationThreshold = values[TUNE_UTILIZATION_THRESHOLD];
+  config.control.policyConfiguration.utilizationThresholdUp = values[TUNE_UTILIZATION_THRESHOLD_UP] == ULONG_MAX ? values[TUNE_UTILIZATION_THRESHOLD] : values[TUNE_UTILIZATION_THRESHOLD_UP];
+  config.control.policyConfiguration.utilizationThresholdDown = values[TUNE_UTILIZATION_THRESHOLD_DOWN] == ULONG_MAX ? values[TUNE_UTILIZATION_THRESHOLD] : values[TUNE_UTILIZATION_THRESHOLD_DOWN];
+  config.control.policyConfiguration.ewmaWeight = values[TUNE_EWMA_WEIGHT];
+  config.control.policyConfiguration.holdTime = values[TUNE_HOLD_TIME];
+  config.control.policyConfiguration.performanceStateHigh = performanceStateHigh;
+  config.control.policyConfiguration.performanceStateLow = performanceStateLow;
+  config.control.temperatureThreshold = temperatureThreshold;
+  config.sleepInterval = values[TUNE_SLEEP_INTERVAL];
+
+  // The ladder policy takes its performance states from the ladder, with the swept hold time as default
+  if (strcmp(pstatePolicy->name, "ladder") == 0) {
+    policy_set_ladder(&config.control.policyConfiguration, ladder, ladderSteps);
+  }
+
+  // Result of the configuration
+  tuneResult * result = &results[index];
+  result->index = index;
+
+  // Simulate each GPU
+  for (unsigned int i = 0; i < TUNE_GPUS_MAX; i++) {
+    // Get the trace of the GPU
+    const tuneTrace * trace = &traces[i];
+
+    // Simulated state of the GPU
+    simulateGpu gpu = { 0 };
+
+    // Replay the samples
+    for (size_t j = 0; j < trace->count; j++) {
+      const tuneSample * sample = &trace->samples[j];
+      simulate_sample(&config, &gpu, (unsigned long long) sample->time * 1000000ULL, sample->temperature, sample->utilization, sample->utilization != TUNE_NO_UTILIZATION);
+    }
+
+    // Accumulate the results
+    result->total += simulate_total_time(&gpu);
+    result->residencyLow += gpu.residency[config.control.policyConfiguration.performanceStateLow];
+    result->bursts += gpu.bursts;
+    result->burstsLow += gpu.burstsLow;
+    result->transitions += gpu.transitionsUp + gpu.transitionsDown;
+  }
+}
+
+static void * worker_main(void * argument) {
+  // Simulate configurations until none are left
+  while (true) {
+    // Take the next configuration
+    size_t index = __atomic_fetch_add(&nextConfig, 1, __ATOMIC_RELAXED);
+
+    // Stop if all configurations are taken
+    if (index >= configCount) {
+      break;
+    }
+
+    // Simulate the configuration
+    simulate_config(index);
+  }
+
+  // Return nothing
+  return NULL;
+}
+
+static int compare_results(const void * a, const void * b) {
+  // Get the results
+  const tuneResult * left = a;
+  const tuneResult * right = b;
+
+  // Compare the low performance state residency, highest first
+  double leftShare = left->total ? (double) left->residencyLow / left->total : 0.0;
+  double rightShare = right->total ? (double) right->residencyLow / right->total : 0.0;
+
+  if (leftShare != rightShare) {
+    return leftShare > rightShare ? -1 : 1;
+  }
+
+  // Compare the bursts served in low performance state, fewest first
+  if (left->burstsLow != right->burstsLow) {
+    return left->burstsLow < right->burstsLow ? -1 : 1;
+  }
+
+  // Keep the configuration order otherwise
+  return left->index < right->index ? -1 : left->index > right->index ? 1 : 0;
+}
+
+static void print_result(const tuneResult * result) {
+  // Print the metrics
+  printf("%9.2f%% %12llu %12llu %12llu  ", result->total ? 100.0 * result->residencyLow / result->total : 0.0, result->burstsLow, result->bursts, result->transitions);
+
+  // Get the values of the swept options
+  unsigned long values[TUNE_DIMENSIONS];
+  decode_config(result->index, values);
+
+  // Print the options that are swept, as daemon arguments
+  printf("--policy %s", pstatePolicy->name);
+
+  for (unsigned int d = 0; d < TUNE_DIMENSIONS; d++) {
+    if (dimensions[d].count > 1) {
+      printf(" %s %lu", dimensions[d].longName, values[d]);
+    }
+  }
+
+  printf("\n");
+}
+
+/***** ***** ***** ***** ***** MAIN ***** ***** ***** ***** *****/
+
+int main(int argc, char * argv[]) {
+  // Path of the recording
+  const char * path = NULL;
+
+  /***** OPTION PARSING *****/
+  {
+    // Iterate through command-line arguments
+    for (unsigned int i = 1; i < argc; i++) {
+      // Check if the option is "-h" or "--help"
+      if ((IS_OPTION("-h") || IS_OPTION("--help"))) {
+        // Print usage instructions
+        goto usage;
+      }
+
+      // Check if the option is "-a" or "--all"
+      if ((IS_OPTION("-a") || IS_OPTION("--all"))) {
+        // Print all configurations
+        printAll = true;
+        continue;
+      }
+
+      // Check if the option is "-j" or "--jobs" and if there is a next argument
+      if ((IS_OPTION("-j") || IS_OPTION("--jobs")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in threadCount
+        ASSERT_TRUE(parse_ulong(argv[++i], &threadCount), usage);
+        continue;
+      }
+
+      // Check if the option is "-ld" or "--ladder" and if there is a next argument
+      if ((IS_OPTION("-ld") || IS_OPTION("--ladder")) && HAS_NEXT_ARG) {
+        // Parse the steps and store them in ladder
+        ASSERT_TRUE(policy_parse_ladder(argv[++i], ladder, &ladderSteps), usage);
+        continue;
+      }
+
+      // Check if the option is "-p" or "--policy" and if there is a next argument
+      if ((IS_OPTION("-p") || IS_OPTION("--policy")) && HAS_NEXT_ARG) {
+        // Look up the policy and store it in pstatePolicy
+        pstatePolicy = policy_find(argv[++i]);
+
+        // Check if the policy exists
+        ASSERT_TRUE(pstatePolicy != NULL, usage);
+        continue;
+      }
+
+      // Check if the option is "-psh" or "--performance-state-high" and if there is a next argument
+      if ((IS_OPTION("-psh") || IS_OPTION("--performance-state-high")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in performanceStateHigh
+        ASSERT_TRUE(parse_ulong(argv[++i], &performanceStateHigh), usage);
+        continue;
+      }
+
+      // Check if the option is "-psl" or "--performance-state-low" and if there is a next argument
+      if ((IS_OPTION("-psl") || IS_OPTION("--performance-state-low")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in performanceStateLow
+        ASSERT_TRUE(parse_ulong(argv[++i], &performanceStateLow), usage);
+        continue;
+      }
+
+      // Check if the option is "-tt" or "--temperature-threshold" and if there is a next argument
+      if ((IS_OPTION("-tt") || IS_OPTION("--temperature-threshold")) && HAS_NEXT_ARG) {
+        // Parse the integer option and store it in temperatureThreshold
+        ASSERT_TRUE(parse_ulong(argv[++i], &temperatureThreshold), usage);
+        continue;
+      }
+
+      // Flag indicating whether the argument is a swept option
+      bool swept = false;
+
+      // Check if the option is one of the swept options and if there is a next argument
+      for (unsigned int d = 0; d < TUNE_DIMENSIONS && !swept; d++) {
+        if ((IS_OPTION(dimensions[d].shortName) || IS_OPTION(dimensions[d].longName)) && HAS_NEXT_ARG) {
+          // Parse the integer array option and store it in the values of the option
+          ASSERT_TRUE(parse_ulong_array(argv[++i], ",", TUNE_VALUES_MAX, dimensions[d].values, &dimensions[d].count), usage);
+          ASSERT_TRUE(dimensions[d].count != 0, usage);
+          swept = true;
+        }
+      }
+
+      if (swept) {
+        continue;
+      }
+
+      // The remaining argument is the recording
+      if (path == NULL && argv[i][0] != '-') {
+        path = argv[i];
+        continue;
+      }
+
+      // Reject unknown options
+      goto usage;
+    }
+
+    // The recording is required
+    if (path == NULL) {
+      goto usage;
+    }
+
+    // If the policy is not specified, use the iteration counting policy
+    if (pstatePolicy == NULL) {
+      pstatePolicy = policy_find("iterations");
+    }
+
+    // The ladder policy needs a ladder
+    if (strcmp(pstatePolicy->name, "ladder") == 0 && ladderSteps == 0) {
+      goto usage;
+    }
+
+    // The weight of the newest sample can't exceed 100%
+    for (size_t j = 0; j < dimensions[TUNE_EWMA_WEIGHT].count; j++) {
+      if (dimensions[TUNE_EWMA_WEIGHT].values[j] == 0 || dimensions[TUNE_EWMA_WEIGHT].values[j] > 100) {
+        goto usage;
+      }
+    }
+
+    // The performance states must be within range
+    if (performanceStateHigh >= SIMULATE_PSTATES || performanceStateLow >= SIMULATE_PSTATES) {
+      goto usage;
+    }
+
+    // If the number of threads is not specified, use all processors
+    if (threadCount == 0) {
+      long processors = sysconf(_SC_NPROCESSORS_ONLN);
+      threadCount = processors > 0 ? (unsigned long) processors : 1;
+    }
+
+    if (threadCount > TUNE_THREADS_MAX) {
+      threadCount = TUNE_THREADS_MAX;
+    }
+
+    // Display usage instructions to the user
+    if (false) {
+      // Display usage instructions to the user
+      usage:
+
+      // Print the usage instructions
+      printf("Usage: %s [options] <recording>\n", argv[0]);
+      printf("\n");
+      printf("Simulates a recording made with nvidia-pstated --record over a grid of options and prints the\n");
+      printf("configurations on the Pareto front of low performance state residency and bursts served in it.\n");
+      printf("Options marked with <values> take a comma separated list of values to sweep.\n");
+      printf("\n");
+      printf("Options:\n");
+      printf("  -a, --all                                  Print all configurations, not only the Pareto front\n");
+      printf("  -ew, --ewma-weight <values>                Weight of the newest sample in percentage for the ewma policy (default: %u)\n", EWMA_WEIGHT);
+      printf("  -ht, --hold-time <values>                  Hold time in milliseconds for the ewma policy (default: %u)\n", HOLD_TIME);
+      printf("  -ibs, --iterations-before-switch <values>  Iterations to wait before switching states (default: %u)\n", ITERATIONS_BEFORE_SWITCH);
+      printf("  -j, --jobs <value>                         Number of threads (default: number of processors)\n");
+      printf("  -ld, --ladder <value><,value...>           Steps of the ladder policy as <pstate> then <pstate>:<utilization>[:<hold time>] (default: none)\n");
+      printf("  -p, --policy <value>                       Performance state policy: iterations, ewma or ladder (default: iterations)\n");
+      printf("  -psh, --performance-state-high <value>     High performance state for the GPU (default: %u)\n", PERFORMANCE_STATE_HIGH);
+      printf("  -psl, --performance-state-low <value>      Low performance state for the GPU (default: %u)\n", PERFORMANCE_STATE_LOW);
+      printf("  -si, --sleep-interval <values>             Milliseconds between simulated polls, longer than the recorded interval (default: every recorded sample)\n");
+      printf("  -tt, --temperature-threshold <value>       Temperature threshold in degrees C (default: %u)\n", TEMPERATURE_THRESHOLD);
+      printf("  -ut, --utilization-threshold <values>      Utilization threshold in percentage (default: %u)\n", UTILIZATION_THRESHOLD);
+      printf("  -utd, --utilization-threshold-down <values> Down threshold in percentage for the ewma policy (default: --utilization-threshold)\n");
+      printf("  -utu, --utilization-threshold-up <values>  Up threshold in percentage for the ewma policy (default: --utilization-threshold)\n");
+
+      // Return an error
+      return 1;
+    }
+  }
+
+  /***** LOAD *****/
+  {
+    // Measure the loading
+    unsigned long long start = get_time_ns();
+
+    // Load the samples into memory
+    if (!load_recording(path)) {
+      return 1;
+    }
+
+    // Count the samples
+    size_t samples = 0;
+
+    for (unsigned int i = 0; i < TUNE_GPUS_MAX; i++) {
+      samples += traces[i].count;
+    }
+
+    // Print the summary
+    printf("Loaded %zu samples in %.3f s\n", samples, (get_time_ns() - start) / 1e9);
+  }
+
+  /***** SIMULATE *****/
+  {
+    // Count the configurations
+    for (unsigned int d = 0; d < TUNE_DIMENSIONS; d++) {
+      configCount *= dimensions[d].count;
+    }
+
+    // Allocate the results
+    results = calloc(configCount, sizeof(tuneResult));
+
+    // Check if the results were allocated
+    if (results == NULL) {
+      fprintf(stderr, "Unable to allocate memory for %zu configurations\n", configCount);
+      return 1;
+    }
+
+    // Don't start more threads than there are configurations
+    if (threadCount > configCount) {
+      threadCount = configCount;
+    }
+
+    // Measure the simulation
+    unsigned long long start = get_time_ns();
+
+    // Worker threads
+    pthread_t threads[TUNE_THREADS_MAX];
+
+    // Number of started threads
+    unsigned int started = 0;
+
+    // Start the workers
+    for (unsigned int i = 0; i < threadCount; i++) {
+      // Create the worker thread
+      int ret = pthread_create(&threads[i], NULL, worker_main, NULL);
+
+      // The remaining threads take over the work of a thread that failed to start
+      if (ret != 0) {
+        fprintf(stderr, "pthread_create(): %s\n", strerror(ret));
+        break;
+      }
+
+      started++;
+    }
+
+    // If no thread started, simulate on this thread
+    if (started == 0) {
+      worker_main(NULL);
+    }
+
+    // Wait for the workers
+    for (unsigned int i = 0; i < started; i++) {
+      pthread_join(threads[i], NULL);
+    }
+
+    // Print the summary
+    printf("Simulated %zu configurations with policy %s on %u threads in %.3f s\n", configCount, pstatePolicy->name, started ? started : 1, (get_time_ns() - start) / 1e9);
+  }
+
+  /***** REPORT *****/
+  {
+    // Sort by residency, then by bursts served in low performance state
+    qsort(results, configCount, sizeof(tuneResult), compare_results);
+
+    // Print the header
+    printf("\n");
+    printf("%s:\n", printAll ? "Configurations" : "Pareto front");
+    printf("%10s %12s %12s %12s  %s\n", "residency", "bursts-low", "bursts", "transitions", "options");
+
+    // Fewest bursts served in low performance state among the configurations with a higher residency
+    unsigned long long fewest = ULLONG_MAX;
+
+    // Walk the configurations from the highest residency
+    for (size_t i = 0; i < configCount; i++) {
+      // A configuration is on the front if no configuration with a higher residency serves fewer bursts in low performance state
+      bool front = results[i].burstsLow < fewest;
+
+      if (front) {
+        fewest = results[i].burstsLow;
+      }
+
+      // Print the configuration
+      if (front || printAll) {
+        print_result(&results[i]);
+      }
+    }
+  }
+
+  // Return 0 to indicate success
+  return 0;
+}
@@ -4,6 +4,11 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+  #include <windows.h>
+#endif
 
 bool parse_ulong(const char *arg, unsigned long *value) {
   // Check if the input or output argument is invalid
@@ -98,3 +103,27 @@ bool parse_ulong_array(const char *arg, const char *delimiter, const size_t max_
   // Return true if parsing were successful
   return true;
 }
+
+unsigned long long get_time_ns(void) {
+  #ifdef _WIN32
+    // Variables to hold the counter frequency and value
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    // Query the performance counter
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    // Convert the counter value to nanoseconds
+    return (unsigned long long) (counter.QuadPart / frequency.QuadPart) * 1000000000ULL + (unsigned long long) (counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+  #else
+    // Variable to hold the current time
+    struct timespec ts;
+
+    // Get the current monotonic time
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    // Convert to nanoseconds
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + (unsigned long long) ts.tv_nsec;
+  #endif
+}
@@ -30,6 +30,15 @@
   }                                    \
 } while (0);
 
+// Macros to access variables shared between threads without locking
+#ifdef _WIN32
+  #define ATOMIC_LOAD(ptr) (*(ptr))
+  #define ATOMIC_STORE(ptr, value) (*(ptr) = (value))
+#else
+  #define ATOMIC_LOAD(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+  #define ATOMIC_STORE(ptr, value) __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#endif
+
 // Macro to check if there is a next argument
 #define HAS_NEXT_ARG (i + 1 < argc)
 
@@ -47,5 +56,6 @@
 
 /***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
 
+unsigned long long get_time_ns(void);
 bool parse_ulong(const char *arg, unsigned long *value);
 bool parse_ulong_array(const char *arg, const char *delimiter, const size_t max_count, unsigned long *values, size_t *count);
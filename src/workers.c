@@ -0,0 +1,185 @@
+#include "workers.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+  #include <pthread.h>
+#endif
+
+#include "utils.h"
+
+#ifdef __linux__
+  /***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+  // Lock and condition protecting the tick generation
+  static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  static pthread_cond_t condition = PTHREAD_COND_INITIALIZER;
+
+  // Tick generation, incremented on each tick
+  static unsigned long long generation = 0;
+
+  // Flag indicating whether the workers should stop
+  static bool stopping = false;
+
+  // Flag indicating whether any worker has failed
+  static bool failed = false;
+
+  // Function invoked by the workers on each tick
+  static workerTick_t tickFunction;
+
+  // Worker threads
+  static pthread_t threads[WORKERS_MAX];
+
+  // Flags indicating which worker threads are running
+  static bool running[WORKERS_MAX];
+
+  // Number of ticks each worker missed because its previous tick was still in progress
+  static unsigned long long missedTicks[WORKERS_MAX];
+
+  /***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+  static void * worker_main(void * argument) {
+    // Get the index of the worker
+    unsigned int index = (unsigned int) (uintptr_t) argument;
+
+    // Last tick generation processed by this worker
+    unsigned long long seen = 0;
+
+    // Process ticks until stopped
+    while (true) {
+      // Wait for the next tick
+      pthread_mutex_lock(&mutex);
+
+      while (!stopping && generation == seen) {
+        pthread_cond_wait(&condition, &mutex);
+      }
+
+      // Check if the workers should stop
+      if (stopping) {
+        pthread_mutex_unlock(&mutex);
+        break;
+      }
+
+      // Ticks issued while the previous one was in progress are coalesced
+      ATOMIC_STORE(&missedTicks[index], ATOMIC_LOAD(&missedTicks[index]) + (generation - seen - 1));
+
+      // Remember the processed generation
+      seen = generation;
+
+      pthread_mutex_unlock(&mutex);
+
+      // Process the tick
+      if (!tickFunction(index)) {
+        // Mark the failure, the control loop will shut down
+        ATOMIC_STORE(&failed, true);
+
+        // Stop this worker
+        break;
+      }
+    }
+
+    // Return nothing
+    return NULL;
+  }
+
+  /***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+  bool workers_start(const bool * enabled, unsigned int count, workerTick_t tick) {
+    // Store the tick function
+    tickFunction = tick;
+
+    // Reset the shared state
+    generation = 0;
+    stopping = false;
+    failed = false;
+
+    // Start a worker for each enabled index
+    for (unsigned int i = 0; i < count && i < WORKERS_MAX; i++) {
+      // Reset the statistics
+      missedTicks[i] = 0;
+
+      // Skip disabled indices
+      if (!enabled[i]) {
+        continue;
+      }
+
+      // Create the worker thread
+      int ret = pthread_create(&threads[i], NULL, worker_main, (void *) (uintptr_t) i);
+
+      // Check if the thread was created
+      if (ret != 0) {
+        fprintf(stderr, "pthread_create(): %s\n", strerror(ret));
+        workers_stop();
+        return false;
+      }
+
+      // Mark the worker as running
+      running[i] = true;
+    }
+
+    // Return true to indicate success
+    return true;
+  }
+
+  void workers_tick(void) {
+    // Issue a new tick to all workers, busy workers pick it up when done
+    pthread_mutex_lock(&mutex);
+    generation++;
+    pthread_cond_broadcast(&condition);
+    pthread_mutex_unlock(&mutex);
+  }
+
+  void workers_stop(void) {
+    // Ask all workers to stop
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    pthread_cond_broadcast(&condition);
+    pthread_mutex_unlock(&mutex);
+
+    // Wait for the workers to finish their current tick
+    for (unsigned int i = 0; i < WORKERS_MAX; i++) {
+      if (running[i]) {
+        pthread_join(threads[i], NULL);
+        running[i] = false;
+      }
+    }
+  }
+
+  bool workers_failed(void) {
+    return ATOMIC_LOAD(&failed);
+  }
+
+  void workers_print_stats(void) {
+    // Print the number of missed ticks of each worker
+    for (unsigned int i = 0; i < WORKERS_MAX; i++) {
+      if (ATOMIC_LOAD(&missedTicks[i]) != 0) {
+        printf("GPU %u worker missed %llu ticks\n", i, ATOMIC_LOAD(&missedTicks[i]));
+      }
+    }
+  }
+#else
+  /***** ***** ***** ***** ***** IMPLEMENTATION ***** ***** ***** ***** *****/
+
+  bool workers_start(const bool * enabled, unsigned int count, workerTick_t tick) {
+    // Print an error message
+    fprintf(stderr, "Threaded mode is not supported on this platform\n");
+
+    // Return false to indicate failure
+    return false;
+  }
+
+  void workers_tick(void) {
+  }
+
+  void workers_stop(void) {
+  }
+
+  bool workers_failed(void) {
+    return false;
+  }
+
+  void workers_print_stats(void) {
+  }
+#endif
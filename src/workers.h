@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdbool.h>
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Maximum number of workers (matches NVAPI_MAX_PHYSICAL_GPUS)
+#define WORKERS_MAX 64
+
+/***** ***** ***** ***** ***** TYPES ***** ***** ***** ***** *****/
+
+// Function invoked by a worker on each tick, returns false on failure
+typedef bool (*workerTick_t)(unsigned int index);
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+bool workers_start(const bool * enabled, unsigned int count, workerTick_t tick);
+void workers_tick(void);
+void workers_stop(void);
+bool workers_failed(void);
+void workers_print_stats(void);
@@ -0,0 +1,488 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "control.h"
+#include "policy.h"
+#include "utils.h"
+
+/***** ***** ***** ***** ***** CONSTANTS ***** ***** ***** ***** *****/
+
+// Interval between two simulated ticks (in milliseconds), the default --sleep-interval of the daemon
+#define TEST_TICK 100
+
+// Maximum number of simulated GPUs
+#define TEST_GPUS_MAX 64
+
+// Number of transitions kept for each GPU, the later ones are only counted
+#define TEST_TRANSITIONS_MAX 32
+
+// Period and busy time of the workload of each GPU in the long run (in milliseconds)
+#define TEST_PERIOD 60000
+#define TEST_BUSY 10000
+
+// Simulated duration of the long run (in hours)
+#define TEST_HOURS 8
+
+/***** ***** ***** ***** ***** STRUCTURES ***** ***** ***** ***** *****/
+
+// Structure describing the workload of a scenario, as a function of the GPU and of the time (in milliseconds)
+typedef struct {
+  // Temperature of the GPU (in degrees C)
+  unsigned int (* temperature)(unsigned int gpu, unsigned long long time);
+
+  // Utilization of the GPU (in percentage)
+  unsigned int (* utilization)(unsigned int gpu, unsigned long long time);
+} testWorkload;
+
+// Structure to hold a transition of a simulated GPU
+typedef struct {
+  // Time of the transition (in milliseconds)
+  unsigned long long time;
+
+  // Performance state entered
+  unsigned int pstateId;
+
+  // Flag indicating whether the thermal protection switched the GPU
+  bool thermal;
+} testTransition;
+
+// Structure to hold a simulated GPU, also the context of its control source
+typedef struct {
+  // Workload of the GPU
+  const testWorkload * workload;
+
+  // Index of the GPU
+  unsigned int index;
+
+  // Virtual clock (in nanoseconds)
+  unsigned long long now;
+
+  // Current performance state of the GPU
+  unsigned int pstateId;
+
+  // State of the performance state policy
+  policyState policy;
+
+  // First transitions of the GPU
+  testTransition transitions[TEST_TRANSITIONS_MAX];
+
+  // Number of transitions of the GPU
+  unsigned int transitionCount;
+
+  // Flag indicating whether the workload was busy on the previous tick
+  bool busy;
+
+  // Time the current burst started (in milliseconds), and whether it still waits for high performance state
+  unsigned long long burstTime;
+  bool waiting;
+
+  // Longest time between the start of a burst and high performance state (in milliseconds)
+  unsigned long long maxReaction;
+} testGpu;
+
+/***** ***** ***** ***** ***** VARIABLES ***** ***** ***** ***** *****/
+
+// Number of failed checks
+static unsigned int failures = 0;
+
+// Simulated GPUs
+static testGpu gpus[TEST_GPUS_MAX];
+
+/***** ***** ***** ***** ***** MACROS ***** ***** ***** ***** *****/
+
+// Macro to count and report a failed check
+#define CHECK(condition, ...) do {                               \
+  /* If the check failed */                                     \
+  if (!(condition)) {                                           \
+    /* Print where and why */                                   \
+    fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);             \
+    fprintf(stderr, __VA_ARGS__);                               \
+    fprintf(stderr, "\n");                                      \
+                                                                \
+    /* Count the failure */                                     \
+    failures++;                                                 \
+  }                                                             \
+} while (0)
+
+/***** ***** ***** ***** ***** WORKLOADS ***** ***** ***** ***** *****/
+
+static unsigned int cool(unsigned int gpu, unsigned long long time) {
+  // Well below the temperature threshold
+  return 40;
+}
+
+static unsigned int hot_5_to_7_5(unsigned int gpu, unsigned long long time) {
+  // Above the temperature threshold for 2.5 seconds
+  return time >= 5000 && time < 7500 ? 90 : 40;
+}
+
+static unsigned int busy(unsigned int gpu, unsigned long long time) {
+  // Fully utilized all the time
+  return 100;
+}
+
+static unsigned int busy_10_to_20(unsigned int gpu, unsigned long long time) {
+  // Idle, then busy for 10 seconds, then idle again
+  return time >= 10000 && time < 20000 ? 100 : 0;
+}
+
+static unsigned int busy_until_5(unsigned int gpu, unsigned long long time) {
+  // Busy for 5 seconds, then idle
+  return time < 5000 ? 100 : 0;
+}
+
+static unsigned int light(unsigned int gpu, unsigned long long time) {
+  // Steady load just above the default threshold of 0
+  return 1;
+}
+
+static unsigned int flapping_2s(unsigned int gpu, unsigned long long time) {
+  // A single busy tick every 2 seconds, more often than the GPU switches down
+  return time % 2000 == 0 ? 100 : 0;
+}
+
+static unsigned int flapping_4s(unsigned int gpu, unsigned long long time) {
+  // A single busy tick every 4 seconds, less often than the GPU switches down
+  return time % 4000 == 0 ? 100 : 0;
+}
+
+static unsigned int periodic(unsigned int gpu, unsigned long long time) {
+  // Each GPU starts its bursts one tick after the previous GPU
+  unsigned long long phase = (time + TEST_PERIOD - (unsigned long long) gpu * TEST_TICK % TEST_PERIOD) % TEST_PERIOD;
+
+  // Busy at the start of each period
+  return phase < TEST_BUSY ? 100 : 0;
+}
+
+/***** ***** ***** ***** ***** SOURCE ***** ***** ***** ***** *****/
+
+static unsigned long long virtual_clock(void * context) {
+  // The clock only moves when the test advances it
+  return ((const testGpu *) context)->now;
+}
+
+static bool read_temperature(void * context, unsigned int * value) {
+  // Get the GPU
+  const testGpu * gpu = context;
+
+  // Evaluate the workload at the current time
+  *value = gpu->workload->temperature(gpu->index, gpu->now / 1000000ULL);
+
+  // Return true to indicate success
+  return true;
+}
+
+static bool read_utilization(void * context, unsigned int * value, bool * available) {
+  // Get the GPU
+  const testGpu * gpu = context;
+
+  // Evaluate the workload at the current time
+  *value = gpu->workload->utilization(gpu->index, gpu->now / 1000000ULL);
+
+  // Return true to indicate success
+  return true;
+}
+
+/***** ***** ***** ***** ***** FUNCTIONS ***** ***** ***** ***** *****/
+
+static controlConfig make_config(const char * policyName) {
+  // Variable to hold the configuration
+  controlConfig config;
+
+  // Clear the configuration
+  memset(&config, 0, sizeof(config));
+
+  // Use the defaults of the daemon
+  config.pstatePolicy = policy_find(policyName);
+  config.policyConfiguration.iterationsBeforeSwitch = ITERATIONS_BEFORE_SWITCH;
+  config.policyConfiguration.utilizationThreshold = UTILIZATION_THRESHOLD;
+  config.policyConfiguration.utilizationThresholdUp = UTILIZATION_THRESHOLD;
+  config.policyConfiguration.utilizationThresholdDown = UTILIZATION_THRESHOLD;
+  config.policyConfiguration.ewmaWeight = EWMA_WEIGHT;
+  config.policyConfiguration.holdTime = HOLD_TIME;
+  config.policyConfiguration.performanceStateHigh = PERFORMANCE_STATE_HIGH;
+  config.policyConfiguration.performanceStateLow = PERFORMANCE_STATE_LOW;
+  config.temperatureThreshold = TEMPERATURE_THRESHOLD;
+
+  // Return the configuration
+  return config;
+}
+
+static void tick(const controlConfig * config, testGpu * gpu, unsigned long long time) {
+  // Advance the virtual clock
+  gpu->now = time * 1000000ULL;
+
+  // Track the start of each burst, to measure how long it waits for high performance state
+  bool busy = gpu->workload->utilization(gpu->index, time) > config->policyConfiguration.utilizationThreshold;
+
+  if (busy && !gpu->busy) {
+    gpu->burstTime = time;
+    gpu->waiting = gpu->pstateId != config->policyConfiguration.performanceStateHigh;
+  }
+
+  gpu->busy = busy;
+
+  // Take the time from the virtual clock and the telemetry from the workload
+  controlSource source = { gpu, virtual_clock, read_temperature, read_utilization };
+
+  // Run the control step of the daemon
+  controlStep step;
+  CHECK(control_step(config, &gpu->policy, &source, &gpu->pstateId, &step), "control_step failed");
+
+  // If the GPU switches, as the daemon does
+  if (step.outcome != CONTROL_SKIPPED && step.pstateId != gpu->pstateId) {
+    // Keep the first transitions, count all of them
+    if (gpu->transitionCount < TEST_TRANSITIONS_MAX) {
+      gpu->transitions[gpu->transitionCount] = (testTransition) { time, step.pstateId, step.outcome == CONTROL_OVERHEATED };
+    }
+
+    gpu->transitionCount++;
+
+    // Switch, which restarts the policy
+    gpu->pstateId = step.pstateId;
+    policy_reset(&gpu->policy, step.time);
+  }
+
+  // Measure the reaction to the burst
+  if (gpu->waiting && gpu->pstateId == config->policyConfiguration.performanceStateHigh) {
+    gpu->waiting = false;
+
+    if (time - gpu->burstTime > gpu->maxReaction) {
+      gpu->maxReaction = time - gpu->burstTime;
+    }
+  }
+}
+
+static void run(const controlConfig * config, const testWorkload * workload, unsigned int count, unsigned long long duration) {
+  // Start each GPU in low performance state, as the daemon does
+  for (unsigned int i = 0; i < count; i++) {
+    memset(&gpus[i], 0, sizeof(gpus[i]));
+    gpus[i].workload = workload;
+    gpus[i].index = i;
+    gpus[i].pstateId = config->policyConfiguration.performanceStateLow;
+    policy_reset(&gpus[i].policy, 0);
+  }
+
+  // Tick every GPU on each interval
+  for (unsigned long long time = 0; time < duration; time += TEST_TICK) {
+    for (unsigned int i = 0; i < count; i++) {
+      tick(config, &gpus[i], time);
+    }
+  }
+}
+
+static void expect_transitions(const char * scenario, const testGpu * gpu, const testTransition * expected, unsigned int count) {
+  // Check the number of transitions
+  CHECK(gpu->transitionCount == count, "%s: GPU %u: %u transitions, expected %u", scenario, gpu->index, gpu->transitionCount, count);
+
+  // Check each transition
+  for (unsigned int i = 0; i < count && i < gpu->transitionCount && i < TEST_TRANSITIONS_MAX; i++) {
+    const testTransition * actual = &gpu->transitions[i];
+
+    CHECK(actual->time == expected[i].time && actual->pstateId == expected[i].pstateId && actual->thermal == expected[i].thermal,
+      "%s: GPU %u: transition %u to P%u at %llu ms%s, expected P%u at %llu ms%s", scenario, gpu->index, i,
+      actual->pstateId, actual->time, actual->thermal ? " (thermal)" : "",
+      expected[i].pstateId, expected[i].time, expected[i].thermal ? " (thermal)" : "");
+  }
+}
+
+/***** ***** ***** ***** ***** SCENARIOS ***** ***** ***** ***** *****/
+
+static void test_idle_to_burst(void) {
+  // Idle GPU that gets busy for 10 seconds
+  controlConfig config = make_config("iterations");
+  testWorkload workload = { cool, busy_10_to_20 };
+
+  run(&config, &workload, 1, 40000);
+
+  // Up on the first busy tick, down after more than --iterations-before-switch idle ticks
+  testTransition expected[] = {
+    { 10000, 16, false },
+    { 23100, 8, false },
+  };
+
+  expect_transitions("idle to burst", &gpus[0], expected, 2);
+  CHECK(gpus[0].maxReaction == 0, "idle to burst: reacted after %llu ms", gpus[0].maxReaction);
+}
+
+static void test_thermal_excursion(void) {
+  // Busy GPU that overheats for 2.5 seconds
+  controlConfig config = make_config("iterations");
+  testWorkload workload = { hot_5_to_7_5, busy };
+
+  run(&config, &workload, 1, 10000);
+
+  // Straight to low performance state on the first hot tick, back up on the first cool one
+  testTransition expected[] = {
+    { 0, 16, false },
+    { 5000, 8, true },
+    { 7500, 16, false },
+  };
+
+  expect_transitions("thermal excursion", &gpus[0], expected, 3);
+}
+
+static void test_thermal_ladder(void) {
+  // Busy GPU on a ladder that overheats for 2.5 seconds
+  controlConfig config = make_config("ladder");
+
+  policyStep steps[LADDER_STEPS_MAX];
+  size_t stepCount;
+
+  CHECK(policy_parse_ladder("8,5:30,16:70", steps, &stepCount), "invalid ladder");
+  policy_set_ladder(&config.policyConfiguration, steps, stepCount);
+
+  testWorkload workload = { hot_5_to_7_5, busy };
+
+  run(&config, &workload, 1, 10000);
+
+  // Climb with the moving average, one step down per THERMAL_STEP_TIME while hot, back to the band of the average once cool
+  testTransition expected[] = {
+    { 100, 5, false },
+    { 300, 16, false },
+    { 5000, 5, true },
+    { 5000 + THERMAL_STEP_TIME, 8, true },
+    { 7500, 16, false },
+  };
+
+  expect_transitions("thermal ladder", &gpus[0], expected, 5);
+}
+
+static void test_flapping(void) {
+  // Short bursts more often than the GPU switches down keep it up
+  controlConfig config = make_config("iterations");
+  testWorkload fast = { cool, flapping_2s };
+
+  run(&config, &fast, 1, 60000);
+
+  testTransition expectedFast[] = {
+    { 0, 16, false },
+  };
+
+  expect_transitions("flapping every 2 s", &gpus[0], expectedFast, 1);
+
+  // Less often, each burst switches up and down once
+  testWorkload slow = { cool, flapping_4s };
+
+  run(&config, &slow, 1, 60000);
+
+  CHECK(gpus[0].transitionCount == 30, "flapping every 4 s: %u transitions, expected 30", gpus[0].transitionCount);
+  CHECK(gpus[0].maxReaction == 0, "flapping every 4 s: reacted after %llu ms", gpus[0].maxReaction);
+
+  for (unsigned int i = 0; i < gpus[0].transitionCount && i < TEST_TRANSITIONS_MAX; i++) {
+    // Time of the burst of the transition
+    unsigned long long burst = (unsigned long long) (i / 2) * 4000;
+
+    // Up on the burst, down 31 idle ticks after the tick that follows it
+    unsigned long long time = i % 2 == 0 ? burst : burst + TEST_TICK + (ITERATIONS_BEFORE_SWITCH + 1) * TEST_TICK;
+
+    CHECK(gpus[0].transitions[i].time == time, "flapping every 4 s: transition %u at %llu ms, expected %llu ms", i, gpus[0].transitions[i].time, time);
+  }
+
+  // The ewma policy holds the GPU through the gaps
+  config = make_config("ewma");
+
+  run(&config, &fast, 1, 60000);
+
+  expect_transitions("ewma flapping every 2 s", &gpus[0], expectedFast, 1);
+}
+
+static void test_ewma_idle(void) {
+  // Busy GPU that goes idle, with the default threshold of 0
+  controlConfig config = make_config("ewma");
+  testWorkload workload = { cool, busy_until_5 };
+
+  run(&config, &workload, 1, 20000);
+
+  // The average falls below half a percent 15 ticks after the burst, the hold time counts from the tick before
+  testTransition expected[] = {
+    { 0, 16, false },
+    { 6300 + HOLD_TIME, 8, false },
+  };
+
+  expect_transitions("ewma idle", &gpus[0], expected, 2);
+}
+
+static void test_light_load(void) {
+  // Steady light load, with the default threshold of 0
+  controlConfig config = make_config("ewma");
+  testWorkload workload = { cool, light };
+
+  run(&config, &workload, 1, 20000);
+
+  // The average of 0.3 after the first tick is already above the threshold, and never decays
+  testTransition expected[] = {
+    { 0, 16, false },
+  };
+
+  expect_transitions("ewma light load", &gpus[0], expected, 1);
+
+  // Same on a ladder whose top band starts at the threshold
+  config = make_config("ladder");
+
+  policyStep steps[LADDER_STEPS_MAX];
+  size_t stepCount;
+
+  CHECK(policy_parse_ladder("8,16:0", steps, &stepCount), "invalid ladder");
+  policy_set_ladder(&config.policyConfiguration, steps, stepCount);
+
+  run(&config, &workload, 1, 20000);
+
+  expect_transitions("ladder light load", &gpus[0], expected, 1);
+}
+
+static void test_many_gpus(void) {
+  // Every GPU bursts once a minute, each one tick after the previous one
+  controlConfig config = make_config("iterations");
+  testWorkload workload = { cool, periodic };
+
+  // Duration of the run (in milliseconds)
+  unsigned long long duration = (unsigned long long) TEST_HOURS * 3600000ULL;
+
+  // Time the run
+  unsigned long long start = get_time_ns();
+
+  run(&config, &workload, TEST_GPUS_MAX, duration);
+
+  double elapsed = (get_time_ns() - start) / 1e9;
+
+  // Check each GPU
+  for (unsigned int i = 0; i < TEST_GPUS_MAX; i++) {
+    // One switch up and one down per period
+    CHECK(gpus[i].transitionCount == 2 * (duration / TEST_PERIOD), "many GPUs: GPU %u: %u transitions, expected %llu", i, gpus[i].transitionCount, 2 * (duration / TEST_PERIOD));
+    CHECK(gpus[i].maxReaction == 0, "many GPUs: GPU %u reacted after %llu ms", i, gpus[i].maxReaction);
+
+    // Up at the start of each burst, down 31 idle ticks after its end
+    for (unsigned int j = 0; j < gpus[i].transitionCount && j < TEST_TRANSITIONS_MAX; j++) {
+      unsigned long long burst = (unsigned long long) (j / 2) * TEST_PERIOD + (unsigned long long) i * TEST_TICK;
+      unsigned long long time = j % 2 == 0 ? burst : burst + TEST_BUSY + (ITERATIONS_BEFORE_SWITCH + 1) * TEST_TICK;
+
+      CHECK(gpus[i].transitions[j].time == time, "many GPUs: GPU %u: transition %u at %llu ms, expected %llu ms", i, j, gpus[i].transitions[j].time, time);
+    }
+  }
+
+  // Print the simulation speed
+  printf("Simulated %u GPU hours in %.3f s\n", TEST_GPUS_MAX * TEST_HOURS, elapsed);
+}
+
+/***** ***** ***** ***** ***** MAIN ***** ***** ***** ***** *****/
+
+int main(void) {
+  // Run each scenario
+  test_idle_to_burst();
+  test_thermal_excursion();
+  test_thermal_ladder();
+  test_flapping();
+  test_ewma_idle();
+  test_light_load();
+  test_many_gpus();
+
+  // Print the result
+  if (failures != 0) {
+    fprintf(stderr, "%u checks failed\n", failures);
+    return 1;
+  }
+
+  printf("All checks passed\n");
+  return 0;
+}